@@ -0,0 +1,360 @@
+/*
+ * library  -   libsmallsh (arithmetic)
+ * author   -   Nicholas Olson
+ *
+ * Integer expressions of "$(( ))", "(( ))" and "let", evaluated in the
+ * shell over 64-bit integers (wrapping on overflow, like the C they are
+ * written in). The parser climbs precedence levels straight from the
+ * text and computes as it goes; the side of "&&", "||" and "?:" that
+ * isn't taken is still parsed, but with assignments and errors held off.
+ *
+ *   ,  =  *= /= %= += -= <<= >>= &= ^= |=  ?:  ||  &&  |  ^  &
+ *   == !=  < <= > >=  << >>  + -  * / %  unary + - ! ~ ++ --  postfix ++ --
+ *
+ * A name stands for the value of its variable (empty is 0, anything else
+ * that isn't a number is itself evaluated).
+ */
+
+/*** includes ***/
+#include <stdlib.h>     // std library stuff
+#include <stdio.h>      // I/O stuff
+#include <string.h>     // for strncmp, strndup
+#include <ctype.h>      // for isspace, isdigit
+#include <inttypes.h>   // for int64_t and PRId64
+#include "libsmallsh.h" // private interface
+
+
+/*** binary operators ***/
+// longest first, so "<<" isn't taken for "<" (prec 0 ends the table)
+static struct ARITH_OP {
+    char * text;
+    int prec;
+} ops[] = {
+    { "||", 1 }, { "&&", 2 }, { "==", 6 }, { "!=", 6 }, { "<=", 7 }, { ">=", 7 },
+    { "<<", 8 }, { ">>", 8 }, { "|", 3 }, { "^", 4 }, { "&", 5 }, { "<", 7 },
+    { ">", 7 }, { "+", 9 }, { "-", 9 }, { "*", 10 }, { "/", 10 }, { "%", 10 },
+    { NULL, 0 }
+};
+
+
+/*** hidden methods ***/
+/* evaluate the expression text into *value
+ * post-condition:  returned 1 on error (reported), 0 otherwise */
+int _arith_eval(struct CL * cl, char * text, int64_t * value)
+{
+    struct ARITH a = { cl, text, 0, 0, NULL };
+
+    *value = _arith_expr(&a);
+    _arith_space(&a);
+    if (a.err == NULL && a.s[0] != '\0') { a.err = "syntax error"; }
+    if (a.err != NULL)
+    {
+        fprintf(stderr, "smallsh: arithmetic: %s: %s\n", text, a.err);
+        fflush(stderr);
+        return 1;
+    }
+
+    return 0;
+}
+
+/* skip spaces */
+void _arith_space(struct ARITH * a)
+{
+    while (isspace((unsigned char) *a->s)) { a->s++; }
+}
+
+/* expressions separated by "," (value of the last) */
+int64_t _arith_expr(struct ARITH * a)
+{
+    int64_t x = _arith_assign(a);
+
+    while (a->err == NULL && (_arith_space(a), *a->s == ','))
+    {
+        a->s++;
+        x = _arith_assign(a);
+    }
+    return x;
+}
+
+/* "name op= value" (right to left), or a conditional expression */
+int64_t _arith_assign(struct ARITH * a)
+{
+    // declarations
+    char * name;
+    char * op;
+    int64_t x;
+    int64_t y;
+    int len;
+    int n;
+
+    _arith_space(a);
+    name = a->s;
+    if ((len = _var_name_len(name)) == 0) { return _arith_cond(a); }
+
+    // an assignment operator after the name, "=" but not "=="
+    op = name + len;
+    while (isspace((unsigned char) *op)) { op++; }
+    if      (op[0] == '=' && op[1] != '=')                    { n = 0; }
+    else if (strchr("*/%+-&^|", op[0]) != NULL && op[1] == '=') { n = 1; }
+    else if ((strncmp(op, "<<=", 3) == 0) || (strncmp(op, ">>=", 3) == 0)) { n = 2; }
+    else { return _arith_cond(a); }
+
+    a->s = op + n + 1;
+    y = _arith_assign(a);
+    if (n == 0) { x = y; }
+    else
+    {
+        x = _arith_var(a, name, len);
+        x = _arith_apply(a, op[0] | (n == 2 ? op[1] << 8 : 0), x, y);
+    }
+    _arith_store(a, name, len, x);
+
+    return x;
+}
+
+/* "cond ? value : value" (only the side taken counts) */
+int64_t _arith_cond(struct ARITH * a)
+{
+    int64_t c = _arith_binary(a, 1);
+    int64_t x;
+    int64_t y;
+
+    _arith_space(a);
+    if (a->err != NULL || *a->s != '?') { return c; }
+    a->s++;
+
+    if (!c) { a->skip++; }
+    x = _arith_expr(a);
+    if (!c) { a->skip--; }
+
+    _arith_space(a);
+    if (*a->s != ':')
+    {
+        if (a->err == NULL) { a->err = "\":\" expected"; }
+        return 0;
+    }
+    a->s++;
+
+    if (c) { a->skip++; }
+    y = _arith_assign(a);
+    if (c) { a->skip--; }
+
+    return c ? x : y;
+}
+
+/* binary operators of precedence min and up (left to right) */
+int64_t _arith_binary(struct ARITH * a, int min)
+{
+    // declarations
+    struct ARITH_OP * op;
+    int64_t x = _arith_unary(a);
+    int64_t y;
+    int skip;
+    int len;
+
+    while (a->err == NULL)
+    {
+        // next operator, not an assignment ("+=", "<<=", but "<=" is one)
+        _arith_space(a);
+        for (op = ops; op->text != NULL; op++)
+        {
+            len = strlen(op->text);
+            if (strncmp(a->s, op->text, len) == 0) { break; }
+        }
+        if (op->text == NULL || op->prec < min) { break; }
+        if (a->s[len] == '=' && op->prec != 6 && op->prec != 7) { break; }
+        a->s += len;
+
+        // right side, not counted when "&&" or "||" already know the result
+        skip = (op->prec == 1 && x) || (op->prec == 2 && !x);
+        a->skip += skip;
+        y = _arith_binary(a, op->prec + 1);
+        a->skip -= skip;
+
+        x = _arith_apply(a, op->text[0] | (len == 2 ? op->text[1] << 8 : 0), x, y);
+    }
+
+    return x;
+}
+
+/* unary operators, "++name" and "--name" */
+int64_t _arith_unary(struct ARITH * a)
+{
+    // declarations
+    char * name;
+    int64_t x;
+    char c;
+    int len;
+
+    _arith_space(a);
+    c = *a->s;
+
+    // pre-increment and decrement
+    if ((c == '+' || c == '-') && a->s[1] == c)
+    {
+        name = a->s + 2;
+        while (isspace((unsigned char) *name)) { name++; }
+        if ((len = _var_name_len(name)) > 0)
+        {
+            a->s = name + len;
+            x = _arith_var(a, name, len) + (c == '+' ? 1 : -1);
+            _arith_store(a, name, len, x);
+            return x;
+        }
+    }
+
+    if (c == '+' || c == '-' || c == '!' || c == '~')
+    {
+        a->s++;
+        x = _arith_unary(a);
+        if (c == '-') { return (int64_t) (0 - (uint64_t) x); }
+        if (c == '!') { return !x; }
+        if (c == '~') { return ~x; }
+        return x;
+    }
+
+    return _arith_primary(a);
+}
+
+/* number, name (with "++" or "--" after it) or "(expression)" */
+int64_t _arith_primary(struct ARITH * a)
+{
+    // declarations
+    char * name;
+    char * end;
+    int64_t x;
+    int len;
+
+    _arith_space(a);
+
+    if (*a->s == '(')
+    {
+        a->s++;
+        x = _arith_expr(a);
+        _arith_space(a);
+        if (*a->s != ')')
+        {
+            if (a->err == NULL) { a->err = "\")\" expected"; }
+            return 0;
+        }
+        a->s++;
+        return x;
+    }
+
+    if (isdigit((unsigned char) *a->s))
+    {
+        x = strtoll(a->s, &end, 0);
+        if (isalnum((unsigned char) *end) || *end == '_') { a->err = "bad number"; return 0; }
+        a->s = end;
+        return x;
+    }
+
+    if ((len = _var_name_len(a->s)) > 0)
+    {
+        name = a->s;
+        a->s += len;
+        x = _arith_var(a, name, len);
+
+        // post-increment and decrement
+        _arith_space(a);
+        if ((a->s[0] == '+' || a->s[0] == '-') && a->s[1] == a->s[0])
+        {
+            _arith_store(a, name, len, x + (a->s[0] == '+' ? 1 : -1));
+            a->s += 2;
+        }
+        return x;
+    }
+
+    if (a->err == NULL) { a->err = (*a->s == '\0') ? "operand expected" : "syntax error"; }
+    return 0;
+}
+
+/* x op y, op is its chars (the second shifted up 8), wrapping like the
+ * unsigned math it is done in */
+int64_t _arith_apply(struct ARITH * a, int op, int64_t x, int64_t y)
+{
+    uint64_t ux = x;
+    uint64_t uy = y;
+
+    switch (op)
+    {
+    case '|' | '|' << 8:    return x || y;
+    case '&' | '&' << 8:    return x && y;
+    case '=' | '=' << 8:    return x == y;
+    case '!' | '=' << 8:    return x != y;
+    case '<' | '=' << 8:    return x <= y;
+    case '>' | '=' << 8:    return x >= y;
+    case '<':               return x < y;
+    case '>':               return x > y;
+    case '<' | '<' << 8:    return ux << (uy & 63);
+    case '>' | '>' << 8:    return x >> (uy & 63);
+    case '|':               return x | y;
+    case '^':               return x ^ y;
+    case '&':               return x & y;
+    case '+':               return ux + uy;
+    case '-':               return ux - uy;
+    case '*':               return ux * uy;
+    case '/':
+    case '%':
+        // errors in a side not taken don't count
+        if (y == 0)
+        {
+            if (a->skip == 0 && a->err == NULL) { a->err = "division by zero"; }
+            return 0;
+        }
+        if (y == -1) { return (op == '/') ? (int64_t) (0 - ux) : 0; }
+        return (op == '/') ? x / y : x % y;
+    }
+
+    return 0;
+}
+
+/* value of the variable name (len chars) */
+int64_t _arith_var(struct ARITH * a, char * name, int len)
+{
+    // declarations
+    struct ARITH sub;
+    char * value;
+    char * end;
+    int64_t x;
+
+    name = strndup(name, len);
+    value = _var_get(a->cl, name);
+    free(name);
+
+    // a number
+    while (isspace((unsigned char) *value)) { value++; }
+    if (*value == '\0') { return 0; }
+    x = strtoll(value, &end, 0);
+    if (*end == '\0') { return x; }
+
+    // or an expression of its own (on a copy, it may set the variable)
+    if (a->depth == ARITH_DEPTH_MAX)
+    {
+        if (a->err == NULL) { a->err = "expression nested too deep"; }
+        return 0;
+    }
+    sub = *a;
+    sub.s = value = strdup(value);
+    sub.depth++;
+    x = _arith_expr(&sub);
+    _arith_space(&sub);
+    if (sub.err == NULL && *sub.s != '\0') { sub.err = "syntax error"; }
+    if (a->err == NULL) { a->err = sub.err; }
+    free(value);
+
+    return x;
+}
+
+/* set the variable name (len chars) to x, unless in a side not taken */
+void _arith_store(struct ARITH * a, char * name, int len, int64_t x)
+{
+    char num[32];
+
+    if (a->skip > 0 || a->err != NULL) { return; }
+
+    name = strndup(name, len);
+    sprintf(num, "%" PRId64, x);
+    _var_set(a->cl, name, num);
+    free(name);
+}
@@ -0,0 +1,630 @@
+/*
+ * library  -   libsmallsh (control flow)
+ * author   -   Nicholas Olson
+ *
+ * The words of a line are parsed into a tree of commands once, then the
+ * tree is run. Nodes refer to words by their index, so parsing copies no
+ * strings and a loop body runs from the same nodes on every pass; only a
+ * command with "$" in it is copied, to expand it, when it runs.
+ *
+ *   list    := command [ (";" | "&&" | "||") command ]...
+ *   command := simple | if | while | until | for | case | function | "{" list "}"
+ *   if      := "if" list "then" list [ "elif" list "then" list ]... [ "else" list ] "fi"
+ *   while   := ("while" | "until") list "do" list "done"
+ *   for     := "for" name [ "in" word... ] ";" "do" list "done"
+ *   case    := "case" word "in" [ pattern[|pattern]...")" list ";;" ]... "esac"
+ *   function:= name "()" "{" list "}" | "function" name "{" list "}"
+ *
+ * Reserved words are only reserved at the start of a command, so
+ * "echo done" prints "done". A condition succeeds as "&&" sees it: its
+ * last command exited 0, or was a built-in or a background command.
+ */
+
+/*** includes ***/
+#include <stdlib.h>     // std library stuff
+#include <stdio.h>      // I/O stuff
+#include <string.h>     // for strcmp, strdup
+#include <fnmatch.h>    // for matching case patterns
+#include "libsmallsh.h" // private interface
+
+
+/*** reserved words ***/
+// words that can't start a command, they end what was started before
+static char * closers[] = { "then", "else", "elif", "fi", "do", "done", "esac", "}", ";;",
+                            "&&", "||", "()", NULL };
+
+// words ending the lists of compound commands
+static char * end_group[] = { "}", NULL };
+static char * end_cond[]  = { "then", NULL };
+static char * end_body[]  = { "elif", "else", "fi", NULL };
+static char * end_test[]  = { "do", NULL };
+static char * end_loop[]  = { "done", NULL };
+static char * end_case[]  = { ";;", "esac", NULL };
+
+
+/*** hidden methods ***/
+/* parse num words into a tree of commands
+ * post-condition:  returned NULL on syntax error (reported) */
+struct NODE * _ast_parse(char ** words, int num)
+{
+    struct PARSE p = { words, num, 0, 0 };
+    struct NODE * tree;
+
+    // a line can't start with ";"
+    if (num > 0 && strcmp(words[0], ";") == 0) { _ast_error(&p); return NULL; }
+
+    if ((tree = _ast_list(&p, NULL)) == NULL) { return NULL; }
+    if (p.pos < p.num)
+    {
+        _ast_error(&p);
+        _ast_free(tree);
+        return NULL;
+    }
+
+    return tree;
+}
+
+/* allocate an empty node of type */
+struct NODE * _ast_new(int type)
+{
+    struct NODE * node = calloc(1, sizeof(struct NODE));
+
+    node->type = type;
+    node->name = -1;
+    return node;
+}
+
+/* free node, its kids and the siblings after it (NULL is ignored) */
+void _ast_free(struct NODE * node)
+{
+    struct NODE * next;
+
+    for ( ; node != NULL; node = next)
+    {
+        next = node->next;
+        _ast_free(node->kids);
+        free(node);
+    }
+}
+
+/* parse commands joined by operators, up to one of the words in ends
+ * (NULL for the end of the words), which is left to the caller
+ * post-condition:  returned NULL on syntax error (reported) */
+struct NODE * _ast_list(struct PARSE * p, char ** ends)
+{
+    // declarations
+    struct NODE * list = _ast_new(NODE_LIST);
+    struct NODE * tail = NULL;
+    struct NODE * cmd;
+    char * word;
+    int i;
+
+    while (p->pos < p->num)
+    {
+        // ";" between commands, and after reserved words that end lines
+        word = p->words[p->pos];
+        if (strcmp(word, ";") == 0) { p->pos++; continue; }
+
+        // end of the list
+        for (i = 0; ends != NULL && ends[i] != NULL; i++)
+        {
+            if (strcmp(word, ends[i]) == 0) { break; }
+        }
+        if (ends != NULL && ends[i] != NULL) { break; }
+
+        if ((cmd = _ast_command(p)) == NULL) { _ast_free(list); return NULL; }
+        if (tail == NULL) { list->kids = cmd; }
+        else              { tail->next = cmd; }
+        tail = cmd;
+
+        // operator after it ("&&" and "||" need a command after them),
+        // anything else is for the caller
+        if (p->pos == p->num) { break; }
+        word = p->words[p->pos];
+        if      (strcmp(word, "&&") == 0) { cmd->op = OP_AND; }
+        else if (strcmp(word, "||") == 0) { cmd->op = OP_OR; }
+        else if (strcmp(word, ";") == 0)  { cmd->op = OP_SEQ; continue; }
+        else                              { break; }
+
+        p->pos++;
+        while (p->pos < p->num && strcmp(p->words[p->pos], ";") == 0) { p->pos++; }
+        if (p->pos == p->num) { p->pos--; _ast_error(p); _ast_free(list); return NULL; }
+    }
+
+    // compound commands need something in each of their lists
+    if (ends != NULL && list->kids == NULL)
+    {
+        _ast_error(p);
+        _ast_free(list);
+        return NULL;
+    }
+    if (tail != NULL) { tail->op = OP_END; }
+
+    return list;
+}
+
+/* parse one command, simple or compound
+ * post-condition:  returned NULL on syntax error (reported) */
+struct NODE * _ast_command(struct PARSE * p)
+{
+    // declarations
+    struct NODE * node;
+    char * word = p->words[p->pos];
+    char * next = (p->pos + 1 < p->num) ? p->words[p->pos + 1] : "";
+    int len = strlen(word);
+    int i;
+
+    // compound commands
+    if (strcmp(word, "if") == 0)    { return _ast_if(p); }
+    if (strcmp(word, "while") == 0 || strcmp(word, "until") == 0) { return _ast_loop(p); }
+    if (strcmp(word, "for") == 0)   { return _ast_for(p); }
+    if (strcmp(word, "case") == 0)  { return _ast_case(p); }
+    if (strcmp(word, "function") == 0 || strcmp(next, "()") == 0
+        || (len > 2 && strcmp(word + len - 2, "()") == 0)) { return _ast_func(p); }
+    if (strcmp(word, "{") == 0)
+    {
+        p->pos++;
+        p->depth++;
+        if ((node = _ast_list(p, end_group)) == NULL) { return NULL; }
+        p->depth--;
+        if (_ast_expect(p, "}") != 0) { _ast_free(node); return NULL; }
+        return node;
+    }
+
+    for (i = 0; closers[i] != NULL; i++)
+    {
+        if (strcmp(word, closers[i]) == 0) { _ast_error(p); return NULL; }
+    }
+
+    // simple command, up to an operator (or the "}" of an open "{")
+    node = _ast_new(NODE_CMD);
+    node->start = p->pos;
+    for ( ; p->pos < p->num; p->pos++)
+    {
+        word = p->words[p->pos];
+        if (strcmp(word, ";") == 0 || strcmp(word, "&&") == 0 || strcmp(word, "||") == 0
+            || strcmp(word, ";;") == 0 || (p->depth > 0 && strcmp(word, "}") == 0)) { break; }
+
+        // words to expand, or replaced when run, are copied first
+        if (strchr(word, '$') != NULL || strncmp(word, "<(", 2) == 0
+            || strncmp(word, ">(", 2) == 0) { node->copy = 1; }
+    }
+    node->len = p->pos - node->start;
+
+    return node;
+}
+
+/* parse "if list then list [elif list then list]... [else list] fi"
+ * into kids condition, body, condition, body, ... [else body] */
+struct NODE * _ast_if(struct PARSE * p)
+{
+    // declarations
+    struct NODE * node = _ast_new(NODE_IF);
+    struct NODE * tail = NULL;
+    struct NODE * kid;
+    int is_else = 0;
+
+    for (p->pos++; ; )
+    {
+        // condition
+        if (!is_else)
+        {
+            if ((kid = _ast_list(p, end_cond)) == NULL) { break; }
+            if (tail == NULL) { node->kids = kid; }
+            else              { tail->next = kid; }
+            tail = kid;
+            if (_ast_expect(p, "then") != 0) { break; }
+        }
+
+        // body, then what follows it
+        if ((kid = _ast_list(p, end_body)) == NULL) { break; }
+        if (tail == NULL) { node->kids = kid; }
+        else              { tail->next = kid; }
+        tail = kid;
+
+        if (is_else || p->pos == p->num || strcmp(p->words[p->pos], "fi") == 0)
+        {
+            if (_ast_expect(p, "fi") != 0) { break; }
+            return node;
+        }
+        is_else = (strcmp(p->words[p->pos], "else") == 0);
+        p->pos++;
+    }
+
+    _ast_free(node);
+    return NULL;
+}
+
+/* parse "while list do list done" (or until) into kids condition, body */
+struct NODE * _ast_loop(struct PARSE * p)
+{
+    struct NODE * node;
+
+    node = _ast_new(strcmp(p->words[p->pos], "while") == 0 ? NODE_WHILE : NODE_UNTIL);
+    p->pos++;
+
+    if ((node->kids = _ast_list(p, end_test)) != NULL
+        && _ast_expect(p, "do") == 0
+        && (node->kids->next = _ast_list(p, end_loop)) != NULL
+        && _ast_expect(p, "done") == 0) { return node; }
+
+    _ast_free(node);
+    return NULL;
+}
+
+/* parse "for name [in words] ; do list done" into the body kid, the
+ * words are the node's (len -1 without "in": the parameters) */
+struct NODE * _ast_for(struct PARSE * p)
+{
+    // declarations
+    struct NODE * node = _ast_new(NODE_FOR);
+    char * word;
+
+    // loop variable
+    p->pos++;
+    if (p->pos == p->num || (size_t) _var_name_len(p->words[p->pos]) != strlen(p->words[p->pos]))
+    {
+        _ast_error(p);
+        _ast_free(node);
+        return NULL;
+    }
+    node->name = p->pos++;
+
+    // words, up to the ";" or "do"
+    node->len = -1;
+    if (p->pos < p->num && strcmp(p->words[p->pos], "in") == 0)
+    {
+        node->start = ++p->pos;
+        for ( ; p->pos < p->num; p->pos++)
+        {
+            word = p->words[p->pos];
+            if (strcmp(word, ";") == 0 || strcmp(word, "do") == 0) { break; }
+        }
+        node->len = p->pos - node->start;
+    }
+    while (p->pos < p->num && strcmp(p->words[p->pos], ";") == 0) { p->pos++; }
+
+    if (_ast_expect(p, "do") == 0
+        && (node->kids = _ast_list(p, end_loop)) != NULL
+        && _ast_expect(p, "done") == 0) { return node; }
+
+    _ast_free(node);
+    return NULL;
+}
+
+/* parse "case word in pattern) list ;; ... esac" into kids patterns,
+ * body, patterns, body, ... (the word is the node's) */
+struct NODE * _ast_case(struct PARSE * p)
+{
+    // declarations
+    struct NODE * node = _ast_new(NODE_CASE);
+    struct NODE * tail = NULL;
+    struct NODE * pat;
+    struct NODE * body;
+    char * word;
+
+    // word to match
+    p->pos++;
+    if (p->pos == p->num) { _ast_error(p); _ast_free(node); return NULL; }
+    node->start = p->pos++;
+    node->len = 1;
+    if (_ast_expect(p, "in") != 0) { _ast_free(node); return NULL; }
+
+    while (1)
+    {
+        while (p->pos < p->num && strcmp(p->words[p->pos], ";") == 0) { p->pos++; }
+        if (p->pos < p->num && strcmp(p->words[p->pos], "esac") == 0) { p->pos++; return node; }
+
+        // patterns, up to the word ending in ")"
+        pat = _ast_new(NODE_PAT);
+        pat->start = p->pos;
+        for ( ; p->pos < p->num; p->pos++)
+        {
+            word = p->words[p->pos];
+            if (word[strlen(word) - 1] == ')') { break; }
+        }
+        if (p->pos == p->num) { _ast_error(p); _ast_free(pat); break; }
+        pat->len = ++p->pos - pat->start;
+
+        // body, up to ";;" (or "esac" after the last)
+        if ((body = _ast_list(p, end_case)) == NULL) { _ast_free(pat); break; }
+        pat->next = body;
+        if (tail == NULL) { node->kids = pat; }
+        else              { tail->next = pat; }
+        tail = body;
+
+        if (p->pos < p->num && strcmp(p->words[p->pos], ";;") == 0) { p->pos++; }
+    }
+
+    _ast_free(node);
+    return NULL;
+}
+
+/* parse "name() { list }", "name () { list }" or "function name { list }",
+ * the body words are the node's (they're copied to the function, and
+ * parsed again from there, when it is defined) */
+struct NODE * _ast_func(struct PARSE * p)
+{
+    // declarations
+    struct NODE * node = _ast_new(NODE_FUNC);
+    struct NODE * body;
+
+    // name
+    if (strcmp(p->words[p->pos], "function") == 0) { p->pos++; }
+    if (p->pos == p->num || strchr(p->words[p->pos], '/') != NULL)
+    {
+        _ast_error(p);
+        _ast_free(node);
+        return NULL;
+    }
+    node->name = p->pos++;
+    if (p->pos < p->num && strcmp(p->words[p->pos], "()") == 0) { p->pos++; }
+    while (p->pos < p->num && strcmp(p->words[p->pos], ";") == 0) { p->pos++; }
+
+    // body
+    if (_ast_expect(p, "{") != 0) { _ast_free(node); return NULL; }
+    node->start = p->pos;
+    p->depth++;
+    if ((body = _ast_list(p, end_group)) == NULL) { _ast_free(node); return NULL; }
+    p->depth--;
+    _ast_free(body);
+    node->len = p->pos - node->start;
+    if (_ast_expect(p, "}") != 0) { _ast_free(node); return NULL; }
+
+    return node;
+}
+
+/* take the next word, which must be word
+ * post-condition:  returned 1 (syntax error reported) if it isn't */
+int _ast_expect(struct PARSE * p, char * word)
+{
+    if (p->pos < p->num && strcmp(p->words[p->pos], word) == 0)
+    {
+        p->pos++;
+        return 0;
+    }
+
+    return _ast_error(p);
+}
+
+/* report a syntax error at the next word */
+int _ast_error(struct PARSE * p)
+{
+    if (p->pos < p->num) { fprintf(stderr, "smallsh: syntax error near \"%s\"\n", p->words[p->pos]); }
+    else                 { fputs("smallsh: syntax error near end of line\n", stderr); }
+    fflush(stderr);
+
+    return 1;
+}
+
+/* run node, whose words are indexes into words
+ * post-condition:  returned -1 if exiting, otherwise result of the last
+ *                  command run (cl->loop_ctl is set if leaving loops) */
+int _ast_run(struct CL * cl, char ** words, struct NODE * node)
+{
+    // declarations
+    struct NODE * kid;
+    char ** items;
+    char * word;
+    char * pats;
+    int result = 0;
+    int run = 1;
+    int num;
+    int i;
+
+    switch (node->type)
+    {
+    case NODE_CMD:
+        return _ast_cmd(cl, words, node);
+
+    case NODE_LIST:
+        for (kid = node->kids; kid != NULL && result != -1 && !cl->loop_ctl; kid = kid->next)
+        {
+            if (run) { result = _ast_run(cl, words, kid); }
+
+            // skipped commands keep the last status for the next operator
+            if      (kid->op == OP_AND) { run = _status_ok(cl); }
+            else if (kid->op == OP_OR)  { run = !_status_ok(cl); }
+            else                        { run = 1; }
+        }
+        return result;
+
+    case NODE_IF:
+        for (kid = node->kids; kid != NULL; kid = kid->next->next)
+        {
+            // else
+            if (kid->next == NULL) { return _ast_run(cl, words, kid); }
+
+            result = _ast_run(cl, words, kid);
+            if (result == -1 || cl->loop_ctl) { return result; }
+            if (_status_ok(cl)) { return _ast_run(cl, words, kid->next); }
+        }
+
+        // no branch ran, which succeeds
+        cl->fg_ran = 0;
+        return 0;
+
+    case NODE_WHILE:
+    case NODE_UNTIL:
+        cl->loop_depth++;
+        while (1)
+        {
+            result = _ast_run(cl, words, node->kids);
+            if (result == -1 || (cl->loop_ctl && _ast_loop_end(cl))) { break; }
+
+            // a loop ending at its condition succeeds
+            if (_status_ok(cl) != (node->type == NODE_WHILE)) { cl->fg_ran = 0; break; }
+
+            result = _ast_run(cl, words, node->kids->next);
+            if (result == -1 || (cl->loop_ctl && _ast_loop_end(cl))) { break; }
+        }
+        cl->loop_depth--;
+        return result;
+
+    case NODE_FOR:
+        // the words, or the parameters of the function being run
+        if (node->len == -1)
+        {
+            items = (cl->params != NULL) ? cl->params + 1 : NULL;
+            num = (cl->num_params > 0) ? cl->num_params - 1 : 0;
+        }
+        else { items = _expand_words(cl, words + node->start, node->len, &num); }
+
+        cl->loop_depth++;
+        cl->fg_ran = 0;
+        for (i = 0; i < num; i++)
+        {
+            _var_set(cl, words[node->name], items[i]);
+            result = _ast_run(cl, words, node->kids);
+            if (result == -1 || (cl->loop_ctl && _ast_loop_end(cl))) { break; }
+        }
+        cl->loop_depth--;
+
+        if (node->len != -1)
+        {
+            for (i = 0; i < num; i++) { free(items[i]); }
+            free(items);
+        }
+        return result;
+
+    case NODE_CASE:
+        word = _expand_word(cl, words[node->start]);
+        cl->fg_ran = 0;
+        for (kid = node->kids; kid != NULL; kid = kid->next->next)
+        {
+            // the pattern words as one string
+            num = 1;
+            for (i = 0; i < kid->len; i++) { num += strlen(words[kid->start + i]); }
+            pats = malloc(num);
+            pats[0] = '\0';
+            for (i = 0; i < kid->len; i++) { strcat(pats, words[kid->start + i]); }
+
+            i = _ast_case_match(cl, word, pats);
+            free(pats);
+            if (i) { result = _ast_run(cl, words, kid->next); break; }
+        }
+        free(word);
+        return result;
+
+    case NODE_FUNC:
+        result = _define_func(cl, words[node->name], words + node->start, node->len);
+        if (result == 0) { cl->fg_ran = 0; }
+        else             { _set_status(cl, 1); }
+        return 0;
+    }
+
+    return 0;
+}
+
+/* run a simple command (expanded first if it has "$" in it)
+ * post-condition:  returned -1 if exiting, otherwise result of the command */
+int _ast_cmd(struct CL * cl, char ** words, struct NODE * node)
+{
+    // declarations
+    char ** saved_args = cl->args;
+    int saved_num = cl->num_args;
+    char ** view;
+    char * tmp = NULL;
+    int result = 0;
+    int len;
+    int i;
+
+    // view the command as the whole argument list
+    cl->expand_err = 0;
+    if (node->copy) { view = _expand_words(cl, words + node->start, node->len, &len); }
+    else
+    {
+        view = words + node->start;
+        len = node->len;
+        tmp = view[len];
+        view[len] = NULL;
+    }
+
+    // variables, or a command to execute (not if expanding it failed)
+    if (cl->expand_err) { _set_status(cl, 1); }
+    else if (_assign_words(cl, view, len)) { cl->fg_ran = 0; }
+    else
+    {
+        cl->args = view;
+        cl->num_args = len;
+        cl->fg_ran = 0;
+        result = _execute_CL(cl);
+    }
+
+    // put the whole list back
+    cl->args = saved_args;
+    cl->num_args = saved_num;
+    if (node->copy)
+    {
+        for (i = 0; i < len; i++) { free(view[i]); }
+        free(view);
+    }
+    else { view[len] = tmp; }
+
+    return result;
+}
+
+/* "break" or "continue" reached the end of a loop body
+ * post-condition:  returned 1 if the loop is to end, 0 to go on with
+ *                  its next pass */
+int _ast_loop_end(struct CL * cl)
+{
+    int ctl = cl->loop_ctl;
+
+    // leaving more loops than this one
+    if (--cl->loop_levels > 0) { return 1; }
+
+    cl->loop_ctl = 0;
+    return ctl == LOOP_BREAK;
+}
+
+/* word matches one of the "|" separated patterns in pats (a "(" before
+ * and the ")" after them are dropped, "$" in them is expanded) */
+int _ast_case_match(struct CL * cl, char * word, char * pats)
+{
+    // declarations
+    char * pat;
+    char * save;
+    char * expanded;
+    int len = strlen(pats);
+    int match = 0;
+
+    if (len > 0 && pats[len - 1] == ')') { pats[len - 1] = '\0'; }
+    if (pats[0] == '(') { pats++; }
+
+    for (pat = strtok_r(pats, "|", &save); pat != NULL && !match; pat = strtok_r(NULL, "|", &save))
+    {
+        expanded = _expand_word(cl, pat);
+        match = (fnmatch(expanded, word, 0) == 0);
+        free(expanded);
+    }
+
+    return match;
+}
+
+/* last command succeeded (as "&&" sees it), built-ins and background
+ * commands that don't set a status count as success */
+int _status_ok(struct CL * cl)
+{
+    return !cl->fg_ran || (cl->fg_exited && cl->fg_status == 0 && !cl->fg_timed_out);
+}
+
+/* exit value of the last command as "$?" gives it (128 + the signal
+ * if killed, 0 for built-ins without a status) */
+int _status_code(struct CL * cl)
+{
+    if (_status_ok(cl))    { return 0; }
+    if (cl->fg_signaled)   { return 128 + cl->fg_status; }
+    return (cl->fg_status != 0) ? cl->fg_status : 1;
+}
+
+/* set the status of the last command to exit value code (for built-ins
+ * that have one) */
+void _set_status(struct CL * cl, int code)
+{
+    cl->fg_ran = 1;
+    cl->fg_status = code;
+    cl->fg_exited = 1;
+    cl->fg_signaled = 0;
+    cl->fg_timed_out = 0;
+}
@@ -0,0 +1,118 @@
+/*
+ * program  -   smallsh-client
+ * author   -   Nicholas Olson
+ *
+ * Runs commands in a smallsh daemon ("smallsh --serve PATH").
+ * usage:   smallsh-client PATH [command ...]
+ * With a command, runs it and exits with its status. Without one, runs
+ * each line of stdin in the same session and exits with the last status.
+ */
+
+/*** includes ***/
+#include <stdlib.h>     // std library stuff
+#include <stdio.h>      // I/O stuff
+#include <unistd.h>     // for write
+#include <string.h>     // for strlen, strcmp, etc
+#include <sys/socket.h> // for the socket
+#include <sys/un.h>     // for unix domain sockets
+#include "serve.h"      // protocol
+
+
+/*** defines ***/
+#define LINE_SIZE 2048
+
+
+/*** hidden prototypes ***/
+int _run_remote(int, char*);            // run one command, returns its status
+
+
+/*** main ***/
+int main(int argc, char ** argv)
+{
+    // declarations
+    struct sockaddr_un addr = {0};
+    char line[LINE_SIZE];
+    int status = 0;
+    int len = 0;
+    int fd;
+    int i;
+
+    if (argc < 2 || strlen(argv[1]) >= sizeof(addr.sun_path))
+    {
+        fprintf(stderr, "usage: %s PATH [command ...]\n", argv[0]);
+        return 2;
+    }
+
+    // connect to daemon
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, argv[1]);
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1 || connect(fd, (struct sockaddr*) &addr, sizeof(addr)) == -1)
+    {
+        char perr[256];
+        snprintf(perr, sizeof(perr), "smallsh-client: %s", argv[1]);
+        perror(perr);
+        return 2;
+    }
+
+    // one command from the arguments
+    if (argc > 2)
+    {
+        line[0] = '\0';
+        for (i = 2; i < argc; i++)
+        {
+            len += strlen(argv[i]) + 1;
+            if (len >= LINE_SIZE) { fputs("smallsh-client: command too long\n", stderr); return 2; }
+            if (i != 2) { strcat(line, " "); }
+            strcat(line, argv[i]);
+        }
+        status = _run_remote(fd, line);
+    }
+    // or one per line of stdin
+    else
+    {
+        while (status >= 0 && fgets(line, LINE_SIZE, stdin) != NULL)
+        {
+            status = _run_remote(fd, line);
+        }
+    }
+
+    close(fd);
+
+    // session exited with "exit"
+    if (status < 0) { status = -status - 1; }
+    return status;
+}
+
+
+/*** hidden methods ***/
+/* send command and copy its output to stdout/stderr until its status
+ * post-condition:  returned exit value (128 + n for signal n), or
+ *                  -(value + 1) if the session ran "exit" */
+int _run_remote(int fd, char * command)
+{
+    // declarations
+    char buff[FRAME_MAX + 1];
+    int status = 0;
+    int type;
+    int len;
+
+    if (send_frame(fd, FRAME_CMD, command, strlen(command)) == -1) { return -(2 + 1); }
+
+    while ((len = recv_frame(fd, &type, buff, FRAME_MAX)) >= 0)
+    {
+        if (type == FRAME_OUT)      { write(STDOUT_FILENO, buff, len); }
+        else if (type == FRAME_ERR) { write(STDERR_FILENO, buff, len); }
+        else if (type == FRAME_STATUS || type == FRAME_BYE)
+        {
+            buff[len] = '\0';
+            if (strncmp(buff, "signal ", 7) == 0) { status = 128 + atoi(buff + 7); }
+            else                                  { status = atoi(buff + 5); }
+
+            return (type == FRAME_STATUS) ? status : -(status + 1);
+        }
+    }
+
+    // daemon went away
+    return -(status + 1);
+}
@@ -0,0 +1,393 @@
+/*
+ * library  -   libsmallsh (directory navigation)
+ * author   -   Nicholas Olson
+ *
+ * The working directory is tracked logically: cd works out the new path
+ * from the old one and the argument (".." drops the last name, so links
+ * that were followed stay in the path) and doesn't ask the kernel for it.
+ * CDPATH is looked through for relative names, "cd -" goes back to
+ * $OLDPWD and pushd/popd keep a stack of directories.
+ *
+ * Every directory changed to is also added to the jump index of "z", a
+ * file of "rank|time|path" lines. A visit appends one line, so nothing is
+ * rewritten on a cd; the index is read (summing the lines of each path)
+ * on first use and rewritten, one line per path, once most of its lines
+ * are repeats. Ranks are aged once they add up to Z_RANK_MAX, so paths
+ * not visited for a while drop out.
+ */
+
+/*** includes ***/
+#define _GNU_SOURCE     // for strcasestr and strchrnul
+#include <stdlib.h>     // std library stuff
+#include <stdio.h>      // I/O stuff
+#include <unistd.h>     // for chdir, getcwd
+#include <string.h>     // for strcmp, strlen, strstr
+#include <errno.h>      // for errno
+#include <limits.h>     // for PATH_MAX
+#include <fcntl.h>      // for open
+#include <time.h>       // for visit times
+#include <sys/stat.h>   // for stat
+#include "libsmallsh.h" // private interface
+
+
+/*** hidden methods ***/
+/* change directory to dir (looked for in CDPATH if relative), setting
+ * PWD and OLDPWD; physical resolves links in the new path
+ * post-condition:  returned 0, or -1 with a message printed */
+int _dirs_cd(struct CL * cl, char * dir, int physical)
+{
+    // declarations
+    char path[PATH_MAX];
+    struct stat st;
+    char * cdpath = _var_get(cl, "CDPATH");
+    char * end;
+    char * p;
+    int shown = 0;
+    int len;
+
+    // names starting with "/", "." or ".." aren't looked for
+    path[0] = '\0';
+    if (dir[0] != '/' && cdpath[0] != '\0' && strcmp(dir, ".") != 0 && strcmp(dir, "..") != 0 &&
+        strncmp(dir, "./", 2) != 0 && strncmp(dir, "../", 3) != 0)
+    {
+        for (p = cdpath; ; p = end + 1)
+        {
+            // an empty entry is the current directory
+            end = strchrnul(p, ':');
+            len = end - p;
+            if (len == 0) { _dirs_join(cl, path, ".", 1, dir); }
+            else          { _dirs_join(cl, path, p, len, dir); }
+            if (stat(path, &st) == 0 && S_ISDIR(st.st_mode)) { shown = (len != 0); break; }
+            path[0] = '\0';
+            if (*end == '\0') { break; }
+        }
+    }
+    if (path[0] == '\0' && _dirs_join(cl, path, "", 0, dir) == -1)
+    {
+        fprintf(stderr, "smallsh: cd: %s: %s\n", dir, strerror(ENAMETOOLONG));
+        fflush(stderr);
+        return -1;
+    }
+
+    // "a/.." may not be where a is if a is a link to elsewhere, the
+    // kernel's idea of it is used then (and always if physical)
+    if ((physical && !shown) || chdir(path) == -1)
+    {
+        if (chdir(dir) == -1)
+        {
+            fprintf(stderr, "smallsh: cd: %s: %s\n", dir, strerror(errno));
+            fflush(stderr);
+            return -1;
+        }
+        physical = 1;
+    }
+
+    setenv("OLDPWD", cl->pwd, 1);
+    if (physical) { _set_curr_pwd(cl); }
+    else          { _change_CL_pwd(cl, path); }
+    setenv("PWD", cl->pwd, 1);
+
+    // found through CDPATH, say where
+    if (shown)
+    {
+        fflush(stdout);
+        printf("%s\n", cl->pwd);
+        fflush(stdout);
+    }
+
+    _z_visit(cl, cl->pwd);
+    return 0;
+}
+
+/* absolute path of dir into path (PATH_MAX bytes), relative to the first
+ * len bytes of base (to the working directory if that's empty or
+ * relative), with ".", ".." and repeated "/" taken out
+ * post-condition:  returned 0, -1 if it is too long */
+int _dirs_join(struct CL * cl, char * path, char * base, int len, char * dir)
+{
+    int n;
+
+    if (dir[0] == '/')       { n = snprintf(path, PATH_MAX, "%s", dir); }
+    else if (len == 0)       { n = snprintf(path, PATH_MAX, "%s/%s", cl->pwd, dir); }
+    else if (base[0] == '/') { n = snprintf(path, PATH_MAX, "%.*s/%s", len, base, dir); }
+    else                     { n = snprintf(path, PATH_MAX, "%s/%.*s/%s", cl->pwd, len, base, dir); }
+    if (n >= PATH_MAX) { path[0] = '\0'; return -1; }
+
+    _dirs_clean(path);
+    return 0;
+}
+
+/* take ".", ".." and repeated "/" out of the absolute path, in place */
+void _dirs_clean(char * path)
+{
+    char * out = path;
+    char * in = path;
+    int len;
+
+    while (*in != '\0')
+    {
+        while (*in == '/') { in++; }
+        if (*in == '\0') { break; }
+        len = strcspn(in, "/");
+
+        // ".." goes back to the last "/" written
+        if (len == 2 && in[0] == '.' && in[1] == '.')
+        {
+            while (out > path && *--out != '/') { }
+        }
+        else if (len != 1 || in[0] != '.')
+        {
+            *out++ = '/';
+            memmove(out, in, len);
+            out += len;
+        }
+        in += len;
+    }
+
+    if (out == path) { *out++ = '/'; }
+    *out = '\0';
+}
+
+/* start from $PWD if it names the working directory (keeping the links it
+ * went through), from the kernel's path of it if not */
+int _dirs_init(struct CL * cl)
+{
+    char * pwd = getenv("PWD");
+    struct stat a;
+    struct stat b;
+
+    if (pwd != NULL && pwd[0] == '/' && strlen(pwd) < PATH_MAX &&
+        stat(pwd, &a) == 0 && stat(".", &b) == 0 &&
+        a.st_dev == b.st_dev && a.st_ino == b.st_ino)
+    {
+        _change_CL_pwd(cl, pwd);
+        _dirs_clean(cl->pwd);
+        cl->pwd_len = strlen(cl->pwd);
+    }
+    else { _set_curr_pwd(cl); }
+
+    setenv("PWD", cl->pwd, 1);
+    return 0;
+}
+
+/* print the working directory and the stack, top first ("~" for home),
+ * one per line with its number if numbered */
+void _dirs_print(struct CL * cl, int numbered)
+{
+    char * home = getenv("HOME");
+    int n = (home != NULL) ? strlen(home) : 0;
+    char * dir;
+    int i;
+
+    fflush(stdout);
+    for (i = 0; i <= cl->dirs_len; i++)
+    {
+        dir = (i == 0) ? cl->pwd : cl->dirs[cl->dirs_len - i];
+        if (numbered)   { printf("%2d  ", i); }
+        else if (i > 0) { putchar(' '); }
+        if (n > 1 && strncmp(dir, home, n) == 0 && (dir[n] == '/' || dir[n] == '\0'))
+        {
+            printf("~%s", dir + n);
+        }
+        else { fputs(dir, stdout); }
+        if (numbered) { putchar('\n'); }
+    }
+    if (!numbered) { putchar('\n'); }
+    fflush(stdout);
+}
+
+/* path of the jump index into path (PATH_MAX bytes)
+ * post-condition:  returned 0, -1 if there is none (no $HOME) */
+int _z_path(char * path)
+{
+    char * file = getenv(Z_ENV);
+    char * home = getenv("HOME");
+
+    if (file != NULL && file[0] != '\0') { snprintf(path, PATH_MAX, "%s", file); }
+    else if (home != NULL)               { snprintf(path, PATH_MAX, "%s/%s", home, Z_FILE); }
+    else                                 { return -1; }
+    return 0;
+}
+
+/* read the jump index (once), it is rewritten if most of its lines are
+ * repeats */
+int _z_load(struct CL * cl)
+{
+    if (cl->z_loaded) { return 0; }
+    cl->z_loaded = 1;
+
+    _z_read(cl);
+    if (cl->z_lines > 2 * cl->z_dirs.len + Z_SLACK) { _z_save(cl); }
+    return 0;
+}
+
+/* read the jump index into the table, summing the ranks of each path's
+ * lines */
+int _z_read(struct CL * cl)
+{
+    // declarations
+    char path[PATH_MAX];
+    char * line = NULL;
+    size_t size = 0;
+    ssize_t n;
+    struct ZDIR * z;
+    double rank;
+    long when;
+    int off;
+    FILE * file;
+
+    cl->z_lines = 0;
+    cl->z_total = 0;
+    if (_z_path(path) == -1 || (file = fopen(path, "r")) == NULL) { return 0; }
+
+    while ((n = getline(&line, &size, file)) != -1)
+    {
+        if (n > 0 && line[n - 1] == '\n') { line[n - 1] = '\0'; }
+        if (sscanf(line, "%lf|%ld|%n", &rank, &when, &off) < 2 || line[off] != '/') { continue; }
+
+        if ((z = _hash_get(&cl->z_dirs, line + off)) == NULL)
+        {
+            z = malloc(sizeof(struct ZDIR));
+            z->rank = 0;
+            z->time = 0;
+            _hash_put(&cl->z_dirs, line + off, z);
+        }
+        z->rank += rank;
+        if (when > z->time) { z->time = when; }
+        cl->z_total += rank;
+        cl->z_lines++;
+    }
+    free(line);
+    fclose(file);
+
+    return 0;
+}
+
+/* add a visit of path to the jump index (home and "/" aren't kept, "cd"
+ * alone gets there) */
+int _z_visit(struct CL * cl, char * path)
+{
+    // declarations
+    char file[PATH_MAX];
+    char * home = getenv("HOME");
+    char * line;
+    struct ZDIR * z;
+    long now = time(NULL);
+    int len;
+    int fd;
+
+    if (strcmp(path, "/") == 0 || (home != NULL && strcmp(path, home) == 0)) { return 0; }
+    if (_z_path(file) == -1) { return -1; }
+
+    // one line on the end of the file, other sessions append to it too
+    len = strlen(path) + 32;
+    line = malloc(len);
+    len = snprintf(line, len, "1|%ld|%s\n", now, path);
+    if ((fd = open(file, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0600)) != -1)
+    {
+        write(fd, line, len);
+        close(fd);
+    }
+    free(line);
+
+    // the table, if it was read
+    if (!cl->z_loaded) { return 0; }
+    if ((z = _hash_get(&cl->z_dirs, path)) == NULL)
+    {
+        z = malloc(sizeof(struct ZDIR));
+        z->rank = 0;
+        _hash_put(&cl->z_dirs, path, z);
+    }
+    z->rank += 1;
+    z->time = now;
+    cl->z_total += 1;
+    cl->z_lines++;
+
+    if (cl->z_lines > 2 * cl->z_dirs.len + Z_SLACK || cl->z_total > Z_RANK_MAX) { _z_save(cl); }
+    return 0;
+}
+
+/* rewrite the jump index with a line per path, aged if the ranks add up
+ * to Z_RANK_MAX (read again first, for other sessions' visits) */
+int _z_save(struct CL * cl)
+{
+    // declarations
+    char path[PATH_MAX];
+    char tmp[PATH_MAX + 16];
+    struct HASH_ENT * ent;
+    struct HASH_ENT * next;
+    struct ZDIR * z;
+    double age = 1;
+    FILE * file;
+    int i;
+
+    if (_z_path(path) == -1) { return -1; }
+    _hash_free(&cl->z_dirs, free);
+    _hash_init(&cl->z_dirs, NAME_TABLE_SIZE);
+    _z_read(cl);
+    if (cl->z_total > Z_RANK_MAX) { age = Z_AGE; }
+
+    snprintf(tmp, sizeof(tmp), "%s.%d", path, (int) getpid());
+    if ((file = fopen(tmp, "w")) == NULL) { return -1; }
+
+    cl->z_lines = 0;
+    cl->z_total = 0;
+    for (i = 0; i < cl->z_dirs.size; i++)
+    {
+        for (ent = cl->z_dirs.buckets[i]; ent != NULL; ent = next)
+        {
+            next = ent->next;
+            z = ent->val;
+            z->rank *= age;
+            if (z->rank < 1)
+            {
+                free(_hash_del(&cl->z_dirs, ent->key));
+                continue;
+            }
+            fprintf(file, "%g|%ld|%s\n", z->rank, z->time, ent->key);
+            cl->z_total += z->rank;
+            cl->z_lines++;
+        }
+    }
+
+    if (fclose(file) != 0 || rename(tmp, path) == -1) { unlink(tmp); return -1; }
+    return 0;
+}
+
+/* rank of z weighed by how long ago it was visited */
+double _z_score(struct ZDIR * z, long now)
+{
+    long ago = now - z->time;
+
+    if (ago < 3600)   { return z->rank * 4; }
+    if (ago < 86400)  { return z->rank * 2; }
+    if (ago < 604800) { return z->rank / 2; }
+    return z->rank / 4;
+}
+
+/* path has the n words in it, in that order (case is ignored unless a
+ * word has upper case in it) */
+int _z_match(char * path, char ** words, int n)
+{
+    char * at = path;
+    char * w;
+    int i;
+
+    for (i = 0; i < n; i++)
+    {
+        for (w = words[i]; *w != '\0' && !(*w >= 'A' && *w <= 'Z'); w++) { }
+        at = (*w != '\0') ? strstr(at, words[i]) : strcasestr(at, words[i]);
+        if (at == NULL) { return 0; }
+        at += strlen(words[i]);
+    }
+    return 1;
+}
+
+/* order of matches by score, lowest first (for qsort) */
+int _z_cmp(const void * a, const void * b)
+{
+    double x = ((struct ZMATCH *) a)->score;
+    double y = ((struct ZMATCH *) b)->score;
+
+    return (x > y) - (x < y);
+}
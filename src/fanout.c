@@ -0,0 +1,208 @@
+/*
+ * library  -   libsmallsh (output fan-out)
+ * author   -   Nicholas Olson
+ *
+ * Commands with several output redirections ("cmd > a.log >> b.log")
+ * write into a pipe, and a helper job copies what arrives to every
+ * target. Data is duplicated in the kernel: tee(2) copies the pipe's
+ * pages into a pipe per extra target without consuming them, splice(2)
+ * moves each copy (and finally the original) to its target, so no byte
+ * passes through userspace unless a target can't be spliced to.
+ */
+
+/*** includes ***/
+#define _GNU_SOURCE     // for tee, splice and F_SETPIPE_SZ
+#include <stdlib.h>     // std library stuff
+#include <stdio.h>      // I/O stuff
+#include <unistd.h>     // for pipe, fork and close
+#include <fcntl.h>      // for tee, splice and pipe sizes
+#include <errno.h>      // for errno checking
+#include <signal.h>     // for ignoring SIGPIPE
+#include <sys/wait.h>   // for waitpid
+#include <sys/syscall.h>  // for close_range and pidfd_open
+#include "libsmallsh.h" // private interface
+
+
+/*** hidden methods ***/
+/* start a helper job copying everything written to the returned fd to
+ * each of the n fds in outs (which are closed here)
+ * post-condition:  returned write end of the helper's pipe, -1 on error */
+int _fanout_start(struct CL * cl, int * outs, int n)
+{
+    // declarations
+    struct JOB * job;
+    int ends[2];
+    int pid;
+    int i;
+
+    if (pipe2(ends, O_CLOEXEC) == -1)
+    {
+        perror("smallsh: pipe");
+        for (i = 0; i < n; i++) { close(outs[i]); }
+        return -1;
+    }
+
+    fflush(stdout);
+    pid = fork();
+
+    // helper copies until every writer is gone
+    if (pid == 0)
+    {
+        cl->is_child = 1;
+        _child_setup(cl->flags & CL_JOBCTL, 1, 0);
+        sigprocmask(SIG_SETMASK, &cl->old_mask, NULL);
+        signal(SIGPIPE, SIG_IGN);
+
+        // holding anything else of the shell's (the write end above all)
+        // would keep readers of it waiting
+        outs[n] = ends[0];
+        _fanout_close_others(outs, n + 1);
+        _exit(_fanout_copy(ends[0], outs, n));
+    }
+
+    // shell keeps only the write end
+    close(ends[0]);
+    for (i = 0; i < n; i++) { close(outs[i]); }
+    if (pid == -1)
+    {
+        perror("smallsh: fork");
+        close(ends[1]);
+        return -1;
+    }
+
+    // helper is a job, reaped quietly once it is done
+    if (cl->flags & CL_JOBCTL) { setpgid(pid, pid); }
+    job = _push_job(cl, pid, -1, syscall(SYS_pidfd_open, pid, 0));
+    job->helper = 1;
+    cl->stats.jobs_started++;
+    cl->fanout_pid = pid;
+
+    return ends[1];
+}
+
+/* wait for the helper of the last command to copy everything (the
+ * command is done with its output), so its targets are complete */
+void _fanout_wait(struct CL * cl)
+{
+    int status;
+    int i;
+
+    for (i = 0; cl->fanout_pid > 0 && i < cl->job_len; i++)
+    {
+        if (cl->jobs[i].pid != cl->fanout_pid || cl->jobs[i].done) { continue; }
+
+        while (waitpid(cl->fanout_pid, &status, 0) == -1 && errno == EINTR) { }
+        cl->stats.jobs_reaped++;
+        _remove_job(cl, i);
+        break;
+    }
+    cl->fanout_pid = 0;
+}
+
+/* copy everything read from the pipe in to each of the n (at least 2)
+ * fds in outs (targets that fail are dropped, the rest still get it all)
+ * post-condition:  returned 0 once in is at end of file, 1 on error */
+int _fanout_copy(int in, int * outs, int n)
+{
+    // declarations
+    int copies[FANOUT_MAX][2];
+    int size;
+    int flags;
+    ssize_t len;
+    ssize_t got;
+    int i;
+
+    // a pipe for the copy of each target but the last, as big as in so
+    // a copy always takes all of what in holds
+    size = fcntl(in, F_GETPIPE_SZ);
+    for (i = 0; i < n - 1; i++)
+    {
+        if (pipe(copies[i]) == -1) { return 1; }
+        fcntl(copies[i][1], F_SETPIPE_SZ, size);
+    }
+
+    // splice doesn't write to files opened for appending, write at
+    // their end instead
+    for (i = 0; i < n; i++)
+    {
+        flags = fcntl(outs[i], F_GETFL);
+        if (flags != -1 && (flags & O_APPEND))
+        {
+            fcntl(outs[i], F_SETFL, flags & ~O_APPEND);
+            lseek(outs[i], 0, SEEK_END);
+        }
+    }
+
+    while (1)
+    {
+        // duplicate what is in the pipe for the other targets (blocks
+        // until there is something, 0 once all writers are gone)
+        len = tee(in, copies[0][1], size, 0);
+        if (len == -1 && errno == EINTR) { continue; }
+        if (len <= 0) { return (len == 0) ? 0 : 1; }
+
+        for (i = 1; i < n - 1; i++)
+        {
+            got = tee(in, copies[i][1], len, 0);
+            if (got < len) { return 1; }
+        }
+
+        // move the copies out, then the original
+        for (i = 0; i < n - 1; i++)
+        {
+            _fanout_move(copies[i][0], &outs[i], len);
+        }
+        _fanout_move(in, &outs[n - 1], len);
+    }
+}
+
+/* move len bytes from the pipe in to *out, dropping the target (setting
+ * it to -1) if it fails, though the bytes are still taken from in */
+void _fanout_move(int in, int * out, ssize_t len)
+{
+    char buff[4096];
+    size_t chunk;
+    ssize_t n;
+
+    while (len > 0)
+    {
+        chunk = (len < (ssize_t) sizeof(buff)) ? (size_t) len : sizeof(buff);
+
+        // dropped target, its share is still taken so the copies stay in step
+        if (*out == -1) { n = read(in, buff, chunk); }
+
+        // into the target, through a buffer if it can't be spliced to
+        // (dropping it if that fails too)
+        else if ((n = splice(in, NULL, *out, NULL, len, 0)) == -1 && errno != EINTR)
+        {
+            n = read(in, buff, chunk);
+            if (n > 0 && write(*out, buff, n) != n) { close(*out); *out = -1; }
+        }
+
+        if (n > 0) { len -= n; }
+        else if (n == 0) { return; }
+    }
+}
+
+/* close every fd from 3 up except the n in keep (in the helper, which
+ * doesn't exec so close-on-exec doesn't help) */
+void _fanout_close_others(int * keep, int n)
+{
+    int low = 3;
+    int next;
+    int i;
+
+    while (1)
+    {
+        // lowest kept fd at or above low
+        next = -1;
+        for (i = 0; i < n; i++)
+        {
+            if (keep[i] >= low && (next == -1 || keep[i] < next)) { next = keep[i]; }
+        }
+
+        if (next == -1) { syscall(SYS_close_range, low, ~0U, 0); return; }
+        if (next > low) { syscall(SYS_close_range, low, next - 1, 0); }
+        low = next + 1;
+    }
+}
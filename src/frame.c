@@ -0,0 +1,79 @@
+/*
+ * program  -   smallsh (daemon protocol frames)
+ * author   -   Nicholas Olson
+ */
+
+/*** includes ***/
+#include <stdint.h>     // for fixed size ints
+#include <string.h>     // for memcpy
+#include <errno.h>      // for errno checking
+#include <unistd.h>     // for read
+#include <sys/socket.h> // for send
+#include <arpa/inet.h>  // for htonl
+#include "serve.h"      // protocol
+
+
+/*** interface methods ***/
+/* write a frame of type with len bytes of data to fd
+ * post-condition:  returned -1 if the peer is gone */
+int send_frame(int fd, int type, char * data, int len)
+{
+    // declarations
+    char hdr[FRAME_HDR];
+    uint32_t nlen = htonl(len);
+    int sent = 0;
+    int n;
+
+    // header
+    hdr[0] = type;
+    memcpy(hdr + 1, &nlen, 4);
+    if (send(fd, hdr, FRAME_HDR, MSG_NOSIGNAL) != FRAME_HDR) { return -1; }
+
+    // payload
+    while (sent < len)
+    {
+        n = send(fd, data + sent, len - sent, MSG_NOSIGNAL);
+        if (n == -1 && errno == EINTR) { continue; }
+        if (n <= 0) { return -1; }
+        sent += n;
+    }
+
+    return 0;
+}
+
+/* read a whole frame from fd into buff (payloads larger than size are
+ * cut off) and store its type
+ * post-condition:  returned payload length, -1 on end of stream */
+int recv_frame(int fd, int * type, char * buff, int size)
+{
+    // declarations
+    char hdr[FRAME_HDR];
+    uint32_t nlen;
+    char c;
+    int len;
+    int got = 0;
+    int n;
+
+    // header
+    while (got < FRAME_HDR)
+    {
+        n = read(fd, hdr + got, FRAME_HDR - got);
+        if (n == -1 && errno == EINTR) { continue; }
+        if (n <= 0) { return -1; }
+        got += n;
+    }
+    *type = hdr[0];
+    memcpy(&nlen, hdr + 1, 4);
+    len = ntohl(nlen);
+
+    // payload
+    for (got = 0; got < len; got += n)
+    {
+        if (got < size) { n = read(fd, buff + got, (len < size ? len : size) - got); }
+        else            { n = read(fd, &c, 1); }
+        if (n == -1 && errno == EINTR) { n = 0; continue; }
+        if (n <= 0) { return -1; }
+    }
+
+    return (len < size) ? len : size;
+}
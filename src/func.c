@@ -0,0 +1,232 @@
+/*
+ * library  -   libsmallsh (aliases and functions)
+ * author   -   Nicholas Olson
+ *
+ * Aliases and shell functions, both kept in hash tables by name. An
+ * alias is split into words when it is defined and those words replace
+ * its name at the start of a command. A function body is parsed into a
+ * tree of commands once, when the function is defined (restored from a
+ * startup snapshot, on its first call); a call only binds
+ * the positional parameters ($0..$9, $# and $@) while running that tree.
+ */
+
+/*** includes ***/
+#include <stdlib.h>     // std library stuff
+#include <stdio.h>      // I/O stuff
+#include <string.h>     // for strcmp, strdup
+#include "libsmallsh.h" // private interface
+
+
+/*** hidden methods ***/
+/* replace the alias at the start of each command with its words
+ * pre-condition:   args have been parsed */
+int _expand_aliases(struct CL * cl)
+{
+    // declarations
+    struct ALIAS * alias;
+    int i, j;
+
+    for (i = 0; i < cl->num_args; i++)
+    {
+        // only the first word of a command
+        if (i != 0 && !_cmd_start(cl->args[i-1])) { continue; }
+        if ((alias = _hash_get(&cl->aliases, cl->args[i])) == NULL) { continue; }
+
+        // make room for the words, and move the rest of the args back
+        free(cl->args[i]);
+        while (cl->num_args + alias->num_words >= cl->args_size) { _grow_args(cl); }
+        memmove(cl->args + i + alias->num_words, cl->args + i + 1,
+                (cl->num_args - i) * sizeof(char*));
+
+        for (j = 0; j < alias->num_words; j++) { cl->args[i + j] = strdup(alias->words[j]); }
+        cl->num_args += alias->num_words - 1;
+
+        // words of the alias aren't looked up again
+        i += alias->num_words - 1;
+    }
+
+    return 0;
+}
+
+/* word is followed by the start of a command (an operator, or a
+ * reserved word that a command comes after) */
+int _cmd_start(char * word)
+{
+    static char * before[] = { ";", "&&", "||", "{", ";;", "if", "then", "elif", "else",
+                               "while", "until", "do", NULL };
+    int i;
+
+    for (i = 0; before[i] != NULL; i++)
+    {
+        if (strcmp(word, before[i]) == 0) { return 1; }
+    }
+    return 0;
+}
+
+/* define the function name (a "()" after it is dropped) with the n words
+ * of body, which are copied and parsed
+ * post-condition:  returned 1 on syntax error in the body, 0 otherwise */
+int _define_func(struct CL * cl, char * name, char ** body, int n)
+{
+    // declarations
+    struct FUNC * func = _new_func(body, n);
+    char * key;
+    int len;
+
+    // and parse it, once
+    if ((func->body = _ast_parse(func->args, n)) == NULL)
+    {
+        _free_func(func);
+        return 1;
+    }
+
+    // replaces any function of the same name
+    len = strlen(name);
+    if (len > 2 && strcmp(name + len - 2, "()") == 0) { key = strndup(name, len - 2); }
+    else                                              { key = strdup(name); }
+    _drop_func(_hash_put(&cl->funcs, key, func));
+    free(key);
+
+    return 0;
+}
+
+/* function with a copy of the n words of body, not parsed yet */
+struct FUNC * _new_func(char ** body, int n)
+{
+    // declarations
+    struct FUNC * func;
+    int len;
+    int i;
+
+    // copy the body
+    func = malloc(sizeof(struct FUNC));
+    func->num_args = n;
+    func->args = malloc((n + 1) * sizeof(char*));
+    func->body = NULL;
+    func->running = 0;
+    func->dropped = 0;
+    len = 1;
+    for (i = 0; i < n; i++)
+    {
+        func->args[i] = strdup(body[i]);
+        len += strlen(body[i]) + 1;
+    }
+    func->args[n] = NULL;
+
+    func->text = malloc(len);
+    func->text[0] = '\0';
+    for (i = 0; i < n; i++)
+    {
+        if (i != 0) { strcat(func->text, " "); }
+        strcat(func->text, func->args[i]);
+    }
+
+    return func;
+}
+
+/* run a function with argv as its positional parameters ($0 is its name)
+ * post-condition:  returned -1 if exiting, otherwise result of its body */
+int _call_func(struct CL * cl, struct FUNC * func, int argc, char ** argv)
+{
+    // declarations
+    char ** params = cl->params;
+    int num_params = cl->num_params;
+    int loop_depth = cl->loop_depth;
+    int result;
+
+    // bodies from a snapshot are parsed on their first call
+    if (func->body == NULL && (func->body = _ast_parse(func->args, func->num_args)) == NULL)
+    {
+        _set_status(cl, 1);
+        return 0;
+    }
+
+    if (cl->func_depth == FUNC_DEPTH_MAX)
+    {
+        fprintf(stderr, "smallsh: %s: functions nested too deep\n", argv[0]);
+        fflush(stderr);
+        _set_status(cl, 1);
+        return 0;
+    }
+
+    // bind the parameters and run the parsed body (its loops are its own,
+    // and it is kept if redefined while running)
+    cl->params = argv;
+    cl->num_params = argc;
+    cl->loop_depth = 0;
+    cl->func_depth++;
+    cl->stats.func_calls++;
+    func->running++;
+
+    result = _ast_run(cl, func->args, func->body);
+
+    func->running--;
+    if (func->dropped) { _drop_func(func); }
+    cl->func_depth--;
+    cl->loop_depth = loop_depth;
+    cl->params = params;
+    cl->num_params = num_params;
+
+    return result;
+}
+
+/* split text (the value of an alias) into an alias */
+struct ALIAS * _new_alias(char * text)
+{
+    // declarations
+    struct ALIAS * alias = malloc(sizeof(struct ALIAS));
+    char * copy;
+    char * word;
+    char * save;
+
+    alias->text = strdup(text);
+    alias->words = malloc((strlen(text) / 2 + 2) * sizeof(char*));
+    alias->num_words = 0;
+
+    copy = strdup(text);
+    for (word = strtok_r(copy, " ", &save); word != NULL; word = strtok_r(NULL, " ", &save))
+    {
+        alias->words[alias->num_words++] = strdup(word);
+    }
+    alias->words[alias->num_words] = NULL;
+    free(copy);
+
+    return alias;
+}
+
+/* free an alias (NULL is ignored) */
+void _free_alias(void * ptr)
+{
+    struct ALIAS * alias = ptr;
+    int i;
+
+    if (alias == NULL) { return; }
+    for (i = 0; i < alias->num_words; i++) { free(alias->words[i]); }
+    free(alias->words);
+    free(alias->text);
+    free(alias);
+}
+
+/* free a function removed from the table, once no call is running it
+ * (NULL is ignored) */
+void _drop_func(struct FUNC * func)
+{
+    if (func == NULL) { return; }
+
+    func->dropped = 1;
+    if (func->running == 0) { _free_func(func); }
+}
+
+/* free a function (NULL is ignored) */
+void _free_func(void * ptr)
+{
+    struct FUNC * func = ptr;
+    int i;
+
+    if (func == NULL) { return; }
+    for (i = 0; i < func->num_args; i++) { free(func->args[i]); }
+    free(func->args);
+    _ast_free(func->body);
+    free(func->text);
+    free(func);
+}
@@ -0,0 +1,151 @@
+/*
+ * library  -   libsmallsh (string hash table)
+ * author   -   Nicholas Olson
+ *
+ * Chained hash table from strings to pointers, grown to keep chains
+ * short. Keys are copied, values belong to the caller.
+ */
+
+/*** includes ***/
+#include <stdlib.h>     // std library stuff
+#include <string.h>     // for strcmp, strdup
+#include "libsmallsh.h" // private interface
+
+
+/*** hidden methods ***/
+/* FNV-1a hash of str */
+unsigned long _hash_str(char * str)
+{
+    unsigned long h = 2166136261UL;
+
+    while (*str != '\0') { h = (h ^ (unsigned char) *str++) * 16777619UL; }
+    return h;
+}
+
+/* setup an empty table with size buckets */
+int _hash_init(struct HASH * hash, int size)
+{
+    hash->size = size;
+    hash->len = 0;
+    hash->buckets = calloc(size, sizeof(struct HASH_ENT*));
+    return 0;
+}
+
+/* free a table, calling free_val (if not NULL) on every value */
+void _hash_free(struct HASH * hash, void (*free_val)(void*))
+{
+    struct HASH_ENT * ent;
+    struct HASH_ENT * next;
+    int i;
+
+    for (i = 0; i < hash->size; i++)
+    {
+        for (ent = hash->buckets[i]; ent != NULL; ent = next)
+        {
+            next = ent->next;
+            if (free_val != NULL) { free_val(ent->val); }
+            free(ent->key);
+            free(ent);
+        }
+    }
+    free(hash->buckets);
+    hash->buckets = NULL;
+    hash->len = 0;
+}
+
+/* get the value stored for key
+ * post-condition:  returned NULL if there is none */
+void * _hash_get(struct HASH * hash, char * key)
+{
+    struct HASH_ENT * ent = hash->buckets[_hash_str(key) % hash->size];
+
+    for (; ent != NULL; ent = ent->next)
+    {
+        if (strcmp(ent->key, key) == 0) { return ent->val; }
+    }
+    return NULL;
+}
+
+/* store val for key
+ * post-condition:  returned the value it replaced (NULL if none) */
+void * _hash_put(struct HASH * hash, char * key, void * val)
+{
+    struct HASH_ENT ** slot = &hash->buckets[_hash_str(key) % hash->size];
+    struct HASH_ENT * ent;
+    void * old;
+
+    for (ent = *slot; ent != NULL; ent = ent->next)
+    {
+        if (strcmp(ent->key, key) == 0)
+        {
+            old = ent->val;
+            ent->val = val;
+            return old;
+        }
+    }
+
+    // grow once chains would average more than one entry
+    if (hash->len >= hash->size)
+    {
+        _hash_grow(hash);
+        slot = &hash->buckets[_hash_str(key) % hash->size];
+    }
+
+    ent = malloc(sizeof(struct HASH_ENT));
+    ent->key = strdup(key);
+    ent->val = val;
+    ent->next = *slot;
+    *slot = ent;
+    hash->len++;
+
+    return NULL;
+}
+
+/* remove key from the table
+ * post-condition:  returned its value (NULL if there was none) */
+void * _hash_del(struct HASH * hash, char * key)
+{
+    struct HASH_ENT ** slot = &hash->buckets[_hash_str(key) % hash->size];
+    struct HASH_ENT * ent;
+    void * val;
+
+    for (; (ent = *slot) != NULL; slot = &ent->next)
+    {
+        if (strcmp(ent->key, key) == 0)
+        {
+            *slot = ent->next;
+            val = ent->val;
+            free(ent->key);
+            free(ent);
+            hash->len--;
+            return val;
+        }
+    }
+    return NULL;
+}
+
+/* double the number of buckets, rehashing every entry */
+int _hash_grow(struct HASH * hash)
+{
+    struct HASH_ENT ** old = hash->buckets;
+    struct HASH_ENT * ent;
+    struct HASH_ENT * next;
+    int old_size = hash->size;
+    int i;
+
+    hash->size *= 2;
+    hash->buckets = calloc(hash->size, sizeof(struct HASH_ENT*));
+
+    for (i = 0; i < old_size; i++)
+    {
+        for (ent = old[i]; ent != NULL; ent = next)
+        {
+            next = ent->next;
+            ent->next = hash->buckets[_hash_str(ent->key) % hash->size];
+            hash->buckets[_hash_str(ent->key) % hash->size] = ent;
+        }
+    }
+    free(old);
+
+    return 0;
+}
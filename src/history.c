@@ -0,0 +1,261 @@
+/*
+ * library  -   libsmallsh (command history)
+ * author   -   Nicholas Olson
+ *
+ * Commands are packed one after another into a single string pool, oldest
+ * first, and found through a ring of offsets into it, so an entry costs
+ * its string plus a few bytes of index. A set of the entries (open
+ * addressing, hashed by string, holding their sequence numbers) finds an
+ * older copy of a command, which goes when it is run again, so the
+ * history holds each command once.
+ *
+ * HISTSIZE caps the number of entries; once full the oldest goes. A
+ * removed entry only marks its slot of the ring dead and leaves a hole in
+ * the pool, so removing one costs the same however long the history. The
+ * ring has room for twice HISTSIZE slots and the dead ones are squeezed
+ * out, with the pool's holes, in one pass once it is full, or once the
+ * pool runs out of room and holes take up a third of it; either way the
+ * pass is paid for by the removals before it. Only that amortized cost is
+ * bounded: the add that sets off a pass waits for all of it, which is a
+ * fraction of a millisecond at the default HISTSIZE but about 0.2 s at
+ * HISTORY_SIZE_MAX.
+ */
+
+/*** includes ***/
+#include <stdlib.h>     // std library stuff
+#include <string.h>     // for strcmp, strlen, memmove
+#include "libsmallsh.h" // private interface
+
+
+/*** hidden methods ***/
+/* add string to command history, an older copy of it goes (it is kept
+ * where it was last run) */
+int _add_to_hist(struct CL * cl, char * command)
+{
+    // declarations
+    unsigned int len = strlen(command) + 1;
+    int slot;
+
+    // if command is empty
+    if (command[0] == '\0') { return 1; }
+
+    // HISTSIZE may have changed
+    _history_limit(cl);
+    if (cl->hist_max == 0) { return 1; }
+
+    // older copy goes, or the oldest once full
+    if ((slot = _history_find(cl, command)) != -1)
+    {
+        _history_remove(cl, cl->hist_set[slot] - 1 - cl->hist_base, slot);
+    }
+    else if (cl->hist_live == cl->hist_max)
+    {
+        _history_remove(cl, 0, _history_find(cl, _history_get(cl, 0)));
+    }
+
+    // room for a slot, there are at least as many dead ones as live
+    if (cl->hist_len == cl->hist_cap) { _history_compact(cl); }
+
+    // room at the end of the pool, holes are squeezed out first if there
+    // are enough of them
+    if (cl->hist_used + len > cl->hist_pool_size)
+    {
+        if (cl->hist_dead * 3 >= cl->hist_used) { _history_compact(cl); }
+        while (cl->hist_used + len > cl->hist_pool_size) { cl->hist_pool_size *= 2; }
+        cl->hist_pool = realloc(cl->hist_pool, cl->hist_pool_size);
+    }
+
+    // add new element
+    memcpy(cl->hist_pool + cl->hist_used, command, len);
+    cl->hist_ring[(cl->hist_head + cl->hist_len) % cl->hist_cap] = cl->hist_used;
+    _history_set(cl, cl->hist_len);
+    cl->hist_used += len;
+    cl->hist_len++;
+    cl->hist_live++;
+
+    // move curr_idx
+    cl->curr_idx = cl->hist_len;
+
+    return 0;
+}
+
+/* entry idx of the history (0 is the oldest slot)
+ * pre-condition:   idx < cl->hist_len
+ * post-condition:  returned NULL if the entry was removed */
+char * _history_get(struct CL * cl, int idx)
+{
+    unsigned int off = cl->hist_ring[(cl->hist_head + idx) % cl->hist_cap];
+
+    return (off == HISTORY_DEAD) ? NULL : cl->hist_pool + off;
+}
+
+/* slot of the set holding command
+ * post-condition:  returned slot, -1 if it isn't in the history */
+int _history_find(struct CL * cl, char * command)
+{
+    unsigned int mask = cl->hist_set_size - 1;
+    unsigned int i = _hash_str(command) & mask;
+
+    while (cl->hist_set[i] != 0)
+    {
+        if (strcmp(_history_get(cl, cl->hist_set[i] - 1 - cl->hist_base), command) == 0) { return i; }
+        i = (i + 1) & mask;
+    }
+    return -1;
+}
+
+/* add entry idx to the set, by its sequence number (+ 1, 0 is empty) */
+void _history_set(struct CL * cl, int idx)
+{
+    unsigned int mask = cl->hist_set_size - 1;
+    unsigned int i = _hash_str(_history_get(cl, idx)) & mask;
+
+    while (cl->hist_set[i] != 0) { i = (i + 1) & mask; }
+    cl->hist_set[i] = cl->hist_base + idx + 1;
+}
+
+/* take slot out of the set, later entries of its run move back so none
+ * is cut off from where it hashes to */
+void _history_unset(struct CL * cl, int slot)
+{
+    unsigned int mask = cl->hist_set_size - 1;
+    unsigned int i = slot;
+    unsigned int j = slot;
+    unsigned int k;
+
+    for (;;)
+    {
+        j = (j + 1) & mask;
+        if (cl->hist_set[j] == 0) { break; }
+
+        // entry at j can fill the hole unless it hashes between i and j
+        k = _hash_str(_history_get(cl, cl->hist_set[j] - 1 - cl->hist_base)) & mask;
+        if ((i <= j) ? (i < k && k <= j) : (i < k || k <= j)) { continue; }
+        cl->hist_set[i] = cl->hist_set[j];
+        i = j;
+    }
+    cl->hist_set[i] = 0;
+}
+
+/* take entry idx (in slot of the set) out of the history, its slot of
+ * the ring is marked dead and its bytes left in the pool until they are
+ * compacted (dead slots at the front go right away) */
+void _history_remove(struct CL * cl, int idx, int slot)
+{
+    cl->hist_dead += strlen(_history_get(cl, idx)) + 1;
+    _history_unset(cl, slot);
+    cl->hist_ring[(cl->hist_head + idx) % cl->hist_cap] = HISTORY_DEAD;
+    cl->hist_live--;
+
+    while (cl->hist_len > 0 && cl->hist_ring[cl->hist_head] == HISTORY_DEAD)
+    {
+        cl->hist_head = (cl->hist_head + 1) % cl->hist_cap;
+        cl->hist_base++;
+        cl->hist_len--;
+    }
+    if (cl->curr_idx > cl->hist_len) { cl->curr_idx = cl->hist_len; }
+
+    // nothing left, the pool starts over
+    if (cl->hist_len == 0) { cl->hist_used = 0; cl->hist_dead = 0; }
+}
+
+/* squeeze the dead slots out of the ring and the holes out of the pool,
+ * in place (entries move towards the start, in order, so none is written
+ * over before it has moved), one pass over the whole history and set */
+void _history_compact(struct CL * cl)
+{
+    unsigned int to = 0;
+    unsigned int len;
+    char * entry;
+    int live = 0;
+    int i;
+
+    for (i = 0; i < cl->hist_len; i++)
+    {
+        if ((entry = _history_get(cl, i)) == NULL) { continue; }
+        len = strlen(entry) + 1;
+        memmove(cl->hist_pool + to, entry, len);
+
+        // (slot live is at or before slot i, it has been read already)
+        cl->hist_ring[(cl->hist_head + live) % cl->hist_cap] = to;
+        live++;
+        to += len;
+    }
+    cl->hist_used = to;
+    cl->hist_dead = 0;
+    cl->hist_len = live;
+    cl->curr_idx = live;
+
+    // sequence numbers start over
+    cl->hist_base = 0;
+    memset(cl->hist_set, 0, cl->hist_set_size * sizeof(unsigned int));
+    for (i = 0; i < cl->hist_len; i++) { _history_set(cl, i); }
+}
+
+/* size the history for HISTSIZE (HISTORY_SIZE if unset or bad), the
+ * newest entries that fit are kept */
+int _history_limit(struct CL * cl)
+{
+    // declarations
+    char * val = _var_get(cl, HISTORY_ENV);
+    char * end;
+    long max = HISTORY_SIZE;
+    unsigned int * ring;
+    char * entry;
+    int cap;
+    int len = 0;
+    int i;
+
+    if (val[0] != '\0')
+    {
+        max = strtol(val, &end, 10);
+        if (*end != '\0' || max < 0) { max = HISTORY_SIZE; }
+        if (max > HISTORY_SIZE_MAX)  { max = HISTORY_SIZE_MAX; }
+    }
+    if (cl->hist_ring != NULL && max == cl->hist_max) { return 0; }
+
+    // first time
+    if (cl->hist_pool == NULL)
+    {
+        cl->hist_pool_size = HISTORY_POOL;
+        cl->hist_pool = malloc(cl->hist_pool_size);
+    }
+
+    // oldest go, the live rest start the new ring
+    while (cl->hist_live > max) { _history_remove(cl, 0, _history_find(cl, _history_get(cl, 0))); }
+    cap = (max > 0) ? 2 * max : 1;
+    ring = malloc(cap * sizeof(unsigned int));
+    for (i = 0; i < cl->hist_len; i++)
+    {
+        if ((entry = _history_get(cl, i)) != NULL) { ring[len++] = entry - cl->hist_pool; }
+    }
+    free(cl->hist_ring);
+    cl->hist_ring = ring;
+    cl->hist_head = 0;
+    cl->hist_len = len;
+    cl->hist_cap = cap;
+    cl->hist_max = max;
+
+    // set at most half full
+    for (cl->hist_set_size = 16; cl->hist_set_size < 2 * max; cl->hist_set_size *= 2) { }
+    free(cl->hist_set);
+    cl->hist_set = calloc(cl->hist_set_size, sizeof(unsigned int));
+
+    // (fills the set), a pool sized for a bigger history shrinks
+    _history_compact(cl);
+    if (cl->hist_pool_size > HISTORY_POOL && cl->hist_pool_size > 4 * cl->hist_used)
+    {
+        cl->hist_pool_size = (cl->hist_used * 2 > HISTORY_POOL) ? cl->hist_used * 2 : HISTORY_POOL;
+        cl->hist_pool = realloc(cl->hist_pool, cl->hist_pool_size);
+    }
+
+    return 0;
+}
+
+/* free the history */
+void _history_free(struct CL * cl)
+{
+    free(cl->hist_pool);
+    free(cl->hist_ring);
+    free(cl->hist_set);
+}
@@ -0,0 +1,3626 @@
+/*
+ * library  -   libsmallsh
+ * author   -   Nicholas Olson
+ */
+
+/*** includes ***/
+#define _GNU_SOURCE     // for pipe2 and memfd_create
+#include <stdlib.h>     // std library stuff
+#include <stdio.h>      // I/O stuff
+#include <unistd.h>     // launching processess
+#include <string.h>     // for strlen, strcmp, etc
+#include <errno.h>      // for errno checking
+#include <sys/types.h>  // for opening
+#include <fcntl.h>      // for opening
+#include <sys/stat.h>   // for opening
+#include <signal.h>     // for signal control
+#include <termios.h>    // for terminal attr control
+#include <sys/wait.h>   // for waitpid
+#include <sys/epoll.h>  // for the event loop
+#include <sys/signalfd.h> // for reading signals in the event loop
+#include <sys/timerfd.h>  // for timers in the event loop
+#include <sys/mman.h>   // for memfd backed capture buffers and heredocs
+#include <stdint.h>     // for fixed size ints
+#include <sys/syscall.h>  // for pidfd_open and pidfd_send_signal
+#include <limits.h>     // for PATH_MAX
+#include <time.h>       // for visit times of "z"
+#include "libsmallsh.h" // private interface
+
+
+/*** built-in table ***/
+struct BUILTIN {
+    char * name;
+    builtin_fn func;
+} builtins[] = {
+    { "cd",     _CL_cd },
+    { "exit",   _CL_exit },
+    { "status", _CL_status },
+    { "jobs",   _CL_jobs },
+    { "tail",   _CL_tail },
+    { "timeout", _CL_timeout },
+    { "fg",     _CL_fg },
+    { "bg",     _CL_bg },
+    { "wait",   _CL_wait },
+    { "stats",  _CL_stats },
+    { "alias",  _CL_alias },
+    { "unalias", _CL_unalias },
+    { "functions", _CL_functions },
+    { "unfunction", _CL_unfunction },
+    { "true",   _CL_true },
+    { "false",  _CL_false },
+    { "test",   _CL_test },
+    { "[",      _CL_test },
+    { "break",  _CL_break },
+    { "continue", _CL_break },
+    { "unset",  _CL_unset },
+    { "let",    _CL_let },
+    { "prompt", _CL_prompt },
+    { "sched",  _CL_sched },
+    { "tasks",  _CL_tasks },
+    { "pushd",  _CL_pushd },
+    { "popd",   _CL_popd },
+    { "dirs",   _CL_dirs },
+    { "z",      _CL_z },
+    { NULL,     NULL }
+};
+
+
+/*** interface methods ***/
+/* create a new session
+ * post-condition:  returned NULL if out of memory */
+struct CL * new_CL(int flags)
+{
+    struct CL * cl = malloc(sizeof(struct CL));
+
+    if (cl != NULL) { setup_CL(cl, flags); }
+    return cl;
+}
+
+/* destroy a session created with new_CL */
+void delete_CL(struct CL * cl)
+{
+    free_CL(cl);
+    free(cl);
+}
+
+/* allocate memory for CL struct */
+int setup_CL(struct CL * cl, int flags)
+{
+    // declarations
+    char * tmp;
+    char * res;
+    int i;
+
+    // initializations
+    cl->pwd_size = PWD_BUFF_SIZE;
+    cl->pwd_len = 0;
+    cl->num_args = 0;
+    cl->job_len = 0;
+    cl->job_size = 5;
+    cl->flags = flags;
+    cl->capture = (flags & CL_CAPTURE) != 0;
+    cl->bg_block_mode = 0;
+    cl->bg_quiet = 0;
+    cl->fg_status = 0;
+    cl->is_child = 0;
+    cl->fg_signaled = 0;
+    cl->fg_exited = 1;
+    cl->fg_ran = 0;
+    cl->fg_timed_out = 0;
+    cl->timeout_ms = 0;
+    cl->next_timeout_ms = -1;
+    cl->fanout_pid = 0;
+    cl->path = NULL;
+    cl->path_len = 0;
+    cl->hist_pool = NULL;
+    cl->hist_pool_size = 0;
+    cl->hist_used = 0;
+    cl->hist_dead = 0;
+    cl->hist_ring = NULL;
+    cl->hist_head = 0;
+    cl->hist_len = 0;
+    cl->hist_cap = 0;
+    cl->hist_live = 0;
+    cl->hist_max = 0;
+    cl->hist_base = 0;
+    cl->hist_set = NULL;
+    cl->hist_set_size = 0;
+    cl->curr_idx = 0;
+    cl->child_pending = 0;
+    cl->child_ready = 0;
+    cl->mode_changed = 0;
+    cl->line = NULL;
+    cl->in_pend_len = 0;
+    cl->in_pend_pos = 0;
+    cl->in_off = 0;
+    cl->watches = NULL;
+    cl->watch_len = 0;
+    cl->watch_size = 0;
+    memset(&cl->stats, 0, sizeof(cl->stats));
+    _hash_init(&cl->cmd_cache, CMD_CACHE_SIZE);
+    _hash_init(&cl->aliases, NAME_TABLE_SIZE);
+    _hash_init(&cl->funcs, NAME_TABLE_SIZE);
+    _hash_init(&cl->vars, NAME_TABLE_SIZE);
+    cl->params = NULL;
+    cl->num_params = 0;
+    cl->func_depth = 0;
+    cl->loop_depth = 0;
+    cl->loop_ctl = 0;
+    cl->loop_levels = 0;
+    cl->expand_err = 0;
+    cl->prompt_fmt = strdup(PROMPT_DEFAULT);
+    cl->prompt_fd = -1;
+    cl->prompt_asked = 0;
+    _hash_init(&cl->prompt_dirs, NAME_TABLE_SIZE);
+    cl->prompt_load[0] = '\0';
+    cl->prompt_load_us = 0;
+    cl->sched = NULL;
+    cl->sched_len = 0;
+    cl->sched_size = 0;
+    cl->sched_ids = 0;
+    cl->sched_fd = -1;
+    cl->dirs = NULL;
+    cl->dirs_len = 0;
+    cl->dirs_size = 0;
+    _hash_init(&cl->z_dirs, NAME_TABLE_SIZE);
+    _hash_init(&cl->suggest_dirs, NAME_TABLE_SIZE);
+    cl->suggest_builtins = NULL;
+    cl->suggest = NULL;
+    cl->snap = NULL;
+    cl->snap_size = 0;
+    cl->snap_cmds = -1;
+    cl->rc_pure = 0;
+    cl->z_loaded = 0;
+    cl->z_lines = 0;
+    cl->z_total = 0;
+
+    // mallocs
+    cl->buffer_size = CL_BUFF_SIZE;
+    cl->args_size = CL_ARGS_SIZE;
+    cl->buffer = malloc(cl->buffer_size * sizeof(char));
+    cl->args = malloc(cl->args_size * sizeof(char*));
+    cl->pwd = malloc(cl->pwd_size * sizeof(char));
+    cl->jobs = malloc(cl->job_size * sizeof(struct JOB));
+
+    // launcher forked while the session is still small
+    cl->zyg_fd = -1;
+    if (flags & CL_ZYGOTE) { _zygote_start(cl); }
+
+    // set initial pwd
+    _dirs_init(cl);
+
+    // setup event loop
+    _ev_setup(cl);
+
+    return 0;
+}
+
+/* free memory for CL struct
+ * pre-condition:   cl has been setup using setup_CL */
+int free_CL(struct CL * cl)
+{
+    // declarations
+    int i;
+
+    // final statistics, if asked for
+    _stats_snapshot(cl);
+
+    // only done for malloc'd args
+    for (i = 0; i < cl->num_args; i++)
+    {
+        free(cl->args[i]);
+    }
+
+    // only done for malloc'd paths
+    for (i = 0; i < cl->path_len; i++)
+    {
+        free(cl->path[i]);
+    }
+
+    // only done for jobs still in the list (stopped ones are hung up,
+    // they would never be continued otherwise)
+    while (cl->job_len > 0)
+    {
+        struct JOB * job = &cl->jobs[cl->job_len - 1];
+        if (!job->done && job->stopped)
+        {
+            _job_kill(job->pid, job->pidfd, SIGHUP);
+            _job_kill(job->pid, job->pidfd, SIGCONT);
+        }
+        _remove_job(cl, cl->job_len - 1);
+    }
+
+    // frees
+    free(cl->buffer);
+    free(cl->args);
+    free(cl->jobs);
+    free(cl->pwd);
+    free(cl->path);
+    _history_free(cl);
+    for (i = 0; i < cl->dirs_len; i++) { free(cl->dirs[i]); }
+    free(cl->dirs);
+    _hash_free(&cl->z_dirs, free);
+    _hash_free(&cl->suggest_dirs, _bk_free);
+    _bk_free(cl->suggest_builtins);
+    free(cl->suggest);
+    if (cl->snap != NULL) { munmap(cl->snap, cl->snap_size); }
+    free(cl->watches);
+    _hash_free(&cl->cmd_cache, free);
+    _hash_free(&cl->aliases, _free_alias);
+    _hash_free(&cl->funcs, _free_func);
+    _hash_free(&cl->vars, free);
+    _hash_free(&cl->prompt_dirs, _prompt_free_dir);
+    free(cl->prompt_fmt);
+    for (i = 0; i < cl->sched_len; i++) { _sched_free(cl->sched[i]); }
+    free(cl->sched);
+    if (cl->sched_fd != -1) { close(cl->sched_fd); }
+
+    // stop helpers
+    _zygote_stop(cl);
+    _prompt_stop(cl);
+
+    // close event loop, giving signals back to the process
+    _wheel_free(cl);
+    close(cl->ev_fd);
+    close(cl->timer_fd);
+    if (cl->sig_fd != -1)
+    {
+        close(cl->sig_fd);
+        sigprocmask(SIG_SETMASK, &cl->old_mask, NULL);
+    }
+
+    return 0;
+}
+
+/* parse and execute command in "input" using CL struct "cl"
+ * pre-condition:   CL struct has been setup
+ * post-condition:  returned 1 if parsing error,
+ *                  returned 2 if execution error,
+ *                  returned -1 if successful but exiting
+ *                  returned 0 if successful */
+int run_CL(struct CL * cl, char * input)
+{
+    long start = _now_us();
+    long end;
+    int result;
+
+    // time since the last line was spent at the prompt
+    if (cl->stats.last_us != 0) { cl->stats.prompt_us += start - cl->stats.last_us; }
+
+    result = _run_line(cl, input);
+
+    end = _now_us();
+    cl->stats.last_us = end;
+    cl->stats.exec_us += end - start;
+    _hist_add(&cl->stats.run, end - start);
+
+    return result;
+}
+
+/* get status of the last foreground command
+ * post-condition:  returned exit value (or signal number if *signaled) */
+int status_CL(struct CL * cl, int * signaled)
+{
+    if (signaled != NULL) { *signaled = cl->fg_signaled; }
+    return cl->fg_status;
+}
+
+/* get the job at idx (0 is the oldest) for iterating the job list
+ * post-condition:  returned -1 if there is no job at idx */
+int job_CL(struct CL * cl, int idx, struct CL_JOB * job)
+{
+    if (idx < 0 || idx >= cl->job_len) { return -1; }
+
+    job->id = cl->jobs[idx].id;
+    job->pid = cl->jobs[idx].pid;
+    job->done = cl->jobs[idx].done;
+    job->stopped = cl->jobs[idx].stopped;
+    job->cmd = cl->jobs[idx].cmd;
+    return 0;
+}
+
+/* parse and execute a line (run_CL without the statistics) */
+int _run_line(struct CL * cl, char * input)
+{
+    long start = _now_us();
+    struct NODE * tree;
+    int result;
+
+    // drop the previous line
+    clear_CL(cl);
+
+    // parse into CL, then into a tree of commands
+    if (_parse_input(cl, input) != 0) { return 1; }
+    _expand_aliases(cl);
+    tree = _ast_parse(cl->args, cl->num_args);
+    _hist_add(&cl->stats.parse, _now_us() - start);
+    if (tree == NULL)
+    {
+        // syntax error, set status
+        cl->fg_status = 1;
+        cl->fg_exited = 1;
+        cl->fg_signaled = 0;
+        return 1;
+    }
+
+    // execute commands ("break" and "continue" end at the line)
+    result = _ast_run(cl, cl->args, tree);
+    _ast_free(tree);
+    cl->loop_ctl = 0;
+    if (result > 0) { return result; }
+    else if (result == -1) { return -1; }
+
+    // return
+    return 0;
+}
+
+/* get the fd of the session's event loop, it is readable whenever
+ * poll_CL has something to handle (for use in a caller's own loop) */
+int fd_CL(struct CL * cl)
+{
+    return cl->ev_fd;
+}
+
+/* handle pending events (signals, job output, finished jobs), waiting
+ * up to timeout ms (-1 forever) for one to arrive
+ * post-condition:  returned number of jobs finished or messages printed */
+int poll_CL(struct CL * cl, int timeout)
+{
+    int n;
+
+    _ev_wait(cl, timeout);
+    n = pid_check_CL(cl);
+    return n + sched_CL(cl);
+}
+
+/* call func(cl, fd, data) from the session's event loop whenever fd is
+ * readable, including while a foreground command is being waited on
+ * post-condition:  returned -1 if fd can't be watched */
+int watch_CL(struct CL * cl, int fd, watch_fn func, void * data)
+{
+    struct epoll_event ev = {0};
+
+    ev.events = EPOLLIN;
+    ev.data.u64 = EV_WATCH | ((uint64_t) fd << 32);
+    if (epoll_ctl(cl->ev_fd, EPOLL_CTL_ADD, fd, &ev) == -1) { return -1; }
+
+    // check if watch list needs to grow
+    if (cl->watch_len == cl->watch_size)
+    {
+        cl->watch_size = cl->watch_size ? cl->watch_size * 2 : 4;
+        cl->watches = realloc(cl->watches, cl->watch_size * sizeof(struct WATCH));
+    }
+
+    cl->watches[cl->watch_len].fd = fd;
+    cl->watches[cl->watch_len].func = func;
+    cl->watches[cl->watch_len].data = data;
+    cl->watch_len++;
+
+    return 0;
+}
+
+/* stop watching fd */
+int unwatch_CL(struct CL * cl, int fd)
+{
+    int i;
+
+    epoll_ctl(cl->ev_fd, EPOLL_CTL_DEL, fd, NULL);
+    for (i = 0; i < cl->watch_len; i++)
+    {
+        if (cl->watches[i].fd == fd)
+        {
+            cl->watches[i] = cl->watches[--cl->watch_len];
+            break;
+        }
+    }
+
+    return 0;
+}
+
+/* clear the command line struct back to default state */
+int clear_CL(struct CL * cl)
+{
+    int i;
+
+    // free arguments
+    for (i = 0; i < cl->num_args; i++)
+    {
+        free(cl->args[i]);
+    }
+
+    // reset vars
+    cl->num_args = 0;
+    cl->buffer[0] = '\0';
+}
+
+/* checks if the background processes have completed
+ * post-condition:  returned number of messages printed */
+int pid_check_CL(struct CL * cl)
+{
+    int printed = 0;
+    int result;
+    int i;
+
+    // pick up signals received since last check
+    _ev_signals(cl);
+
+    // check for bg blocking mode change
+    if (cl->mode_changed == 1)
+    {
+        _msg_begin(cl);
+        if (cl->bg_block_mode == 1)
+        {
+            fputs("Entering foreground-only mode (& is now ignored)\n", stdout);
+        }
+        else if (cl->bg_block_mode == 0)
+        {
+            fputs("Exiting foreground-only mode\n", stdout);
+        }
+        cl->mode_changed = 0;
+        printed++;
+    }
+
+    // stopped (e.g. by reading the terminal) or continued jobs, only
+    // known to sessions that get SIGCHLD
+    if (cl->child_pending && cl->sig_fd != -1) { printed += _job_stops(cl); }
+
+    // nothing has exited since last check
+    if (cl->child_pending == 0 && cl->child_ready == 0) { fflush(stdout); return printed; }
+    int pending = cl->child_pending;
+    cl->child_pending = 0;
+    cl->child_ready = 0;
+
+    for(i = 0; i < cl->job_len; i++)
+    {
+        struct JOB * job = &cl->jobs[i];
+        if (job->done) { continue; }
+
+        // jobs with a pidfd are only checked once it said they exited,
+        // the rest whenever any child did
+        if (job->pidfd != -1 ? !job->ready : !pending) { continue; }
+        job->ready = 0;
+
+        // get whether bg process has exited
+        pid_t cpid = 0;
+        result = 0;
+        cpid = waitpid(job->pid, &result, WNOHANG);
+        if (cpid <= 0 || (!WIFEXITED(result) && !WIFSIGNALED(result)))
+        {
+            continue;
+        }
+
+        // deadline is done with once the job is reaped
+        char * timed_out = "";
+        if (job->deadline != NULL && job->deadline->stage != 0) { timed_out = "timed out, "; }
+        _wheel_cancel(cl, job->deadline);
+        job->deadline = NULL;
+
+        // helpers of process substitutions go quietly
+        if (job->helper)
+        {
+            job->done = 1;
+            job->status = result;
+            cl->stats.jobs_reaped++;
+            if (!job->waited) { _remove_job(cl, i); i--; }
+            continue;
+        }
+
+        _msg_begin(cl);
+        if (WIFEXITED(result))
+        {
+            printf("background pid %d is done: %sexit value %d\n",
+                        job->pid, timed_out, WEXITSTATUS(result));
+        }
+        else
+        {
+            printf("\nbackground pid %d is done: %sterminated by signal %d\n",
+                        job->pid, timed_out, WTERMSIG(result));
+        }
+        printed++;
+
+        // keep captured output (and jobs "wait" wants) around, drop
+        // anything else
+        job->done = 1;
+        job->status = result;
+        cl->stats.jobs_reaped++;
+        if (job->out != NULL)  { _job_drain(cl, job); }
+        else if (!job->waited) { _remove_job(cl, i); i--; }
+    }
+    fflush(stdout);
+
+    // bound the number of finished jobs kept for their output
+    result = 0;
+    for (i = cl->job_len - 1; i >= 0; i--)
+    {
+        if (cl->jobs[i].done && !cl->jobs[i].waited && ++result > CAPTURE_KEEP)
+        {
+            _remove_job(cl, i);
+        }
+    }
+
+    return printed;
+}
+
+
+/*** hidden methods ***/
+/* clear the prompt (if at it) so an async message prints above it */
+void _msg_begin(struct CL * cl)
+{
+    if (cl->line == NULL || cl->line->hidden) { return; }
+
+    // terminals get the line erased, anything else a newline
+    if (cl->is_tty) { fputs("\r\033[K", stdout); }
+    else            { putchar('\n'); }
+    cl->line->hidden = 1;
+}
+
+/* parses the "input" string into a CL struct, its lines are separate
+ * commands (as if joined by ";") apart from here-document bodies
+ * pre-condition:   cl has been setup */
+int _parse_input(struct CL * cl, char * input)
+{
+    // declarations
+    char * rest;
+    char * line;
+    char * nl;
+    char * last;
+    int first;
+    int len;
+
+    // make room for the whole line (pasted lines can be long)
+    len = strlen(input);
+    if (len + 1 > cl->buffer_size)
+    {
+        cl->buffer_size = len + 1;
+        cl->buffer = realloc(cl->buffer, cl->buffer_size * sizeof(char));
+    }
+
+    // copy input into buffer
+    strcpy(cl->buffer, input);
+
+    // set first arg to null for now
+    cl->args[0] = NULL;
+
+    for (rest = cl->buffer; rest != NULL; )
+    {
+        // next line
+        line = rest;
+        rest = NULL;
+        if ((nl = strchr(line, '\n')) != NULL)
+        {
+            *nl = '\0';
+            rest = nl + 1;
+        }
+
+        // check for comment
+        if (line[0] == '#') { continue; }
+
+        // words of the line, then the bodies of its here-documents
+        first = cl->num_args;
+        _parse_words(cl, line, strlen(line));
+        cl->args[cl->num_args] = (char*) NULL;
+        if (_parse_arith(cl, first) != 0) { return 1; }
+        if (_parse_procsubs(cl, first) != 0) { return 1; }
+        if (_parse_heredocs(cl, first, &rest) != 0) { return 1; }
+
+        // end the line's command, unless it goes on with an operator
+        last = (cl->num_args > first) ? cl->args[cl->num_args - 1] : NULL;
+        if (rest != NULL && last != NULL && strcmp(last, "&&") != 0 && strcmp(last, "||") != 0)
+        {
+            if (cl->num_args + 1 == cl->args_size) { _grow_args(cl); }
+            cl->args[cl->num_args++] = strdup(";");
+            cl->args[cl->num_args] = (char*) NULL;
+        }
+    }
+
+    // return
+    return 0;
+}
+
+/* parse the len chars of line into words (split at spaces and tabs, and
+ * around ";", ";;", "&&" and "||") added to the args, with "$$" replaced
+ * by the pid */
+int _parse_words(struct CL * cl, char * line, int len)
+{
+    // declarations
+    int start = 0;
+    int end = 0;
+
+    // operators are words of their own however they are spaced
+    line = _split_ops(line, len);
+    len = strlen(line);
+
+    // parse into args array
+    for (end = 0; end < len; end++)
+    {
+        // beginning and/or end of word
+        if ((line[end] == ' ') || (line[end] == '\t') || (end == len - 1))
+        {
+            // if there has been at least one char since last space
+            if ((end - start > 0) || ((end == len - 1) && (line[end] != ' ') && (line[end] != '\t')))
+            {
+                if (end == len - 1 && line[end] != ' ' && line[end] != '\t') { end++; }
+                if (cl->num_args + 1 == cl->args_size) { _grow_args(cl); }
+                cl->args[cl->num_args] = malloc((end - start + 1) * sizeof(char));
+                sprintf(cl->args[cl->num_args], "%.*s\0", (end - start), (line + start));
+
+                // check for $$
+                char * wow = strstr(cl->args[cl->num_args], "$$");
+                if (wow != NULL)
+                {
+                    // get pid
+                    pid_t pid = getpid();
+                    char pid_buff[100]; // RIP pids longer than 100 digits
+                    sprintf(pid_buff, "%d\0", pid);
+
+                    // copy arg into tmp
+                    char * tmp = malloc((end - start + 1) * sizeof(char));
+                    strcpy(tmp, cl->args[cl->num_args]);
+
+                    // cut-off string before &&
+                    wow = tmp + (wow - cl->args[cl->num_args]);
+                    wow[0] = '\0';
+
+                    // re-allocate arg buffer
+                    free(cl->args[cl->num_args]);
+                    cl->args[cl->num_args] = malloc((strlen(pid_buff)+(end-start+1))*sizeof(char));
+
+                    // compile full string 
+                    sprintf(cl->args[cl->num_args], "%s%s%s", tmp, pid_buff, (wow+2));
+
+                    // free tmp
+                    free(tmp);
+                }
+
+                cl->num_args += 1;
+            }
+
+            // move start forward
+            start = end + 1;
+        }
+    }
+
+    // return
+    free(line);
+    return 0;
+}
+
+/* copy of the len chars of line with a space either side of each ";",
+ * ";;", "&&" and "||" ("&" and "|" alone are left, the first ends a
+ * background command and the second separates case patterns)
+ * post-condition:  returned malloc'd string */
+char * _split_ops(char * line, int len)
+{
+    // declarations
+    char * out = malloc(3 * len + 1);
+    int op;
+    int i;
+    int n = 0;
+
+    for (i = 0; i < len; i++)
+    {
+        if      (line[i] == ';') { op = (i + 1 < len && line[i+1] == ';') ? 2 : 1; }
+        else if ((line[i] == '&' || line[i] == '|') && i + 1 < len && line[i+1] == line[i]) { op = 2; }
+        else { out[n++] = line[i]; continue; }
+
+        out[n++] = ' ';
+        memcpy(out + n, line + i, op);
+        n += op;
+        out[n++] = ' ';
+        i += op - 1;
+    }
+    out[n] = '\0';
+
+    return out;
+}
+
+/* join the words of each "$(( expr ))" from arg "from" on into one arg,
+ * and make each "(( expr ))" command "let" with expr as its arg
+ * pre-condition:   args have been parsed
+ * post-condition:  returned 1 if one is missing its "))" */
+int _parse_arith(struct CL * cl, int from)
+{
+    // declarations
+    char * joined;
+    char * c;
+    int is_cmd;
+    int depth;
+    int len;
+    int i, j, k;
+
+    for (i = from; i < cl->num_args; i++)
+    {
+        is_cmd = (strncmp(cl->args[i], "((", 2) == 0 && (i == 0 || _cmd_start(cl->args[i-1])));
+        if (!is_cmd && strstr(cl->args[i], "$((") == NULL) { continue; }
+
+        // up to the word its parentheses are closed in
+        len = 0;
+        depth = 0;
+        for (j = i; j < cl->num_args; j++)
+        {
+            len += strlen(cl->args[j]) + 1;
+            for (c = cl->args[j]; *c != '\0'; c++)
+            {
+                if      (*c == '(') { depth++; }
+                else if (*c == ')') { depth--; }
+            }
+            if (depth <= 0) { break; }
+        }
+        if (j == cl->num_args)
+        {
+            fprintf(stderr, "smallsh: syntax error near \"%s\" (missing \"))\")\n", cl->args[i]);
+            fflush(stderr);
+            return 1;
+        }
+
+        // one arg with the words separated by spaces
+        joined = malloc(len);
+        joined[0] = '\0';
+        for (k = i; k <= j; k++)
+        {
+            if (k != i) { strcat(joined, " "); }
+            strcat(joined, cl->args[k]);
+            free(cl->args[k]);
+        }
+        cl->args[i] = joined;
+
+        // move the following args up
+        memmove(cl->args + i + 1, cl->args + j + 1, (cl->num_args - j) * sizeof(char*));
+        cl->num_args -= j - i;
+
+        // "((expr))" is "let expr"
+        len = strlen(joined);
+        if (is_cmd && len >= 4 && strcmp(joined + len - 2, "))") == 0)
+        {
+            if (cl->num_args + 1 == cl->args_size) { _grow_args(cl); }
+            memmove(cl->args + i + 1, cl->args + i, (cl->num_args - i + 1) * sizeof(char*));
+            cl->num_args++;
+            cl->args[i] = strdup("let");
+            cl->args[i+1] = strndup(joined + 2, len - 4);
+            free(joined);
+            i++;
+        }
+    }
+
+    return 0;
+}
+
+/* join the words of each "<(cmd ...)" and ">(cmd ...)" from arg "from"
+ * on into one arg
+ * pre-condition:   args have been parsed
+ * post-condition:  returned 1 if one is missing its ")" */
+int _parse_procsubs(struct CL * cl, int from)
+{
+    // declarations
+    char * joined;
+    int len;
+    int i, j, k;
+
+    for (i = from; i < cl->num_args; i++)
+    {
+        if (strncmp(cl->args[i], "<(", 2) != 0 && strncmp(cl->args[i], ">(", 2) != 0) { continue; }
+
+        // up to the word ending in ")"
+        len = 0;
+        for (j = i; j < cl->num_args; j++)
+        {
+            len += strlen(cl->args[j]) + 1;
+            if (cl->args[j][strlen(cl->args[j]) - 1] == ')' && strlen(cl->args[j]) > (j == i ? 2 : 0)) { break; }
+        }
+        if (j == cl->num_args)
+        {
+            fprintf(stderr, "smallsh: syntax error near \"%.2s\" (missing \")\")\n", cl->args[i]);
+            fflush(stderr);
+            return 1;
+        }
+
+        // one arg with the words separated by spaces
+        joined = malloc(len);
+        joined[0] = '\0';
+        for (k = i; k <= j; k++)
+        {
+            if (k != i) { strcat(joined, " "); }
+            strcat(joined, cl->args[k]);
+            free(cl->args[k]);
+        }
+        cl->args[i] = joined;
+
+        // move the following args up
+        memmove(cl->args + i + 1, cl->args + j + 1, (cl->num_args - j) * sizeof(char*));
+        cl->num_args -= j - i;
+    }
+
+    return 0;
+}
+
+/* replace the word after each "<<", "<<-" and "<<<" from arg "from" on
+ * with the text that is fed to the command, and the operator with "<<";
+ * here-document bodies are taken in order from the lines in *rest
+ * pre-condition:   args have been parsed
+ * post-condition:  returned 1 if an operator has no word after it */
+int _parse_heredocs(struct CL * cl, int from, char ** rest)
+{
+    // declarations
+    char * delim;
+    char * body;
+    int quoted;
+    int strip;
+    int i;
+
+    for (i = from; i < cl->num_args; i++)
+    {
+        strip = (strcmp(cl->args[i], "<<-") == 0);
+        if (strcmp(cl->args[i], "<<") != 0 && !strip
+            && strcmp(cl->args[i], "<<<") != 0) { continue; }
+
+        if (i == cl->num_args - 1)
+        {
+            fprintf(stderr, "smallsh: syntax error near \"%s\"\n", cl->args[i]);
+            fflush(stderr);
+            return 1;
+        }
+
+        // here-string, the word is a line of input
+        if (strcmp(cl->args[i], "<<<") == 0)
+        {
+            body = malloc(strlen(cl->args[i+1]) + 2);
+            sprintf(body, "%s\n", cl->args[i+1]);
+        }
+        // here-document, the lines up to the delimiter
+        else
+        {
+            delim = _heredoc_delim(cl->args[i+1], &quoted);
+            if (_heredoc_body(rest, delim, strip, &body) != 0)
+            {
+                fprintf(stderr, "smallsh: here-document delimited by end of input (wanted \"%s\")\n", delim);
+                fflush(stderr);
+            }
+            free(delim);
+
+            // an unquoted delimiter expands $$ in the body
+            if (!quoted)
+            {
+                delim = body;
+                body = _expand_pid(delim);
+                free(delim);
+            }
+        }
+
+        free(cl->args[i+1]);
+        cl->args[i+1] = body;
+        if (strcmp(cl->args[i], "<<") != 0)
+        {
+            free(cl->args[i]);
+            cl->args[i] = strdup("<<");
+        }
+        i++;
+    }
+
+    return 0;
+}
+
+/* delimiter of a here-document with its quotes removed
+ * post-condition:  returned malloc'd delimiter, *quoted set if it had any */
+char * _heredoc_delim(char * word, int * quoted)
+{
+    char * delim = malloc(strlen(word) + 1);
+    int j = 0;
+
+    *quoted = 0;
+    for (; *word != '\0'; word++)
+    {
+        if (*word == '\'' || *word == '"') { *quoted = 1; }
+        else { delim[j++] = *word; }
+    }
+    delim[j] = '\0';
+
+    return delim;
+}
+
+/* take the lines of a here-document body from *rest, up to the line that
+ * is just delim (leading tabs are dropped first if strip), moving *rest
+ * past them; the body is not kept if body is NULL
+ * post-condition:  returned 1 if the input ended before delim */
+int _heredoc_body(char ** rest, char * delim, int strip, char ** body)
+{
+    // declarations
+    char * line = *rest;
+    char * end;
+    int found = 0;
+    int len = 0;
+    int n;
+
+    if (body != NULL)
+    {
+        *body = malloc((line != NULL ? strlen(line) : 0) + 2);
+        (*body)[0] = '\0';
+    }
+
+    while (line != NULL)
+    {
+        // next line
+        end = strchr(line, '\n');
+        n = (end != NULL) ? end - line : (int) strlen(line);
+        if (strip) { while (n > 0 && *line == '\t') { line++; n--; } }
+
+        // delimiter ends the body
+        if (n == (int) strlen(delim) && strncmp(line, delim, n) == 0)
+        {
+            found = 1;
+            line = (end != NULL) ? end + 1 : NULL;
+            break;
+        }
+
+        // or the line is part of it
+        if (body != NULL)
+        {
+            memcpy(*body + len, line, n);
+            len += n;
+            (*body)[len++] = '\n';
+            (*body)[len] = '\0';
+        }
+        line = (end != NULL) ? end + 1 : NULL;
+    }
+
+    *rest = line;
+    return !found;
+}
+
+/* copy of s with every "$$" replaced by the pid of the shell
+ * post-condition:  returned malloc'd string */
+char * _expand_pid(char * s)
+{
+    // declarations
+    char pid_buff[32];
+    char * out;
+    char * at;
+    int count = 0;
+    int len;
+
+    sprintf(pid_buff, "%d", getpid());
+    for (at = s; (at = strstr(at, "$$")) != NULL; at += 2) { count++; }
+
+    out = malloc(strlen(s) + count * strlen(pid_buff) + 1);
+    for (len = 0; *s != '\0'; )
+    {
+        if (s[0] == '$' && s[1] == '$')
+        {
+            len += sprintf(out + len, "%s", pid_buff);
+            s += 2;
+        }
+        else { out[len++] = *s++; }
+    }
+    out[len] = '\0';
+
+    return out;
+}
+
+/* number of here-documents and compound commands ("if", loops, "case"
+ * and "{") in input still waiting for their end, so a front end knows to
+ * read more lines before running it */
+int pending_CL(struct CL * cl, char * input)
+{
+    // declarations
+    char * copy;
+    char * spaced = NULL;
+    char * rest;
+    char * line;
+    char * word;
+    char * save;
+    char * prev;
+    char * delim;
+    char * c;
+    int pending = 0;
+    int open = 0;
+    int parens = 0;
+    int quoted;
+    int strip;
+
+    (void) cl;
+    copy = strdup(input);
+    for (rest = copy; rest != NULL; )
+    {
+        // next line (comments have no words)
+        line = rest;
+        rest = strchr(line, '\n');
+        if (rest != NULL) { *rest++ = '\0'; }
+        if (line[0] == '#') { continue; }
+
+        prev = NULL;
+        free(spaced);
+        spaced = _split_ops(line, strlen(line));
+        for (word = strtok_r(spaced, " \t", &save); word != NULL;
+             word = strtok_r(NULL, " \t", &save))
+        {
+            // words of "$(( ))" and "(( ))" are arithmetic ("<<" is a shift)
+            if (parens > 0 || strstr(word, "$((") != NULL
+                || (strncmp(word, "((", 2) == 0 && (prev == NULL || _cmd_start(prev))))
+            {
+                for (c = word; *c != '\0'; c++) { parens += (*c == '(') - (*c == ')'); }
+                prev = word;
+                continue;
+            }
+
+            // braces anywhere, reserved words at the start of a command
+            if      (strcmp(word, "{") == 0) { open++; }
+            else if (strcmp(word, "}") == 0) { open--; }
+            else if (prev == NULL || _cmd_start(prev))
+            {
+                if (strcmp(word, "if") == 0 || strcmp(word, "while") == 0 || strcmp(word, "until") == 0
+                    || strcmp(word, "for") == 0 || strcmp(word, "case") == 0) { open++; }
+                else if (strcmp(word, "fi") == 0 || strcmp(word, "done") == 0
+                         || strcmp(word, "esac") == 0) { open--; }
+            }
+            prev = word;
+
+            // here-document bodies are the lines after this one
+            strip = (strcmp(word, "<<-") == 0);
+            if (strcmp(word, "<<") != 0 && !strip) { continue; }
+            if ((word = strtok_r(NULL, " \t", &save)) == NULL) { break; }
+            prev = word;
+
+            delim = _heredoc_delim(word, &quoted);
+            pending += _heredoc_body(&rest, delim, strip, NULL);
+            free(delim);
+        }
+    }
+
+    free(spaced);
+    free(copy);
+    return pending + ((open > 0) ? open : 0);
+}
+
+/* double the size of the args array */
+int _grow_args(struct CL * cl)
+{
+    cl->args_size *= 2;
+    cl->args = realloc(cl->args, cl->args_size * sizeof(char*));
+    return 0;
+}
+
+/* executes the command contained within the CL struct
+ * pre-condition:   cl has been setup */
+int _execute_CL(struct CL * cl)
+{
+    // declarations
+    int in_stream = STDIN_FILENO;
+    int out_stream = STDOUT_FILENO;
+    int saved_in;
+    int saved_out;
+    int in_redir = 0;
+    int out_redir = 0;
+    int background = 0;
+    int special_count = 0;
+    int fanout_wait = 0;
+    int result = 0;
+    int i = 0;
+    int j = 0;
+
+    // if command was empty
+    if (cl->args[0] == NULL || strcmp(cl->args[0], "\n") == 0) { return 0; }
+
+    // a startup file that only defines things can be snapshotted
+    if (cl->rc_pure && !_rc_pure_cmd(cl)) { cl->rc_pure = 0; }
+
+    // if exit (save the time of parsing)
+    if (strcmp(cl->args[0], "exit") == 0) { return -1; }
+
+    // "timeout DURATION cmd ..." runs cmd with a deadline of its own
+    if (strcmp(cl->args[0], "timeout") == 0 && cl->num_args > 2)
+    {
+        if ((cl->next_timeout_ms = _parse_duration(cl->args[1])) == -1)
+        {
+            fprintf(stderr, "smallsh: timeout: %s: invalid duration\n", cl->args[1]);
+            fflush(stderr);
+            cl->fg_ran = 1;
+            cl->fg_status = 1;
+            cl->fg_exited = 1;
+            cl->fg_signaled = 0;
+            cl->fg_timed_out = 0;
+            return 0;
+        }
+
+        // view the rest as the command
+        cl->args += 2;
+        cl->num_args -= 2;
+        result = _execute_CL(cl);
+        cl->args -= 2;
+        cl->num_args += 2;
+        cl->next_timeout_ms = -1;
+
+        return result;
+    }
+
+    // "at TIME cmd ..." and "every INTERVAL cmd ..." keep the command's
+    // redirections and "&" for when it runs
+    if (strcmp(cl->args[0], "at") == 0 || strcmp(cl->args[0], "every") == 0)
+    {
+        return _sched_cmd(cl, cl->num_args, cl->args);
+    }
+
+    // process substitutions, their pipe ends are kept open for the command
+    int * sub_fds = malloc(cl->num_args * sizeof(int));
+    int num_subs = _start_procsubs(cl, sub_fds);
+    if (num_subs == -1)
+    {
+        free(sub_fds);
+        cl->fg_ran = 1;
+        cl->fg_status = 1;
+        cl->fg_exited = 1;
+        cl->fg_signaled = 0;
+        cl->fg_timed_out = 0;
+        return 0;
+    }
+
+    // check for special args
+    if (_process_special_args(cl, &special_count,
+                        &in_stream, &out_stream,
+                        &in_redir, &out_redir, &background) != 0)
+    {
+        for (j = 0; j < num_subs; j++) { close(sub_fds[j]); }
+        free(sub_fds);
+
+        /* redirection error */
+        if (!background)
+        {
+            // foreground, set status
+            cl->fg_ran = 1;
+            cl->fg_status = 1;
+            cl->fg_exited = 1;
+            cl->fg_signaled = 0;
+            cl->fg_timed_out = 0;
+        }
+        
+        return 0;
+    }
+
+    // don't pass special arguments in
+    char * tmp = cl->args[cl->num_args - special_count];
+    cl->args[cl->num_args - special_count] = NULL;
+        
+    // functions are found first, and need no PATH lookup
+    struct FUNC * func = NULL;
+    builtin_fn builtin = NULL;
+    if (cl->args[0] != NULL) { func = _hash_get(&cl->funcs, cl->args[0]); }
+    if (cl->args[0] != NULL && func == NULL)
+    {
+        builtin = _find_builtin(cl->num_args - special_count, cl->args);
+    }
+
+    // only redirections, the files are opened (and created) but nothing runs
+    if (cl->args[0] == NULL)
+    {
+        if (out_redir) { close(out_stream); }
+        if (in_redir)  { close(in_stream); }
+        _fanout_wait(cl);
+    }
+
+    // functions only run in the shell
+    else if (func != NULL && background)
+    {
+        fprintf(stderr, "smallsh: %s: functions can't run in the background\n", cl->args[0]);
+        fflush(stderr);
+        if (out_redir) { close(out_stream); }
+        if (in_redir)  { close(in_stream); }
+    }
+
+    // execute built-in commands and functions (in the shell, with its
+    // input and output redirected)
+    else if (func != NULL || builtin != NULL)
+    {
+        if (out_redir) { fflush(stdout);
+                         saved_out = dup(STDOUT_FILENO);
+                         dup2(out_stream, STDOUT_FILENO); }
+        if (in_redir && func != NULL) { saved_in = dup(STDIN_FILENO);
+                                        dup2(in_stream, STDIN_FILENO); }
+
+        if (func != NULL)
+        {
+            result = _call_func(cl, func, cl->num_args - special_count, cl->args);
+        }
+        else
+        {
+            cl->stats.builtins++;
+            builtin(cl->num_args - special_count, cl->args, cl);
+        }
+
+        if (out_redir) { fflush(stdout);
+                         dup2(saved_out, STDOUT_FILENO);
+                         close(saved_out);
+                         close(out_stream); }
+        if (in_redir && func != NULL) { dup2(saved_in, STDIN_FILENO);
+                                        close(saved_in); }
+        if (in_redir)  { close(in_stream); }
+        _fanout_wait(cl);
+    }
+
+    // execute non built-ins
+    else {
+        // deadline of the command (0 for none)
+        long timeout_ms = (cl->next_timeout_ms != -1) ? cl->next_timeout_ms
+                                                      : cl->timeout_ms;
+        struct DEADLINE * deadline = NULL;
+
+        // capture output of background job, or throw it away
+        int cap_fd = -1;
+        int fds[2];
+        if (background && !out_redir && !cl->bg_quiet)
+        {
+            if (cl->capture && pipe2(fds, O_CLOEXEC) == 0)
+            {
+                cap_fd = fds[0];
+                out_stream = fds[1];
+            }
+            else
+            {
+                out_stream = open("/dev/null", O_WRONLY);
+            }
+            out_redir = 1;
+        }
+
+        // where the command is, so the child doesn't search the path
+        char * file = _find_cmd(cl, cl->args[0]);
+
+        // not found, the child that reports it suggests a close name
+        if (file == NULL && strchr(cl->args[0], '/') == NULL)
+        {
+            cl->suggest = _suggest(cl, cl->args[0]);
+        }
+
+        // launch through the zygote, fork if there is none, the
+        // command needs the pipes of process substitutions or there is
+        // a suggestion for the child (with nothing buffered for the
+        // child to repeat)
+        result = 0; 
+        fflush(stdout);
+        long launch_us = _now_us();
+        i = -1;
+        if (num_subs == 0 && cl->suggest == NULL)
+        {
+            i = _zygote_spawn(cl, file, cl->args,
+                              in_redir ? in_stream : STDIN_FILENO,
+                              out_redir ? out_stream : STDOUT_FILENO,
+                              cap_fd != -1 ? out_stream : STDERR_FILENO,
+                              background);
+        }
+        if (i != -1) { cl->stats.zygote_launches++; }
+        else
+        {
+            i = fork();
+            if (i > 0) { cl->stats.fork_launches++; }
+        }
+        if (i > 0)
+        {
+            _hist_add(&cl->stats.launch, _now_us() - launch_us);
+            cl->stats.externals++;
+        }
+
+        // if parent process
+        if (i > 0)
+        {
+            // is parent
+            cl->is_child = 0;
+
+            // own process group (set here too, so it exists before any
+            // use of it whichever process runs first)
+            if (cl->flags & CL_JOBCTL) { setpgid(i, i); }
+
+            // fd to wait and signal through (-1 on kernels without pidfds)
+            int pidfd = syscall(SYS_pidfd_open, i, 0);
+
+            // background process
+            if (background)
+            {
+                if (!cl->bg_quiet)
+                {
+                    fflush(stdout);
+                    printf("background pid is %d\n", i);
+                    fflush(stdout);
+                }
+
+                struct JOB * job = _push_job(cl, i, cap_fd, pidfd);
+                cl->stats.jobs_started++;
+                if (timeout_ms > 0) { job->deadline = _wheel_add(cl, i, pidfd, timeout_ms); }
+            }
+            // foreground process
+            else
+            {
+                fflush(stdout);
+
+                cl->fg_ran = 1;
+                if (timeout_ms > 0) { deadline = _wheel_add(cl, i, pidfd, timeout_ms); }
+
+                // stopped, it becomes a job (keeping its deadline and pidfd)
+                if (_foreground(cl, i, pidfd, &deadline) == 1)
+                {
+                    struct JOB * job = _push_job(cl, i, -1, pidfd);
+                    job->stopped = 1;
+                    job->deadline = deadline;
+                    printf("[%d] stopped  %s\n", job->id, job->cmd);
+                    fflush(stdout);
+                }
+                else
+                {
+                    if (pidfd != -1) { close(pidfd); }
+                    fanout_wait = 1;
+                }
+            }
+
+            // child has its own copies of the redirected streams
+            if (in_redir)  { close(in_stream); }
+            if (out_redir) { close(out_stream); }
+
+            // targets of a finished command are complete before going on
+            if (fanout_wait) { _fanout_wait(cl); }
+        }
+        // if forked child process
+        else if (i == 0)
+        {
+            // is child
+            cl->is_child = 1;
+
+            // process group and signals
+            _child_setup(cl->flags & CL_JOBCTL, background,
+                         cl->term_fg && !background);
+
+            // redirect input and output
+            if (in_redir)  { saved_in = dup(STDIN_FILENO); 
+                             dup2(in_stream, STDIN_FILENO); }
+            if (out_redir) { fflush(stdout);
+                             saved_out = dup(STDOUT_FILENO);
+                             dup2(out_stream, STDOUT_FILENO); }
+            if (cap_fd != -1) { dup2(out_stream, STDERR_FILENO); }
+
+            // pipes of process substitutions stay open across exec
+            for (j = 0; j < num_subs; j++) { fcntl(sub_fds[j], F_SETFD, 0); }
+
+            // shell's blocked signals are delivered normally again
+            sigprocmask(SIG_SETMASK, &cl->old_mask, NULL);
+
+            // not a built-in command
+            _exec_args(cl, file, cl->args, environ);
+
+        } // child thing
+
+        free(cl->suggest);
+        cl->suggest = NULL;
+    }
+
+    // put old special arguments back
+    cl->args[cl->num_args - special_count] = tmp;
+
+    // the command has its own copies of the substituted pipes
+    for (j = 0; j < num_subs; j++) { close(sub_fds[j]); }
+    free(sub_fds);
+
+    // return
+    return result;
+}
+
+/* set up the process group and signals of a child before it execs
+ * (runs in the child, used by forked and zygote children) */
+void _child_setup(int jobctl, int background, int term_fg)
+{
+    if (jobctl)
+    {
+        // own process group, and the terminal if in the foreground
+        // (taking it from the background would stop us with SIGTTOU)
+        setpgid(0, 0);
+        signal(SIGTTOU, SIG_IGN);
+        if (term_fg) { tcsetpgrp(STDIN_FILENO, getpid()); }
+
+        // stopping and interrupting are up to the terminal now
+        signal(SIGTSTP, SIG_DFL);
+        signal(SIGTTIN, SIG_DFL);
+        signal(SIGTTOU, SIG_DFL);
+        signal(SIGINT, SIG_DFL);
+        return;
+    }
+
+    // always ignore sigtstp
+    signal(SIGTSTP, SIG_IGN);
+
+    // ignore sigint if in background
+    if (background) { signal(SIGINT, SIG_IGN); }
+}
+
+/* exec argv, from file if it was found already, otherwise by searching
+ * the path, used by forked and zygote children
+ * post-condition:  never returns, exits with 1 if nothing could be run */
+void _exec_args(struct CL * cl, char * file, char ** argv, char ** envp)
+{
+    int j;
+
+    if (file != NULL) { execve(file, argv, envp); }
+
+    _need_path(cl);
+    for (j = 0; j < cl->path_len; j++)
+    {
+        char * path_tmp = malloc((strlen(argv[0]) + strlen(cl->path[j]) + 2) * sizeof(char));
+        sprintf(path_tmp, "%s/%s", cl->path[j], argv[0]);
+        execve(path_tmp, argv, envp);
+        //execvp(argv[0], argv);
+        free(path_tmp);
+    }
+
+    // following is only reached if execvp failed
+
+    // print system error
+    char perr[CL_BUFF_SIZE] = "smallsh: ";
+    sprintf(perr, "%s%s", perr, argv[0]);
+    perror(perr);
+    if (cl->suggest != NULL) { fprintf(stderr, "smallsh: did you mean '%s'?\n", cl->suggest); }
+
+    // never return into the caller's code from the child
+    _exit(1);
+}
+
+/* find the full path of a command, from the cache or by searching the
+ * path (names with a "/" are used as they are)
+ * post-condition:  returned NULL if the command wasn't found */
+char * _find_cmd(struct CL * cl, char * name)
+{
+    char * file;
+    int i;
+
+    if (strchr(name, '/') != NULL) { return name; }
+
+    if ((file = _hash_get(&cl->cmd_cache, name)) != NULL)
+    {
+        // gone since it was cached
+        if (access(file, X_OK) == 0) { cl->stats.cache_hits++; return file; }
+        free(_hash_del(&cl->cmd_cache, name));
+    }
+    cl->stats.cache_misses++;
+    _need_path(cl);
+
+    // the startup snapshot's index knows the directory (or that there is
+    // none) while PATH is as it was
+    if ((i = _rc_cmd(cl, name)) == -1) { return NULL; }
+    for (i = (i == -2) ? 0 : i; i < cl->path_len; i++)
+    {
+        file = malloc(strlen(cl->path[i]) + strlen(name) + 2);
+        sprintf(file, "%s/%s", cl->path[i], name);
+        if (access(file, X_OK) == 0)
+        {
+            _hash_put(&cl->cmd_cache, name, file);
+            return file;
+        }
+        free(file);
+    }
+
+    return NULL;
+}
+
+/* check the argument list for special arguments (redirection / bg)
+ * pre-condition:   cl setup and parsed
+ * post-condition:  flags and streams passed are updated */
+int _process_special_args(struct CL * cl, int * special_count,
+                      int * in_stream, int * out_stream,
+                      int * in_redir, int * out_redir,
+                      int * background)
+{
+    // declarations
+    int outs[FANOUT_MAX + 1];
+    int num_outs = 0;
+    int i, j;
+
+    // initial values
+    *in_stream = STDIN_FILENO;
+    *out_stream = STDOUT_FILENO;
+    *special_count = 0;
+    *background = 0;
+    *out_redir = 0;
+    *in_redir = 0;
+    cl->fanout_pid = 0;
+
+    // redirections can be anywhere, the words cut off below are theirs
+    _move_redirs(cl);
+
+    // check for background first
+    if (strcmp(cl->args[cl->num_args - 1], "&") == 0)
+    {
+        // open in background
+        *special_count += 1;
+
+        // background ( redir can be overwritten )
+        if (cl->bg_block_mode == 0)
+        {
+            *in_stream = open("/dev/null", O_RDONLY);
+            *in_redir = 1;
+            *background = 1;
+
+            // output not redirected here goes to /dev/null or a capture
+            // buffer (see _execute_CL)
+        }
+    }
+
+    // check for redirection special args
+    for (i = 0; i < cl->num_args; i++)
+    {
+        if (strcmp(cl->args[i], "<") == 0)
+        {
+            // new input file
+            *special_count += 2;
+
+            // if already redir'd, close the old one
+            if (*in_redir) { close(*in_stream); }
+
+            // "<" is not last arg
+            *in_stream = open(cl->args[i+1], O_RDONLY);
+            *in_redir = 1;
+
+            // check for open failure
+            if (*in_stream == -1)
+            {
+                char perr[CL_BUFF_SIZE] = "smallsh: ";
+                sprintf(perr, "%s%s", perr, cl->args[i+1]);
+                perror(perr);
+                return 1;
+            }
+        }
+        else if (strcmp(cl->args[i], ">") == 0)
+        {
+            // new output file (another target if already redir'd)
+            *special_count += 2;
+
+            // ">" is not last arg
+            *out_stream = open(cl->args[i+1], O_WRONLY | O_TRUNC | O_CREAT, 0600);
+            *out_redir = 1;
+            
+            // check for open failure
+            if (*out_stream == -1)
+            {
+                char perr[CL_BUFF_SIZE] = "smallsh: ";
+                sprintf(perr, "%s%s", perr, cl->args[i+1]);
+                perror(perr);
+                for (j = 0; j < num_outs; j++) { close(outs[j]); }
+                return 1;
+            }
+        }
+        else if (strcmp(cl->args[i], ">>") == 0)
+        {
+            // new output file (append)
+            *special_count += 2;
+            
+            // ">>" is not last arg
+            *out_stream = open(cl->args[i+1], O_WRONLY | O_APPEND | O_CREAT, 0600);
+            *out_redir = 1;
+            
+            // check for open failure
+            if (*out_stream == -1)
+            {
+                char perr[CL_BUFF_SIZE] = "smallsh: ";
+                sprintf(perr, "%s%s", perr, cl->args[i+1]);
+                perror(perr);
+                for (j = 0; j < num_outs; j++) { close(outs[j]); }
+                return 1;
+            }
+        }
+        else if (strcmp(cl->args[i], "<<") == 0)
+        {
+            // here-document (its text was put in the next arg by parsing)
+            *special_count += 2;
+
+            // if already redir'd, close the old one
+            if (*in_redir) { close(*in_stream); }
+
+            *in_stream = _heredoc_fd(cl->args[i+1]);
+            *in_redir = 1;
+
+            // check for failure
+            if (*in_stream == -1)
+            {
+                perror("smallsh: here-document");
+                for (j = 0; j < num_outs; j++) { close(outs[j]); }
+                return 1;
+            }
+        }
+
+        // every output file is a target
+        if (strcmp(cl->args[i], ">") == 0 || strcmp(cl->args[i], ">>") == 0)
+        {
+            if (num_outs == FANOUT_MAX)
+            {
+                fprintf(stderr, "smallsh: more than %d output redirections\n", FANOUT_MAX);
+                fflush(stderr);
+                for (j = 0; j < num_outs; j++) { close(outs[j]); }
+                close(*out_stream);
+                return 1;
+            }
+            outs[num_outs++] = *out_stream;
+        }
+    }
+
+    // several targets, the command writes to a helper copying to them all
+    if (num_outs > 1 && (*out_stream = _fanout_start(cl, outs, num_outs)) == -1)
+    {
+        return 1;
+    }
+
+    return 0;
+}
+
+/* move each redirection ("<", ">", ">>" or "<<" and the word after it)
+ * after the other args (before a last "&"), keeping their order, so the
+ * command's words come first (moving them again changes nothing, a loop
+ * body's args are moved each time it runs) */
+void _move_redirs(struct CL * cl)
+{
+    // declarations
+    char ** moved = malloc(cl->num_args * sizeof(char*));
+    int end = cl->num_args;
+    int num = 0;
+    int kept = 0;
+    int i;
+
+    if (end > 0 && strcmp(cl->args[end - 1], "&") == 0) { end--; }
+    for (i = 0; i < end; i++)
+    {
+        if (i + 1 < end && (strcmp(cl->args[i], "<") == 0 || strcmp(cl->args[i], ">") == 0
+                            || strcmp(cl->args[i], ">>") == 0 || strcmp(cl->args[i], "<<") == 0))
+        {
+            moved[num++] = cl->args[i++];
+            moved[num++] = cl->args[i];
+        }
+        else { cl->args[kept++] = cl->args[i]; }
+    }
+    memcpy(cl->args + kept, moved, num * sizeof(char*));
+    free(moved);
+}
+
+/* start a helper job for each "<(cmd)" and ">(cmd)" arg, connected to
+ * the command by a pipe, and replace the arg with the /dev/fd path of the
+ * command's end (the helpers are simple commands, split at spaces, with
+ * "<", ">" and ">>" redirections)
+ * pre-condition:   fds has room for num_args fds
+ * post-condition:  returned number of command's pipe ends put in fds,
+ *                  returned -1 on error (any put in fds are closed) */
+int _start_procsubs(struct CL * cl, int * fds)
+{
+    // declarations
+    char ** argv;
+    char * inner;
+    char * word;
+    char * save;
+    char path[32];
+    struct JOB * job;
+    int num = 0;
+    int output;
+    int ends[2];
+    int pid;
+    int i, j;
+
+    for (i = 0; i < cl->num_args; i++)
+    {
+        output = (strncmp(cl->args[i], ">(", 2) == 0);
+        if (!output && strncmp(cl->args[i], "<(", 2) != 0) { continue; }
+        if (cl->args[i][strlen(cl->args[i]) - 1] != ')') { continue; }
+
+        // words of the helper's command, between the parentheses
+        inner = strdup(cl->args[i] + 2);
+        inner[strlen(inner) - 1] = '\0';
+        argv = malloc((strlen(inner) / 2 + 2) * sizeof(char*));
+        j = 0;
+        for (word = strtok_r(inner, " ", &save); word != NULL; word = strtok_r(NULL, " ", &save))
+        {
+            argv[j++] = word;
+        }
+        argv[j] = NULL;
+
+        if (j == 0 || pipe2(ends, O_CLOEXEC) == -1)
+        {
+            if (j == 0) { fputs("smallsh: empty process substitution\n", stderr); }
+            else        { perror("smallsh: pipe"); }
+            fflush(stderr);
+            free(argv);
+            free(inner);
+            for (j = 0; j < num; j++) { close(fds[j]); }
+            return -1;
+        }
+
+        // helper writes to the command's input, or reads its output
+        fflush(stdout);
+        pid = fork();
+        if (pid == 0)
+        {
+            cl->is_child = 1;
+            _child_setup(cl->flags & CL_JOBCTL, 1, 0);
+            dup2(ends[output ? 0 : 1], output ? STDIN_FILENO : STDOUT_FILENO);
+            sigprocmask(SIG_SETMASK, &cl->old_mask, NULL);
+            if (_procsub_redirs(argv) == -1) { _exit(1); }
+            _exec_args(cl, _find_cmd(cl, argv[0]), argv, environ);
+        }
+        close(ends[output ? 0 : 1]);
+        fds[num++] = ends[output ? 1 : 0];
+
+        // helper is a job, reaped quietly once it is done
+        if (pid > 0)
+        {
+            if (cl->flags & CL_JOBCTL) { setpgid(pid, pid); }
+            job = _push_job(cl, pid, -1, syscall(SYS_pidfd_open, pid, 0));
+            job->helper = 1;
+            free(job->cmd);
+            job->cmd = strdup(cl->args[i]);
+            cl->stats.jobs_started++;
+        }
+        else { perror("smallsh: fork"); }
+
+        // the command is given the path of its end
+        sprintf(path, "/dev/fd/%d", ends[output ? 1 : 0]);
+        free(cl->args[i]);
+        cl->args[i] = strdup(path);
+
+        free(argv);
+        free(inner);
+    }
+
+    return num;
+}
+
+/* open the redirections of a helper's words (in the helper), taking them
+ * out of argv
+ * post-condition:  returned -1 (and printed error) if a file didn't open */
+int _procsub_redirs(char ** argv)
+{
+    int flags;
+    int fd;
+    int i, j;
+
+    for (i = 0, j = 0; argv[i] != NULL; i++)
+    {
+        if      (strcmp(argv[i], "<") == 0)  { flags = O_RDONLY; }
+        else if (strcmp(argv[i], ">") == 0)  { flags = O_WRONLY | O_CREAT | O_TRUNC; }
+        else if (strcmp(argv[i], ">>") == 0) { flags = O_WRONLY | O_CREAT | O_APPEND; }
+        else { argv[j++] = argv[i]; continue; }
+
+        if (argv[i + 1] == NULL)
+        {
+            fprintf(stderr, "smallsh: %s: file expected\n", argv[i]);
+            return -1;
+        }
+        if ((fd = open(argv[i + 1], flags, 0600)) == -1)
+        {
+            char perr[CL_BUFF_SIZE];
+            snprintf(perr, sizeof(perr), "smallsh: %s", argv[i + 1]);
+            perror(perr);
+            return -1;
+        }
+        dup2(fd, (flags == O_RDONLY) ? STDIN_FILENO : STDOUT_FILENO);
+        close(fd);
+        i++;
+    }
+    argv[j] = NULL;
+
+    if (j == 0) { fputs("smallsh: empty process substitution\n", stderr); return -1; }
+    return 0;
+}
+
+/* put the text of a here-document in a sealed memfd, so no file is
+ * written and a command can read a body of any size at its own pace
+ * post-condition:  returned fd to read the text from, -1 on error */
+int _heredoc_fd(char * text)
+{
+    // declarations
+    size_t len = strlen(text);
+    size_t done = 0;
+    ssize_t n;
+    int fd;
+
+    if ((fd = memfd_create("smallsh-heredoc", MFD_CLOEXEC | MFD_ALLOW_SEALING)) == -1) { return -1; }
+
+    while (done < len)
+    {
+        if ((n = write(fd, text + done, len - done)) == -1)
+        {
+            if (errno == EINTR) { continue; }
+            close(fd);
+            return -1;
+        }
+        done += n;
+    }
+
+    // read-only from here on, then read from the start
+    fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL);
+    lseek(fd, 0, SEEK_SET);
+
+    return fd;
+}
+
+/* grow the size of the pwd buffer */
+int _grow_CL_pwd_buff(struct CL * cl)
+{
+    // declarations
+    char * tmp;
+
+    // allocate temporary array
+    tmp = malloc(cl->pwd_size * sizeof(char));
+
+    // fill temporary array
+    strcpy(tmp, cl->pwd);
+
+    // free old array
+    free(cl->pwd);
+
+    // double size
+    cl->pwd_size *= 2;
+
+    // allocate new pwd buffer
+    cl->pwd = malloc(cl->pwd_size * sizeof(char));
+
+    // copy tmp into new buffer
+    strcpy(cl->pwd, tmp);
+
+    // free tmp buffer
+    free(tmp);
+}
+
+/* change pwd to the passed string
+ * pre-condition:   new_dir is null-terminated */
+int _change_CL_pwd(struct CL * cl, char * new_dir)
+{
+    // grow as needed
+    while (strlen(new_dir) >= cl->pwd_size) { _grow_CL_pwd_buff(cl); }
+
+    // set new length
+    cl->pwd_len = strlen(new_dir);
+
+    // copy new_dir into pwd
+    strcpy(cl->pwd, new_dir);
+}
+
+/* change the pwd string in cl to the cwd */
+int _set_curr_pwd(struct CL * cl)
+{
+    // declarations
+    char tmp[PATH_MAX];
+
+    // the kernel's path, links resolved
+    if (getcwd(tmp, sizeof(tmp)) == NULL) { return -1; }
+    _change_CL_pwd(cl, tmp);
+
+    return 0;
+}
+
+/* parse current PATH var into cl members */
+int _get_path(struct CL * cl)
+{
+    // declarations
+    const char * c_tmp;
+    int tmp_size = 10;
+    int tmp_len = 0;
+    char * tmp;
+    char * tmp2;
+    char * tmp_free;
+    int count = 0;
+    int i;
+
+    // if path has been alloc'd
+    if (cl->path_len != 0)
+    {
+        for (i = 0; i < cl->path_len; i++) { free(cl->path[i]); }
+        free(cl->path);
+        cl->path_len = 0;
+    }
+
+    // get path var
+    if ((c_tmp = getenv("PATH")) == NULL) { c_tmp = ""; }
+    tmp = malloc((strlen(c_tmp) + 1) * sizeof(char));
+    tmp_free = tmp;
+    strcpy(tmp, c_tmp);
+
+    // get count of ":"
+    tmp2 = tmp;
+    while((tmp2 = strstr(tmp2, ":")) != NULL)
+    {
+       count++;
+       tmp2++;
+    }
+
+    // allocate path arr
+    cl->path_len = count + 1;
+    cl->path = malloc(cl->path_len * sizeof(char *));
+
+    // if path is empty
+    if (strlen(c_tmp) == 0)
+    {
+        free(tmp_free);
+        cl->path[0] = strdup(".");
+        return 1;
+    }
+
+    // for each ":" between paths (tmp is at beginning)
+    count = 0;
+    for (i = 0; i < cl->path_len && tmp != NULL; i++)
+    {
+        // ensure char after curr path is '\0'
+        if ((tmp2 = strstr(tmp, ":")) != NULL)
+        {
+            // set the following ":" to "\0"
+            tmp2[0] = '\0';
+        }
+
+        // allocate current path string
+        cl->path[i] = malloc((strlen(tmp) + 1) * sizeof(char));
+    
+        // copy path into arr
+        strcpy(cl->path[i], tmp);
+
+        // move forward
+        if (tmp2 != NULL) { tmp = tmp2 + 1; }
+        else              { tmp = NULL; }
+
+        //printf("~%d~%s\n", i, cl->path[i]);
+    }
+
+    // cleanup temp
+    free(tmp_free);
+}
+
+/* fill the path member of the CL on first use (after the startup file,
+ * which may set PATH) */
+void _need_path(struct CL * cl)
+{
+    if (cl->path == NULL) { _get_path(cl); }
+}
+
+/* PATH was assigned or unset: parse it again, and look for commands
+ * again rather than where the old PATH had them (the startup snapshot's
+ * index is for the PATH the shell started with) */
+void _path_changed(struct CL * cl)
+{
+    _get_path(cl);
+    _hash_free(&cl->cmd_cache, free);
+    _hash_init(&cl->cmd_cache, CMD_CACHE_SIZE);
+    cl->snap_cmds = 0;
+}
+
+/* add a job to the list of background processes
+ * pre-condition:   cl->args holds the command that started it
+ * post-condition:  output from out_fd (if not -1) is captured, the job
+ *                  owns pidfd (if not -1) and is reaped once it's readable */
+struct JOB * _push_job(struct CL * cl, int new_pid, int out_fd, int pidfd)
+{
+    // local
+    struct epoll_event ev = {0};
+    struct JOB * job;
+    int len = 0;
+    int id = 1;
+    int i;
+
+    // check if job list needs to grow
+    if (cl->job_len == cl->job_size)
+    {
+        cl->job_size *= 2;
+        cl->jobs = realloc(cl->jobs, cl->job_size * sizeof(struct JOB));
+    }
+
+    // lowest job number not in use
+    for (i = 0; i < cl->job_len; i++)
+    {
+        if (cl->jobs[i].id == id) { id++; i = -1; }
+    }
+
+    // add new job
+    job = &cl->jobs[cl->job_len];
+    job->id = id;
+    job->pid = new_pid;
+    job->done = 0;
+    job->stopped = 0;
+    job->out = NULL;
+    job->out_fd = out_fd;
+    job->deadline = NULL;
+    job->pidfd = pidfd;
+    job->ready = 0;
+    job->status = 0;
+    job->waited = 0;
+    job->helper = 0;
+    cl->job_len++;
+
+    // remember the command
+    for (i = 0; cl->args[i] != NULL; i++) { len += strlen(cl->args[i]) + 1; }
+    job->cmd = malloc((len + 1) * sizeof(char));
+    job->cmd[0] = '\0';
+    for (i = 0; cl->args[i] != NULL; i++)
+    {
+        if (i != 0) { strcat(job->cmd, " "); }
+        strcat(job->cmd, cl->args[i]);
+    }
+
+    // watch for the exit
+    if (pidfd != -1)
+    {
+        ev.events = EPOLLIN;
+        ev.data.u64 = EV_CHILD | ((uint64_t) pidfd << 32);
+        epoll_ctl(cl->ev_fd, EPOLL_CTL_ADD, pidfd, &ev);
+    }
+
+    // watch captured output
+    if (out_fd != -1)
+    {
+        job->out = _ring_new();
+        fcntl(out_fd, F_SETFL, fcntl(out_fd, F_GETFL) | O_NONBLOCK);
+        ev.events = EPOLLIN;
+        ev.data.u64 = EV_OUTPUT | ((uint64_t) out_fd << 32);
+        epoll_ctl(cl->ev_fd, EPOLL_CTL_ADD, out_fd, &ev);
+    }
+
+    // return
+    return job;
+}
+
+/* remove the job at idx from the list, freeing its output */
+int _remove_job(struct CL * cl, int idx)
+{
+    // local
+    struct JOB * job = &cl->jobs[idx];
+    int i;
+
+    // free job
+    if (job->out_fd != -1) { close(job->out_fd); }
+    if (job->out != NULL)  { _ring_free(job->out); }
+    _wheel_cancel(cl, job->deadline);
+    if (job->pidfd != -1) { close(job->pidfd); }
+    free(job->cmd);
+
+    // shift elements after idx up
+    for (i = idx; i < cl->job_len - 1; i++)
+    {
+        cl->jobs[i] = cl->jobs[i+1];
+    }
+    cl->job_len--;
+
+    // return
+    return 0;
+}
+
+/* find the job given by spec ("%n")
+ * post-condition:  returned NULL (and printed error) if there is none */
+struct JOB * _find_job(struct CL * cl, char * spec)
+{
+    int id;
+    int i;
+
+    if (spec != NULL && spec[0] == '%')
+    {
+        id = atoi(spec + 1);
+        for (i = 0; i < cl->job_len; i++)
+        {
+            if (cl->jobs[i].id == id) { return &cl->jobs[i]; }
+        }
+    }
+
+    fprintf(stderr, "smallsh: %s: no such job\n", spec ? spec : "");
+    fflush(stderr);
+    return NULL;
+}
+
+/* find the job to resume for fg and bg, given by spec ("%n") or the
+ * newest job still running if spec is NULL
+ * post-condition:  returned NULL (and printed error) if there is none */
+struct JOB * _resume_job(struct CL * cl, char * spec)
+{
+    struct JOB * job = NULL;
+    int i;
+
+    if (spec != NULL) { job = _find_job(cl, spec); }
+    else
+    {
+        for (i = cl->job_len - 1; i >= 0 && job == NULL; i--)
+        {
+            if (!cl->jobs[i].done) { job = &cl->jobs[i]; }
+        }
+        if (job == NULL) { fprintf(stderr, "smallsh: no current job\n"); }
+    }
+
+    if (job != NULL && job->done)
+    {
+        fprintf(stderr, "smallsh: %s: job has terminated\n", spec);
+        job = NULL;
+    }
+
+    fflush(stderr);
+    return job;
+}
+
+/* signal a job: its process group if it leads one (the group can't be
+ * reused while the leader is unreaped), else the process through its
+ * pidfd so a reused pid is never hit */
+int _job_kill(int pid, int pidfd, int sig)
+{
+    if (getpgid(pid) == pid) { return kill(-pid, sig); }
+    if (pidfd != -1) { return syscall(SYS_pidfd_send_signal, pidfd, sig, NULL, 0); }
+    return kill(pid, sig);
+}
+
+/* report jobs that stopped or continued since the last check, without
+ * reaping any child (pidfds take care of exits)
+ * post-condition:  returned number of messages printed */
+int _job_stops(struct CL * cl)
+{
+    siginfo_t info;
+    int printed = 0;
+    int i;
+
+    while (1)
+    {
+        info.si_pid = 0;
+        if (waitid(P_ALL, 0, &info, WSTOPPED | WCONTINUED | WNOHANG) == -1) { break; }
+        if (info.si_pid == 0) { break; }
+
+        for (i = 0; i < cl->job_len; i++)
+        {
+            struct JOB * job = &cl->jobs[i];
+            if (job->pid != info.si_pid || job->done) { continue; }
+
+            if (info.si_code == CLD_CONTINUED) { job->stopped = 0; }
+            else
+            {
+                _msg_begin(cl);
+                printf("[%d] stopped  %s\n", job->id, job->cmd);
+                job->stopped = 1;
+                printed++;
+            }
+        }
+    }
+
+    return printed;
+}
+
+/* read everything available on the job's capture pipe into its ring
+ * post-condition:  pipe is closed once the job (and its children) are
+ *                  done writing */
+int _job_drain(struct CL * cl, struct JOB * job)
+{
+    char buff[4096];
+    int n;
+
+    if (job->out_fd == -1) { return 0; }
+
+    while ((n = read(job->out_fd, buff, sizeof(buff))) > 0)
+    {
+        _ring_write(job->out, buff, n);
+    }
+
+    // end of output
+    if (n == 0 || (n == -1 && errno != EAGAIN && errno != EINTR))
+    {
+        epoll_ctl(cl->ev_fd, EPOLL_CTL_DEL, job->out_fd, NULL);
+        close(job->out_fd);
+        job->out_fd = -1;
+    }
+
+    return 0;
+}
+
+/* wait for the foreground child while the event loop keeps running,
+ * so captured output is drained and signals are picked up
+ * post-condition:  returned result of waitpid */
+int _wait_fg(struct CL * cl, int pid, int pidfd, int * status)
+{
+    struct epoll_event ev = {0};
+    int watched = 0;
+    int j;
+
+    // nothing to wake up on and no deadlines to run, just block
+    if (cl->sig_fd == -1 && pidfd == -1 && cl->wheel_len == 0)
+    {
+        return waitpid(pid, status, WUNTRACED);
+    }
+
+    // wake up when it exits (a job's pidfd is watched already)
+    if (pidfd != -1)
+    {
+        ev.events = EPOLLIN;
+        ev.data.u64 = EV_FG;
+        watched = (epoll_ctl(cl->ev_fd, EPOLL_CTL_ADD, pidfd, &ev) == 0);
+    }
+
+    // child owns stdin while it runs
+    _ev_input(cl, 0);
+
+    // (without signals or a pidfd, exits are only noticed every tick)
+    while ((j = waitpid(pid, status, WNOHANG | WUNTRACED)) == 0)
+    {
+        if (_ev_wait(cl, (cl->sig_fd == -1 && pidfd == -1) ? WHEEL_TICK_MS : -1) & EV_SIGNAL)
+        {
+            _ev_signals(cl);
+        }
+    }
+
+    _ev_input(cl, 1);
+    if (watched) { epoll_ctl(cl->ev_fd, EPOLL_CTL_DEL, pidfd, NULL); }
+
+    return j;
+}
+
+/* run pid (a new command, or a job being continued) in the foreground
+ * until it exits or stops, recording its status
+ * post-condition:  returned 1 if it stopped (deadline is left running),
+ *                  returned 0 if it is done (deadline is cancelled) */
+int _foreground(struct CL * cl, int pid, int pidfd, struct DEADLINE ** deadline)
+{
+    int status = 0;
+    int j;
+
+    // hand over the terminal while it runs
+    if (cl->term_fg) { tcsetpgrp(STDIN_FILENO, pid); }
+
+    j = _wait_fg(cl, pid, pidfd, &status);
+
+    // take it back, along with the shell's terminal modes
+    if (cl->term_fg)
+    {
+        tcsetpgrp(STDIN_FILENO, getpgrp());
+        tcsetattr(STDIN_FILENO, TCSADRAIN, &cl->tmodes);
+    }
+
+    // stopped (status as a shell reports it, 128 + signal)
+    if (j != -1 && WIFSTOPPED(status))
+    {
+        putchar('\n');
+        cl->fg_status = 128 + WSTOPSIG(status);
+        cl->fg_exited = 1;
+        cl->fg_signaled = 0;
+        cl->fg_timed_out = 0;
+        return 1;
+    }
+
+    // deadline went off if it got past its first stage
+    cl->fg_timed_out = (*deadline != NULL && (*deadline)->stage != 0);
+    _wheel_cancel(cl, *deadline);
+    *deadline = NULL;
+
+    // if no waitpid error occurred
+    if (j == -1) { return 0; }
+
+    if (WIFSIGNALED(status))
+    {
+        cl->fg_status = WTERMSIG(status);
+        cl->fg_exited = 0;
+        cl->fg_signaled = 1;
+
+        // report the signal right away
+        printf("%sterminated by signal %d\n",
+               cl->fg_timed_out ? "timed out, " : "", cl->fg_status);
+        fflush(stdout);
+    }
+    else if (WIFEXITED(status))
+    {
+        cl->fg_status = WEXITSTATUS(status);
+        cl->fg_exited = 1;
+        cl->fg_signaled = 0;
+    }
+
+    return 0;
+}
+
+/* allocate an empty ring buffer, it grows on the heap up to
+ * RING_HEAP_MAX and is then moved into a memfd of RING_MAX */
+struct RING * _ring_new()
+{
+    struct RING * ring = malloc(sizeof(struct RING));
+
+    ring->cap = RING_START;
+    ring->data = malloc(ring->cap);
+    ring->start = 0;
+    ring->len = 0;
+    ring->dropped = 0;
+    ring->memfd = -1;
+
+    return ring;
+}
+
+/* append n bytes to the ring, overwriting the oldest once it is full */
+int _ring_write(struct RING * ring, char * src, size_t n)
+{
+    // declarations
+    size_t new_cap;
+    char * new_data;
+    size_t i;
+    int fd;
+
+    // grow while there is room to
+    while (ring->len + n > ring->cap && ring->cap < RING_MAX)
+    {
+        new_cap = ring->cap * 2;
+
+        if (new_cap <= RING_HEAP_MAX)
+        {
+            new_data = malloc(new_cap);
+        }
+        else
+        {
+            // too big for the heap, spill to a memfd at full size
+            new_cap = RING_MAX;
+            fd = memfd_create("smallsh-job", MFD_CLOEXEC);
+            if (fd == -1 || ftruncate(fd, new_cap) == -1) { if (fd != -1) close(fd); break; }
+            new_data = mmap(NULL, new_cap, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (new_data == MAP_FAILED) { close(fd); break; }
+        }
+
+        // unwrap old contents into new storage
+        for (i = 0; i < ring->len; i++)
+        {
+            new_data[i] = ring->data[(ring->start + i) % ring->cap];
+        }
+
+        // release old storage
+        if (ring->memfd == -1) { free(ring->data); }
+        else { munmap(ring->data, ring->cap); close(ring->memfd); }
+
+        if (new_cap > RING_HEAP_MAX) { ring->memfd = fd; }
+        ring->data = new_data;
+        ring->cap = new_cap;
+        ring->start = 0;
+    }
+
+    // only the newest cap bytes of src can be kept
+    if (n > ring->cap)
+    {
+        ring->dropped += n - ring->cap;
+        src += n - ring->cap;
+        n = ring->cap;
+    }
+
+    // evict oldest bytes to make room
+    if (ring->len + n > ring->cap)
+    {
+        size_t evict = ring->len + n - ring->cap;
+        ring->start = (ring->start + evict) % ring->cap;
+        ring->len -= evict;
+        ring->dropped += evict;
+    }
+
+    // copy in (in at most two pieces)
+    for (i = 0; i < n; )
+    {
+        size_t at = (ring->start + ring->len) % ring->cap;
+        size_t chunk = ring->cap - at;
+        if (chunk > n - i) { chunk = n - i; }
+        memcpy(ring->data + at, src + i, chunk);
+        ring->len += chunk;
+        i += chunk;
+    }
+
+    return 0;
+}
+
+/* print the last lines lines of the ring to out (-1 prints all of it) */
+int _ring_print(struct RING * ring, int lines, FILE * out)
+{
+    size_t from = 0;
+    size_t i;
+    int seen = 0;
+
+    // find where the last lines lines start
+    if (lines >= 0)
+    {
+        from = ring->len;
+        for (i = ring->len; i > 0; i--)
+        {
+            char c = ring->data[(ring->start + i - 1) % ring->cap];
+            if (c == '\n' && i != ring->len && ++seen == lines) { break; }
+            from = i - 1;
+        }
+    }
+    else if (ring->dropped != 0)
+    {
+        fprintf(stderr, "smallsh: %lu earlier bytes dropped\n",
+                    (unsigned long) ring->dropped);
+        fflush(stderr);
+    }
+
+    // write out (in at most two pieces)
+    for (i = from; i < ring->len; )
+    {
+        size_t at = (ring->start + i) % ring->cap;
+        size_t chunk = ring->cap - at;
+        if (chunk > ring->len - i) { chunk = ring->len - i; }
+        fwrite(ring->data + at, 1, chunk, out);
+        i += chunk;
+    }
+    fflush(out);
+
+    return 0;
+}
+
+/* free ring buffer and its storage */
+void _ring_free(struct RING * ring)
+{
+    if (ring->memfd == -1) { free(ring->data); }
+    else { munmap(ring->data, ring->cap); close(ring->memfd); }
+    free(ring);
+}
+
+/* setup the epoll instance watching stdin, signals and the timer
+ * post-condition:  SIGCHLD, SIGINT and SIGTSTP are blocked and only
+ *                  delivered through sig_fd */
+int _ev_setup(struct CL * cl)
+{
+    // declarations
+    struct epoll_event ev = {0};
+    struct termios term;
+
+    // one-shot timer, armed with _ev_timer
+    cl->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    cl->ev_fd = epoll_create1(EPOLL_CLOEXEC);
+    ev.events = EPOLLIN;
+    ev.data.u64 = EV_TIMER;
+    epoll_ctl(cl->ev_fd, EPOLL_CTL_ADD, cl->timer_fd, &ev);
+
+    // command deadlines
+    _wheel_setup(cl);
+
+    // embedded sessions leave signals and stdin to the caller
+    cl->sig_fd = -1;
+    cl->in_always = 0;
+    cl->in_off = 1;
+    cl->is_tty = 0;
+    cl->term_fg = 0;
+    sigprocmask(SIG_BLOCK, NULL, &cl->old_mask);
+    if (!(cl->flags & (CL_INTERACTIVE | CL_SIGNALS))) { return 0; }
+
+    // route signals through a signalfd instead of handlers
+    sigemptyset(&cl->sig_mask);
+    sigaddset(&cl->sig_mask, SIGCHLD);
+    sigaddset(&cl->sig_mask, SIGINT);
+    sigaddset(&cl->sig_mask, SIGTSTP);
+    sigprocmask(SIG_BLOCK, &cl->sig_mask, &cl->old_mask);
+    cl->sig_fd = signalfd(-1, &cl->sig_mask, SFD_NONBLOCK | SFD_CLOEXEC);
+
+    // watch signals
+    ev.data.u64 = EV_SIGNAL;
+    epoll_ctl(cl->ev_fd, EPOLL_CTL_ADD, cl->sig_fd, &ev);
+    if (!(cl->flags & CL_INTERACTIVE)) { return 0; }
+
+    // terminal or script
+    cl->is_tty = (tcgetattr(0, &term) == 0 && isatty(STDOUT_FILENO));
+
+    // job control on a terminal: the shell leads its own process group,
+    // which owns the terminal whenever no foreground job does
+    if ((cl->flags & CL_JOBCTL) && tcgetattr(STDIN_FILENO, &cl->tmodes) == 0)
+    {
+        signal(SIGTTOU, SIG_IGN);
+        signal(SIGTTIN, SIG_IGN);
+        setpgid(0, 0);
+        tcsetpgrp(STDIN_FILENO, getpgrp());
+        cl->term_fg = 1;
+    }
+
+    // watch stdin
+    ev.data.u64 = EV_INPUT;
+    cl->in_off = 0;
+
+    // regular files can't be watched, they are always readable
+    if (epoll_ctl(cl->ev_fd, EPOLL_CTL_ADD, STDIN_FILENO, &ev) == -1)
+    {
+        cl->in_always = 1;
+    }
+
+    return 0;
+}
+
+/* wait up to timeout ms (-1 forever) for events
+ * post-condition:  returned mask of EV_* events that happened */
+int _ev_wait(struct CL * cl, int timeout)
+{
+    // declarations
+    struct epoll_event evs[8];
+    int events = 0;
+    int n;
+    int i;
+
+    // stdin that can't be watched never blocks
+    if (cl->in_always && !cl->in_off)
+    {
+        events |= EV_INPUT;
+        timeout = 0;
+    }
+
+    n = epoll_wait(cl->ev_fd, evs, 8, timeout);
+    for (i = 0; i < n; i++)
+    {
+        // low half is the event, high half the fd for job output
+        events |= (uint32_t) evs[i].data.u64;
+
+        // captured output is drained right here
+        if ((uint32_t) evs[i].data.u64 == EV_OUTPUT)
+        {
+            int fd = evs[i].data.u64 >> 32;
+            int j;
+            for (j = 0; j < cl->job_len; j++)
+            {
+                if (cl->jobs[j].out_fd == fd) { _job_drain(cl, &cl->jobs[j]); }
+            }
+        }
+
+        // exited jobs are marked for the next pid check
+        if ((uint32_t) evs[i].data.u64 == EV_CHILD)
+        {
+            int fd = evs[i].data.u64 >> 32;
+            int j;
+            epoll_ctl(cl->ev_fd, EPOLL_CTL_DEL, fd, NULL);
+            for (j = 0; j < cl->job_len; j++)
+            {
+                if (cl->jobs[j].pidfd == fd) { cl->jobs[j].ready = 1; cl->child_ready++; }
+            }
+        }
+
+        // prompt segments, the bit stays only if the prompt changes
+        if ((uint32_t) evs[i].data.u64 == EV_PROMPT)
+        {
+            events &= ~EV_PROMPT;
+            if (_prompt_reply(cl)) { events |= EV_PROMPT; }
+        }
+
+        // caller's fds get their callback
+        if ((uint32_t) evs[i].data.u64 == EV_WATCH)
+        {
+            int fd = evs[i].data.u64 >> 32;
+            int j;
+            for (j = 0; j < cl->watch_len; j++)
+            {
+                if (cl->watches[j].fd == fd)
+                {
+                    cl->watches[j].func(cl, fd, cl->watches[j].data);
+                    break;
+                }
+            }
+        }
+    }
+
+    // expire command deadlines
+    if (events & EV_WHEEL) { _wheel_tick(cl); }
+
+    // scheduled commands are started between lines (sched_CL)
+    if (events & EV_SCHED)
+    {
+        uint64_t expirations;
+        read(cl->sched_fd, &expirations, sizeof(expirations));
+    }
+
+    // clear expired timer
+    if (events & EV_TIMER)
+    {
+        uint64_t expirations;
+        read(cl->timer_fd, &expirations, sizeof(expirations));
+    }
+
+    return events;
+}
+
+/* start (on = 1) or stop (on = 0) watching stdin for input */
+int _ev_input(struct CL * cl, int on)
+{
+    struct epoll_event ev = {0};
+
+    if (!(cl->flags & CL_INTERACTIVE)) { return 0; }
+    cl->in_off = !on;
+    if (cl->in_always) { return 0; }
+
+    // removed rather than masked, a hung up pipe reports EPOLLHUP anyway
+    ev.events = EPOLLIN;
+    ev.data.u64 = EV_INPUT;
+    return epoll_ctl(cl->ev_fd, on ? EPOLL_CTL_ADD : EPOLL_CTL_DEL, STDIN_FILENO, &ev);
+}
+
+/* arm the timer to expire once in ms milliseconds (0 disarms it) */
+int _ev_timer(struct CL * cl, int ms)
+{
+    struct itimerspec its = {0};
+
+    its.it_value.tv_sec = ms / 1000;
+    its.it_value.tv_nsec = (ms % 1000) * 1000000L;
+    return timerfd_settime(cl->timer_fd, 0, &its, NULL);
+}
+
+/* read all pending signals from sig_fd and record them in cl
+ * post-condition:  returned number of signals read */
+int _ev_signals(struct CL * cl)
+{
+    struct signalfd_siginfo info;
+    int count = 0;
+
+    // embedded sessions can't tell when children exit, always check
+    if (cl->sig_fd == -1)
+    {
+        cl->child_pending = 1;
+        return 0;
+    }
+
+    while (read(cl->sig_fd, &info, sizeof(info)) == sizeof(info))
+    {
+        count++;
+        if (info.ssi_signo == SIGCHLD)
+        {
+            cl->child_pending = 1;
+        }
+        else if (info.ssi_signo == SIGTSTP && (cl->flags & CL_JOBCTL))
+        {
+            // jobs are stopped by the terminal, the shell itself isn't
+        }
+        else if (info.ssi_signo == SIGTSTP)
+        {
+            // toggle background blocking mode
+            cl->bg_block_mode = !cl->bg_block_mode;
+            cl->mode_changed = !cl->mode_changed;
+        }
+        else
+        {
+            // SIGINT is ignored by the shell itself
+        }
+    }
+
+    return count;
+}
+
+
+/*** built-ins ***/
+/* name of built-in i, to go through them all
+ * post-condition:  returned NULL past the last one */
+char * _builtin_name(int i)
+{
+    return builtins[i].name;
+}
+
+/* look up the built-in command for argv
+ * post-condition:  returned NULL if argv is not a built-in */
+builtin_fn _find_builtin(int argc, char ** argv)
+{
+    int i;
+
+    // tail is only built-in when viewing a job ("%n")
+    if (strcmp(argv[0], "tail") == 0 && (argc < 2 || argv[argc - 1][0] != '%'))
+    {
+        return NULL;
+    }
+
+    for (i = 0; builtins[i].name != NULL; i++)
+    {
+        if (strcmp(argv[0], builtins[i].name) == 0) { return builtins[i].func; }
+    }
+
+    return NULL;
+}
+
+/* built-in exit command (exits the shell) */
+int _CL_exit(int argc, char ** argv, struct CL * cl)
+{
+    (void) argc; (void) argv; (void) cl;
+    return -1;
+}
+
+/* built-in cd command (change directory), "cd [-L|-P] [dir|-]", home if
+ * no dir and $OLDPWD for "-" */
+int _CL_cd(int argc, char ** argv, struct CL * cl)
+{
+    // declarations
+    char * dir;
+    int physical = 0;
+    int i = 1;
+
+    for ( ; i < argc && (strcmp(argv[i], "-L") == 0 || strcmp(argv[i], "-P") == 0); i++)
+    {
+        physical = (argv[i][1] == 'P');
+    }
+
+    // where to
+    if (i == argc)                    { dir = getenv("HOME"); }
+    else if (strcmp(argv[i], "-") == 0) { dir = getenv("OLDPWD"); }
+    else                              { dir = argv[i]; }
+    if (dir == NULL || dir[0] == '\0')
+    {
+        fprintf(stderr, "smallsh: cd: %s not set\n", (i == argc) ? "HOME" : "OLDPWD");
+        fflush(stderr);
+        _set_status(cl, 1);
+        return 1;
+    }
+
+    if (_dirs_cd(cl, dir, physical) == -1) { _set_status(cl, 1); return 1; }
+
+    // "cd -" says where it went
+    if (i < argc && strcmp(argv[i], "-") == 0)
+    {
+        fflush(stdout);
+        printf("%s\n", cl->pwd);
+        fflush(stdout);
+    }
+
+    _set_status(cl, 0);
+    return 0;
+}
+
+/* built-in status command (shows shell status) */
+int _CL_status(int argc, char ** argv, struct CL * cl)
+{
+    char * timed_out = cl->fg_timed_out ? "timed out, " : "";
+
+    (void) argc; (void) argv;
+    if      (cl->fg_exited)
+    {
+        fflush(stdout);
+        printf("%sexit value %d\n", timed_out, cl->fg_status);
+        fflush(stdout);
+    }
+    else if (cl->fg_signaled)
+    {
+        fflush(stdout);
+        printf("%sterminated by signal %d\n", timed_out, cl->fg_status);
+        fflush(stdout);
+    }
+    return 0;
+}
+
+/* built-in timeout command, "timeout DURATION" sets the default deadline
+ * of commands ("timeout 0" removes it), "timeout" prints it
+ * ("timeout DURATION cmd ..." is handled by _execute_CL) */
+int _CL_timeout(int argc, char ** argv, struct CL * cl)
+{
+    long ms;
+
+    if (argc == 1)
+    {
+        fflush(stdout);
+        if (cl->timeout_ms == 0) { printf("no timeout\n"); }
+        else                     { printf("timeout %ldms\n", cl->timeout_ms); }
+        fflush(stdout);
+        return 0;
+    }
+
+    if ((ms = _parse_duration(argv[1])) == -1)
+    {
+        fprintf(stderr, "smallsh: timeout: %s: invalid duration\n", argv[1]);
+        fflush(stderr);
+        return 1;
+    }
+    cl->timeout_ms = ms;
+
+    return 0;
+}
+
+
+/* built-in jobs command (list background jobs)
+ * "jobs -o %n" prints all output captured from job n */
+int _CL_jobs(int argc, char ** argv, struct CL * cl)
+{
+    // declarations
+    struct JOB * job;
+    int i;
+
+    // print captured output
+    if (argc > 1 && strcmp(argv[1], "-o") == 0)
+    {
+        if ((job = _find_job(cl, argv[2])) == NULL) { return 1; }
+        if (job->out == NULL)
+        {
+            fprintf(stderr, "smallsh: %s: output was not captured\n", argv[2]);
+            fflush(stderr);
+            return 1;
+        }
+        _job_drain(cl, job);
+        _ring_print(job->out, -1, stdout);
+        return 0;
+    }
+
+    // list jobs
+    fflush(stdout);
+    for (i = 0; i < cl->job_len; i++)
+    {
+        job = &cl->jobs[i];
+        printf("[%d] %-8s %d  %s", job->id,
+                    job->done ? "done" : job->stopped ? "stopped" : "running",
+                    job->pid, job->cmd);
+        if (job->out != NULL)
+        {
+            printf("  (%lu bytes captured)", (unsigned long) job->out->len);
+        }
+        putchar('\n');
+    }
+    fflush(stdout);
+
+    return 0;
+}
+
+/* built-in fg command, continues job n ("fg [%n]", default is the newest
+ * job) in the foreground */
+int _CL_fg(int argc, char ** argv, struct CL * cl)
+{
+    // declarations
+    struct JOB * job;
+    int idx;
+
+    if ((job = _resume_job(cl, argc > 1 ? argv[1] : NULL)) == NULL) { _set_status(cl, 1); return 1; }
+    idx = job - cl->jobs;
+
+    fflush(stdout);
+    printf("%s\n", job->cmd);
+    fflush(stdout);
+
+    // continue it with the terminal
+    cl->fg_ran = 1;
+    job->stopped = 0;
+    if (cl->term_fg) { tcsetpgrp(STDIN_FILENO, job->pid); }
+    _job_kill(job->pid, job->pidfd, SIGCONT);
+
+    // stopped again
+    if (_foreground(cl, job->pid, job->pidfd, &job->deadline) == 1)
+    {
+        job->stopped = 1;
+        printf("[%d] stopped  %s\n", job->id, job->cmd);
+        fflush(stdout);
+        return 0;
+    }
+
+    // done, keep captured output around like any finished job
+    job->done = 1;
+    cl->stats.jobs_reaped++;
+    if (job->out != NULL) { _job_drain(cl, job); }
+    else                  { _remove_job(cl, idx); }
+
+    return 0;
+}
+
+/* built-in bg command, continues stopped job n ("bg [%n]", default is the
+ * newest job) in the background */
+int _CL_bg(int argc, char ** argv, struct CL * cl)
+{
+    struct JOB * job;
+
+    if ((job = _resume_job(cl, argc > 1 ? argv[1] : NULL)) == NULL) { _set_status(cl, 1); return 1; }
+
+    job->stopped = 0;
+    _job_kill(job->pid, job->pidfd, SIGCONT);
+
+    fflush(stdout);
+    printf("[%d] %s &\n", job->id, job->cmd);
+    fflush(stdout);
+
+    _set_status(cl, 0);
+    return 0;
+}
+
+/* built-in wait command, "wait [-n] [-t DURATION] [%n ...]" waits for the
+ * given jobs (default all), or with -n for the first of them to finish,
+ * giving up after DURATION (status 124), status is that of the last job
+ * (127 if the last one given is no job) */
+int _CL_wait(int argc, char ** argv, struct CL * cl)
+{
+    // declarations
+    struct timespec start, now;
+    struct JOB * job;
+    long timeout_ms = -1;
+    long left_ms = -1;
+    int status = 0;
+    int unknown = 0;
+    int any = 0;
+    int running;
+    int done;
+    int i;
+
+    // options
+    for (i = 1; i < argc && argv[i][0] == '-'; i++)
+    {
+        if (strcmp(argv[i], "-n") == 0) { any = 1; }
+        else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc
+                 && (timeout_ms = _parse_duration(argv[i + 1])) != -1) { i++; }
+        else
+        {
+            fprintf(stderr, "smallsh: wait: usage: wait [-n] [-t DURATION] [%%n ...]\n");
+            fflush(stderr);
+            _set_status(cl, 2);
+            return 1;
+        }
+    }
+
+    // jobs to wait for are kept until their status is read
+    if (i == argc)
+    {
+        for (job = cl->jobs; job < cl->jobs + cl->job_len; job++)
+        {
+            if (!job->done) { job->waited = 1; }
+        }
+    }
+    for (; i < argc; i++)
+    {
+        if ((job = _find_job(cl, argv[i])) != NULL) { job->waited = 1; }
+        unknown = (job == NULL);
+    }
+
+    // every exit is an event, nothing is polled (input waits till after)
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    _ev_input(cl, 0);
+    while (1)
+    {
+        // exits seen by an earlier pass of the event loop (whose pidfds
+        // are no longer watched) are reaped first
+        pid_check_CL(cl);
+
+        running = 0;
+        done = 0;
+        for (job = cl->jobs; job < cl->jobs + cl->job_len; job++)
+        {
+            if (job->waited && job->done)  { done++; }
+            if (job->waited && !job->done) { running++; }
+        }
+        if (running == 0 || (any && done > 0)) { break; }
+
+        // out of time
+        if (timeout_ms != -1)
+        {
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            left_ms = timeout_ms - ((now.tv_sec - start.tv_sec) * 1000
+                                    + (now.tv_nsec - start.tv_nsec) / 1000000);
+            if (left_ms <= 0) { break; }
+        }
+
+        // (without signals or pidfds, exits are only noticed every tick)
+        if (cl->sig_fd == -1 && left_ms == -1) { left_ms = WHEEL_TICK_MS; }
+        _ev_wait(cl, left_ms);
+        if (timeout_ms == -1) { left_ms = -1; }
+    }
+    _ev_input(cl, 1);
+
+    // status of the last finished job, the others are left as they were
+    for (i = 0; i < cl->job_len; i++)
+    {
+        job = &cl->jobs[i];
+        if (!job->waited) { continue; }
+        job->waited = 0;
+        if (!job->done) { continue; }
+
+        status = job->status;
+        if (job->out == NULL) { _remove_job(cl, i); i--; }
+    }
+
+    // set status like a foreground command
+    cl->fg_ran = 1;
+    cl->fg_timed_out = 0;
+    cl->fg_exited = 1;
+    cl->fg_signaled = 0;
+    if (unknown) { cl->fg_status = 127; }
+    else if (running > 0 && !(any && done > 0)) { cl->fg_status = 124; }
+    else if (WIFSIGNALED(status))
+    {
+        cl->fg_status = WTERMSIG(status);
+        cl->fg_exited = 0;
+        cl->fg_signaled = 1;
+    }
+    else { cl->fg_status = WEXITSTATUS(status); }
+
+    return 0;
+}
+
+/* built-in stats command, "stats" prints the session's statistics and
+ * "stats --json" prints them as json */
+int _CL_stats(int argc, char ** argv, struct CL * cl)
+{
+    fflush(stdout);
+    if (argc > 1 && strcmp(argv[1], "--json") == 0) { _stats_json(cl, stdout); }
+    else                                             { _stats_print(cl, stdout); }
+    fflush(stdout);
+
+    return 0;
+}
+
+/* built-in tail command for captured output ("tail [-n lines] %n") */
+int _CL_tail(int argc, char ** argv, struct CL * cl)
+{
+    // declarations
+    struct JOB * job;
+    int lines = TAIL_LINES;
+
+    if (argc > 3 && strcmp(argv[1], "-n") == 0) { lines = atoi(argv[2]); }
+
+    // job is always the last arg
+    if ((job = _find_job(cl, argv[argc - 1])) == NULL) { return 1; }
+    if (job->out == NULL)
+    {
+        fprintf(stderr, "smallsh: %s: output was not captured\n", argv[argc - 1]);
+        fflush(stderr);
+        return 1;
+    }
+
+    _job_drain(cl, job);
+    _ring_print(job->out, lines, stdout);
+
+    return 0;
+}
+
+/* alias command, "alias name=words ..." defines an alias (everything
+ * after the "=" is its value), "alias name" shows one, "alias" all */
+int _CL_alias(int argc, char ** argv, struct CL * cl)
+{
+    // declarations
+    struct HASH_ENT * ent;
+    struct ALIAS * alias;
+    char * value;
+    char * eq;
+    int len = 0;
+    int i;
+
+    // list all
+    fflush(stdout);
+    if (argc == 1)
+    {
+        for (i = 0; i < cl->aliases.size; i++)
+        {
+            for (ent = cl->aliases.buckets[i]; ent != NULL; ent = ent->next)
+            {
+                printf("alias %s='%s'\n", ent->key, ((struct ALIAS*) ent->val)->text);
+            }
+        }
+        fflush(stdout);
+        return 0;
+    }
+
+    // show one
+    if ((eq = strchr(argv[1], '=')) == NULL)
+    {
+        if ((alias = _hash_get(&cl->aliases, argv[1])) == NULL)
+        {
+            fprintf(stderr, "smallsh: alias: %s: not found\n", argv[1]);
+            fflush(stderr);
+            return 1;
+        }
+        printf("alias %s='%s'\n", argv[1], alias->text);
+        fflush(stdout);
+        return 0;
+    }
+
+    // define, the value is the rest of the line (without outer quotes)
+    for (i = 1; i < argc; i++) { len += strlen(argv[i]) + 1; }
+    value = malloc(len);
+    strcpy(value, eq + 1);
+    for (i = 2; i < argc; i++) { strcat(value, " "); strcat(value, argv[i]); }
+    len = strlen(value);
+    if (len >= 2 && (value[0] == '\'' || value[0] == '"') && value[len - 1] == value[0])
+    {
+        memmove(value, value + 1, len - 2);
+        value[len - 2] = '\0';
+    }
+
+    *eq = '\0';
+    _free_alias(_hash_put(&cl->aliases, argv[1], _new_alias(value)));
+    *eq = '=';
+    free(value);
+
+    return 0;
+}
+
+/* unalias command, removes the aliases named */
+int _CL_unalias(int argc, char ** argv, struct CL * cl)
+{
+    struct ALIAS * alias;
+    int result = 0;
+    int i;
+
+    for (i = 1; i < argc; i++)
+    {
+        if ((alias = _hash_del(&cl->aliases, argv[i])) == NULL)
+        {
+            fprintf(stderr, "smallsh: unalias: %s: not found\n", argv[i]);
+            fflush(stderr);
+            result = 1;
+        }
+        _free_alias(alias);
+    }
+
+    return result;
+}
+
+/* functions command, shows the functions named (all without names) */
+int _CL_functions(int argc, char ** argv, struct CL * cl)
+{
+    struct HASH_ENT * ent;
+    struct FUNC * func;
+    int result = 0;
+    int i;
+
+    fflush(stdout);
+    if (argc == 1)
+    {
+        for (i = 0; i < cl->funcs.size; i++)
+        {
+            for (ent = cl->funcs.buckets[i]; ent != NULL; ent = ent->next)
+            {
+                printf("%s() { %s ; }\n", ent->key, ((struct FUNC*) ent->val)->text);
+            }
+        }
+    }
+    for (i = 1; i < argc; i++)
+    {
+        if ((func = _hash_get(&cl->funcs, argv[i])) == NULL)
+        {
+            fprintf(stderr, "smallsh: functions: %s: not found\n", argv[i]);
+            fflush(stderr);
+            result = 1;
+            continue;
+        }
+        printf("%s() { %s ; }\n", argv[i], func->text);
+    }
+    fflush(stdout);
+
+    return result;
+}
+
+/* unfunction command, removes the functions named */
+int _CL_unfunction(int argc, char ** argv, struct CL * cl)
+{
+    struct FUNC * func;
+    int result = 0;
+    int i;
+
+    for (i = 1; i < argc; i++)
+    {
+        if ((func = _hash_del(&cl->funcs, argv[i])) == NULL)
+        {
+            fprintf(stderr, "smallsh: unfunction: %s: not found\n", argv[i]);
+            fflush(stderr);
+            result = 1;
+        }
+        _drop_func(func);
+    }
+
+    return result;
+}
+
+/* true command, succeeds */
+int _CL_true(int argc, char ** argv, struct CL * cl)
+{
+    (void) argc; (void) argv;
+    _set_status(cl, 0);
+    return 0;
+}
+
+/* false command, fails */
+int _CL_false(int argc, char ** argv, struct CL * cl)
+{
+    (void) argc; (void) argv;
+    _set_status(cl, 1);
+    return 0;
+}
+
+/* test command (and "[", which wants a "]" last), checks one expression:
+ * "[!] word", "[!] -e|-f|-d|-r|-w|-x|-s|-n|-z word" or
+ * "[!] word =|!=|-eq|-ne|-lt|-le|-gt|-ge word", exit value 0 if it holds,
+ * 1 if not and 2 if it can't be read */
+int _CL_test(int argc, char ** argv, struct CL * cl)
+{
+    // declarations
+    struct stat st;
+    char * op;
+    char * a;
+    char * b;
+    long x, y;
+    int neg = 0;
+    int ok = 0;
+
+    // "[ ... ]"
+    if (strcmp(argv[0], "[") == 0)
+    {
+        if (strcmp(argv[argc - 1], "]") != 0)
+        {
+            fputs("smallsh: [: missing \"]\"\n", stderr);
+            fflush(stderr);
+            _set_status(cl, 2);
+            return 1;
+        }
+        argc--;
+    }
+    argv++;
+    argc--;
+
+    if (argc > 0 && strcmp(argv[0], "!") == 0) { neg = 1; argv++; argc--; }
+
+    if (argc == 0) { ok = 0; }
+    else if (argc == 1) { ok = (argv[0][0] != '\0'); }
+    else if (argc == 2 && argv[0][0] == '-' && strlen(argv[0]) == 2)
+    {
+        a = argv[1];
+        switch (argv[0][1])
+        {
+        case 'e': ok = (stat(a, &st) == 0); break;
+        case 'f': ok = (stat(a, &st) == 0 && S_ISREG(st.st_mode)); break;
+        case 'd': ok = (stat(a, &st) == 0 && S_ISDIR(st.st_mode)); break;
+        case 's': ok = (stat(a, &st) == 0 && st.st_size > 0); break;
+        case 'r': ok = (access(a, R_OK) == 0); break;
+        case 'w': ok = (access(a, W_OK) == 0); break;
+        case 'x': ok = (access(a, X_OK) == 0); break;
+        case 'n': ok = (a[0] != '\0'); break;
+        case 'z': ok = (a[0] == '\0'); break;
+        default:  argc = -1;
+        }
+    }
+    else if (argc == 3)
+    {
+        a = argv[0];
+        op = argv[1];
+        b = argv[2];
+        x = strtol(a, NULL, 10);
+        y = strtol(b, NULL, 10);
+        if      (strcmp(op, "=") == 0)   { ok = (strcmp(a, b) == 0); }
+        else if (strcmp(op, "==") == 0)  { ok = (strcmp(a, b) == 0); }
+        else if (strcmp(op, "!=") == 0)  { ok = (strcmp(a, b) != 0); }
+        else if (strcmp(op, "-eq") == 0) { ok = (x == y); }
+        else if (strcmp(op, "-ne") == 0) { ok = (x != y); }
+        else if (strcmp(op, "-lt") == 0) { ok = (x < y); }
+        else if (strcmp(op, "-le") == 0) { ok = (x <= y); }
+        else if (strcmp(op, "-gt") == 0) { ok = (x > y); }
+        else if (strcmp(op, "-ge") == 0) { ok = (x >= y); }
+        else                             { argc = -1; }
+    }
+    else { argc = -1; }
+
+    // couldn't make sense of it
+    if (argc == -1)
+    {
+        fputs("smallsh: test: unknown expression\n", stderr);
+        fflush(stderr);
+        _set_status(cl, 2);
+        return 1;
+    }
+
+    _set_status(cl, (ok != neg) ? 0 : 1);
+    return 0;
+}
+
+/* break and continue commands, "break [n]" leaves the n innermost loops
+ * being run, "continue [n]" goes on with the next pass of the nth */
+int _CL_break(int argc, char ** argv, struct CL * cl)
+{
+    int levels = (argc > 1) ? atoi(argv[1]) : 1;
+
+    if (cl->loop_depth == 0 || levels < 1)
+    {
+        fprintf(stderr, "smallsh: %s: only meaningful in a loop\n", argv[0]);
+        fflush(stderr);
+        _set_status(cl, 1);
+        return 1;
+    }
+
+    // picked up by the loops on the way out (see _ast_loop_end)
+    cl->loop_ctl = (strcmp(argv[0], "break") == 0) ? LOOP_BREAK : LOOP_CONTINUE;
+    cl->loop_levels = (levels < cl->loop_depth) ? levels : cl->loop_depth;
+
+    return 0;
+}
+
+/* unset command, removes the shell (or environment) variables named */
+int _CL_unset(int argc, char ** argv, struct CL * cl)
+{
+    int i;
+
+    for (i = 1; i < argc; i++)
+    {
+        free(_hash_del(&cl->vars, argv[i]));
+        unsetenv(argv[i]);
+        if (strcmp(argv[i], "PATH") == 0) { _path_changed(cl); }
+    }
+
+    return 0;
+}
+
+/* let command (and "(( expr ))"), evaluates each arg as an integer
+ * expression, exit value 0 if the last is not 0, 1 if it is (or on error) */
+int _CL_let(int argc, char ** argv, struct CL * cl)
+{
+    int64_t value = 0;
+    int i;
+
+    if (argc == 1)
+    {
+        fputs("smallsh: let: expression expected\n", stderr);
+        fflush(stderr);
+        _set_status(cl, 1);
+        return 1;
+    }
+
+    for (i = 1; i < argc; i++)
+    {
+        if (_arith_eval(cl, argv[i], &value) != 0) { _set_status(cl, 1); return 1; }
+    }
+
+    _set_status(cl, (value != 0) ? 0 : 1);
+    return 0;
+}
+
+/* prompt command, "prompt FORMAT ..." sets the format of the prompt (the
+ * words joined by spaces, then a space), "prompt -d" sets the default
+ * one back and "prompt" prints it (see prompt.c for the segments) */
+int _CL_prompt(int argc, char ** argv, struct CL * cl)
+{
+    int len = 1;
+    int i;
+
+    if (argc == 1)
+    {
+        fflush(stdout);
+        printf("%s\n", cl->prompt_fmt);
+        fflush(stdout);
+        return 0;
+    }
+
+    free(cl->prompt_fmt);
+    if (argc == 2 && strcmp(argv[1], "-d") == 0)
+    {
+        cl->prompt_fmt = strdup(PROMPT_DEFAULT);
+        return 0;
+    }
+
+    for (i = 1; i < argc; i++) { len += strlen(argv[i]) + 1; }
+    cl->prompt_fmt = malloc(len);
+    cl->prompt_fmt[0] = '\0';
+    for (i = 1; i < argc; i++)
+    {
+        strcat(cl->prompt_fmt, argv[i]);
+        strcat(cl->prompt_fmt, " ");
+    }
+
+    return 0;
+}
+
+/* sched command, lists the commands "at" and "every" scheduled (soonest
+ * first), "sched -c ID ..." cancels them (a run going on is left alone) */
+int _CL_sched(int argc, char ** argv, struct CL * cl)
+{
+    // declarations
+    struct SCHED ** list;
+    struct SCHED * s;
+    char when[32];
+    char every[32];
+    long now = _now_us();
+    int result = 0;
+    int i, j;
+
+    // cancel
+    if (argc > 1 && strcmp(argv[1], "-c") == 0)
+    {
+        for (i = 2; i < argc; i++)
+        {
+            for (j = 0; j < cl->sched_len; j++)
+            {
+                if (cl->sched[j]->id == atoi(argv[i])) { break; }
+            }
+            if (j == cl->sched_len)
+            {
+                fprintf(stderr, "smallsh: sched: %s: no such id\n", argv[i]);
+                fflush(stderr);
+                result = 1;
+                continue;
+            }
+            _sched_free(_sched_remove(cl, j));
+        }
+        _sched_arm(cl);
+        _set_status(cl, result);
+        return result;
+    }
+
+    // list, soonest first
+    list = malloc((cl->sched_len + 1) * sizeof(struct SCHED*));
+    memcpy(list, cl->sched, cl->sched_len * sizeof(struct SCHED*));
+    qsort(list, cl->sched_len, sizeof(struct SCHED*), _sched_cmp);
+
+    fflush(stdout);
+    for (i = 0; i < cl->sched_len; i++)
+    {
+        s = list[i];
+        _sched_fmt(when, s->due_us > now ? s->due_us - now : 0);
+        if (s->every_us == 0) { strcpy(every, "once"); }
+        else
+        {
+            strcpy(every, "every ");
+            _sched_fmt(every + 6, s->every_us);
+        }
+        printf("[%d] in %-8s %-14s %-8s runs %lu, skipped %lu%s  %s\n", s->id, when, every,
+                    s->every_us == 0 ? "" : s->policy == SCHED_QUEUE ? "queue" :
+                    s->policy == SCHED_PARALLEL ? "parallel" : "skip",
+                    s->runs, s->skipped, _sched_running(cl, s) ? ", running" : "", s->cmd);
+    }
+    fflush(stdout);
+    free(list);
+
+    _set_status(cl, 0);
+    return 0;
+}
+
+/* tasks command, "tasks [-j N] [-f FILE] [TASK ...]" runs the tasks given
+ * (default the first) of the task file (default Taskfile), and the ones
+ * they depend on, N at once (default one per cpu), see tasks.c */
+int _CL_tasks(int argc, char ** argv, struct CL * cl)
+{
+    // declarations
+    struct TASKS ts = {0};
+    char * path = TASKS_FILE;
+    int result = 0;
+    int idx;
+    int i;
+
+    ts.max = _tasks_jobs();
+
+    // options
+    for (i = 1; i < argc && argv[i][0] == '-'; i++)
+    {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0)
+        {
+            ts.max = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) { path = argv[++i]; }
+        else
+        {
+            fprintf(stderr, "smallsh: tasks: usage: tasks [-j N] [-f FILE] [TASK ...]\n");
+            fflush(stderr);
+            _set_status(cl, 1);
+            return 1;
+        }
+    }
+
+    // the tasks asked for, and what they depend on
+    _hash_init(&ts.names, NAME_TABLE_SIZE);
+    result = _tasks_load(&ts, path);
+    if (result == 0 && ts.len == 0)
+    {
+        fprintf(stderr, "smallsh: tasks: %s: no tasks\n", path);
+        result = 1;
+    }
+    for ( ; result == 0 && i < argc; i++)
+    {
+        if ((idx = _tasks_find(&ts, argv[i])) == -1)
+        {
+            fprintf(stderr, "smallsh: tasks: %s: no such task\n", argv[i]);
+            result = 1;
+        }
+        else { result = _tasks_need(&ts, idx); }
+    }
+    if (result == 0 && i == argc && argc > 0 && _tasks_find(&ts, argv[argc - 1]) == -1)
+    {
+        result = _tasks_need(&ts, 0);
+    }
+    fflush(stderr);
+
+    if (result == 0) { result = _tasks_run(cl, &ts); }
+    _tasks_free(&ts);
+
+    _set_status(cl, result);
+    return result;
+}
+
+/* pushd command, "pushd [dir]" changes to dir putting the directory it
+ * leaves on the stack (with no dir, swaps it with the top of the stack) */
+int _CL_pushd(int argc, char ** argv, struct CL * cl)
+{
+    // declarations
+    char * old = strdup(cl->pwd);
+    char * dir;
+
+    if (argc == 1 && cl->dirs_len == 0)
+    {
+        fputs("smallsh: pushd: no other directory\n", stderr);
+        fflush(stderr);
+        free(old);
+        _set_status(cl, 1);
+        return 1;
+    }
+
+    // no dir is the top, which the old one replaces
+    dir = (argc > 1) ? argv[1] : cl->dirs[cl->dirs_len - 1];
+    if (_dirs_cd(cl, dir, 0) == -1)
+    {
+        free(old);
+        _set_status(cl, 1);
+        return 1;
+    }
+    if (argc == 1)
+    {
+        free(cl->dirs[cl->dirs_len - 1]);
+        cl->dirs[cl->dirs_len - 1] = old;
+    }
+    else
+    {
+        // check if stack needs to grow
+        if (cl->dirs_len == cl->dirs_size)
+        {
+            cl->dirs_size = cl->dirs_size ? cl->dirs_size * 2 : 8;
+            cl->dirs = realloc(cl->dirs, cl->dirs_size * sizeof(char*));
+        }
+        cl->dirs[cl->dirs_len++] = old;
+    }
+
+    _dirs_print(cl, 0);
+    _set_status(cl, 0);
+    return 0;
+}
+
+/* popd command, changes to the directory on top of the stack and takes
+ * it off */
+int _CL_popd(int argc, char ** argv, struct CL * cl)
+{
+    (void) argc; (void) argv;
+    if (cl->dirs_len == 0)
+    {
+        fputs("smallsh: popd: directory stack empty\n", stderr);
+        fflush(stderr);
+        _set_status(cl, 1);
+        return 1;
+    }
+
+    if (_dirs_cd(cl, cl->dirs[cl->dirs_len - 1], 0) == -1) { _set_status(cl, 1); return 1; }
+    free(cl->dirs[--cl->dirs_len]);
+
+    _dirs_print(cl, 0);
+    _set_status(cl, 0);
+    return 0;
+}
+
+/* dirs command, prints the directory stack ("-v" numbered, a line each)
+ * or clears it ("-c") */
+int _CL_dirs(int argc, char ** argv, struct CL * cl)
+{
+    if (argc > 1 && strcmp(argv[1], "-c") == 0)
+    {
+        while (cl->dirs_len > 0) { free(cl->dirs[--cl->dirs_len]); }
+    }
+    else { _dirs_print(cl, argc > 1 && strcmp(argv[1], "-v") == 0); }
+
+    _set_status(cl, 0);
+    return 0;
+}
+
+/* z command, "z [-l] word ..." changes to the most frecent (often and
+ * recently visited) directory with the words in its path, in order; "-l"
+ * (or no words) lists the matches, best last */
+int _CL_z(int argc, char ** argv, struct CL * cl)
+{
+    // declarations
+    struct HASH_ENT * ent;
+    struct ZMATCH * list;
+    struct stat st;
+    long now = time(NULL);
+    int list_only = 0;
+    int len = 0;
+    int result = 0;
+    int i = 1;
+    int b;
+
+    if (i < argc && strcmp(argv[i], "-l") == 0) { list_only = 1; i++; }
+    if (i == argc) { list_only = 1; }
+
+    // matches, the current directory is no place to jump to
+    _z_load(cl);
+    list = malloc((cl->z_dirs.len + 1) * sizeof(struct ZMATCH));
+    for (b = 0; b < cl->z_dirs.size; b++)
+    {
+        for (ent = cl->z_dirs.buckets[b]; ent != NULL; ent = ent->next)
+        {
+            if (!_z_match(ent->key, argv + i, argc - i)) { continue; }
+            if (!list_only && strcmp(ent->key, cl->pwd) == 0) { continue; }
+            list[len].path = ent->key;
+            list[len].score = _z_score(ent->val, now);
+            len++;
+        }
+    }
+    qsort(list, len, sizeof(struct ZMATCH), _z_cmp);
+
+    if (list_only)
+    {
+        fflush(stdout);
+        for (i = 0; i < len; i++) { printf("%-10.1f %s\n", list[i].score, list[i].path); }
+        fflush(stdout);
+    }
+    else
+    {
+        // best that is still there
+        while (len > 0 && (stat(list[len - 1].path, &st) == -1 || !S_ISDIR(st.st_mode))) { len--; }
+        if (len == 0)
+        {
+            fputs("smallsh: z: no match\n", stderr);
+            fflush(stderr);
+            result = 1;
+        }
+        else if (_dirs_cd(cl, list[len - 1].path, 0) == -1) { result = 1; }
+    }
+
+    free(list);
+    _set_status(cl, result);
+    return result;
+}
@@ -0,0 +1,779 @@
+/*
+ * library  -   libsmallsh (private interface)
+ * author   -   Nicholas Olson
+ */
+
+#ifndef LIBSMALLSH_H
+#define LIBSMALLSH_H
+
+/*** includes ***/
+#include <stdio.h>      // for FILE
+#include <stddef.h>     // for size_t
+#include <sys/types.h>  // for ssize_t
+#include <signal.h>     // for sigset_t
+#include <termios.h>    // for struct termios
+#include <stdint.h>     // for int64_t
+#include <sys/stat.h>   // for struct stat
+#include "smallsh.h"    // public interface
+
+
+/*** defines ***/
+#define CL_BUFF_SIZE 2048
+#define CL_ARGS_SIZE 512
+#define PWD_BUFF_SIZE 100
+#define IN_PEND_SIZE 4096
+#define SEQ_MAX 16
+
+/* events returned by the event loop */
+#define EV_INPUT  1     // stdin is readable
+#define EV_SIGNAL 2     // signal is pending on sig_fd
+#define EV_TIMER  4     // timer_fd expired
+#define EV_OUTPUT 8     // captured job output is readable (handled in _ev_wait)
+#define EV_WATCH  16    // fd from watch_CL is readable (handled in _ev_wait)
+#define EV_WHEEL  32    // deadline wheel ticked (handled in _ev_wait)
+#define EV_CHILD  64    // pidfd of a job is readable (handled in _ev_wait)
+#define EV_FG     128   // pidfd of the foreground child is readable
+#define EV_PROMPT 256   // prompt helper answered, prompt shows something new
+#define EV_SCHED  512   // a scheduled command is due (started by sched_CL)
+
+/* command deadlines */
+#define WHEEL_SLOTS 512         // slots in the deadline wheel
+#define WHEEL_TICK_MS 100       // time covered by each slot
+#define TIMEOUT_GRACE_MS 5000   // time between SIGTERM and SIGKILL
+
+/* captured background output */
+#define RING_START 4096         // initial size of a capture buffer
+#define RING_HEAP_MAX 65536     // largest capture buffer kept on the heap
+#define RING_MAX 1048576        // largest capture buffer (memfd backed)
+#define CAPTURE_KEEP 8          // finished jobs kept around for their output
+#define TAIL_LINES 10           // default number of lines for "tail %n"
+
+/* prompt */
+#define PROMPT_DEFAULT ": "     // format of the prompt until "prompt" sets one
+#define PROMPT_MAX 1024         // longest rendered prompt
+#define PROMPT_MSG_MAX 8192     // largest answer of the prompt helper
+#define PROMPT_LOAD_TTL_US 5000000L // load average is asked for again after
+
+/* what a periodic command still running when due again does */
+#define SCHED_SKIP     0    // doesn't run this time
+#define SCHED_QUEUE    1    // runs once the last run is done
+#define SCHED_PARALLEL 2    // runs alongside it
+
+/* task runner */
+#define TASKS_FILE "Taskfile"   // file "tasks" reads unless "-f" says otherwise
+
+/* states of a task */
+#define TASK_UNSEEN  0  // not needed (yet)
+#define TASK_ON      1  // its dependencies are being looked at
+#define TASK_WAITING 2  // needed, waits for the tasks it depends on
+#define TASK_RUNNING 3  // one of its commands is running
+#define TASK_DONE    4  // its commands succeeded
+#define TASK_FRESH   5  // up to date, skipped
+#define TASK_FAILED  6  // one of its commands failed
+
+/* directory navigation */
+#define Z_FILE ".smallsh_z"     // jump index of "z", in $HOME unless Z_ENV says
+#define Z_ENV "SMALLSH_Z"       // path of the jump index
+#define Z_RANK_MAX 9000         // total rank the index is aged at
+#define Z_AGE 0.99              // ranks are multiplied by when aged
+#define Z_SLACK 64              // repeated lines the index keeps before a rewrite
+
+/* startup file */
+#define RC_FILE ".smallshrc"    // run at startup, in $HOME unless RC_ENV says
+#define RC_ENV "SMALLSH_RC"     // path of the startup file ("" for none)
+#define RC_SNAP_EXT ".snap"     // snapshot is the startup file's path + this
+#define RC_SNAP_MAGIC "smallsh1"    // start of a snapshot (changes with its format)
+#define RC_SNAP_DIRS_MAX 255    // most PATH directories the command index covers
+
+/* command suggestions */
+#define SUGGEST_DIST 2          // most edits from a name that is suggested (1 if short)
+#define SUGGEST_NAME_MAX 64     // longest name suggested, or looked for
+
+/* command history */
+#define HISTORY_ENV "HISTSIZE"  // most commands kept in history
+#define HISTORY_SIZE 1000       // most commands kept if HISTSIZE isn't set
+#define HISTORY_SIZE_MAX 1000000 // largest HISTSIZE honoured
+#define HISTORY_POOL 1024       // initial bytes of the history's string pool
+#define HISTORY_DEAD 0xffffffffu // offset of a removed entry's slot
+
+/* output fan-out */
+#define FANOUT_MAX 16           // most output redirections of one command
+
+/* statistics */
+#define HIST_BUCKETS 32         // latency buckets (powers of two us)
+#define STATS_ENV "SMALLSH_STATS"   // file a json snapshot is added to at exit
+#define CMD_CACHE_SIZE 64       // initial buckets of the command cache
+
+/* aliases and functions */
+#define NAME_TABLE_SIZE 16      // initial buckets of the alias and function tables
+#define FUNC_DEPTH_MAX 100      // most function calls running at once
+
+/* arithmetic */
+#define ARITH_DEPTH_MAX 32      // most variables evaluated inside each other
+
+/* kinds of nodes of a parsed command line */
+#define NODE_LIST  0    // kids run in order, joined by their operators
+#define NODE_CMD   1    // simple command
+#define NODE_IF    2    // kids: condition, body, ... [, else body]
+#define NODE_WHILE 3    // kids: condition, body
+#define NODE_UNTIL 4    // kids: condition, body
+#define NODE_FOR   5    // kids: body, run for each of the words
+#define NODE_CASE  6    // kids: patterns, body, ... matched against a word
+#define NODE_PAT   7    // patterns of a case branch
+#define NODE_FUNC  8    // function definition, its body is the words
+
+/* "break" and "continue" on their way out of loops */
+#define LOOP_BREAK    1
+#define LOOP_CONTINUE 2
+
+/* operators joining the commands of a command line */
+#define OP_END 0    // last command of the line
+#define OP_SEQ 1    // ";"  run next command unconditionally
+#define OP_AND 2    // "&&" run next command if this one succeeded
+#define OP_OR  3    // "||" run next command if this one failed
+
+
+/*** structs ***/
+/* node of a parsed command line (see ast.c), words are referred to by
+ * their index in the array the line was parsed from */
+struct NODE {
+    int type;           // NODE_*
+    int op;             // operator after the node in a list (OP_*)
+    int start;          // first word (command, loop items, case word, patterns)
+    int len;            // number of words (-1: "for" without "in")
+    int name;           // word naming the loop variable or function (-1 if none)
+    int copy;           // words are expanded or changed when run (command)
+    struct NODE * kids; // first child
+    struct NODE * next; // next sibling
+};
+
+/* arithmetic evaluator state (see arith.c) */
+struct ARITH {
+    struct CL * cl;     // session the variables are in
+    char * s;           // rest of the expression
+    int skip;           // in a side not taken (no assignments or errors)
+    int depth;          // variables evaluated as expressions around this one
+    char * err;         // first error (NULL if none)
+};
+
+/* parser state (see ast.c) */
+struct PARSE {
+    char ** words;      // words being parsed
+    int num;            // number of words
+    int pos;            // next word
+    int depth;          // "{" open (a "}" ends a simple command in them)
+};
+
+/* bounded ring buffer holding the newest output of a job */
+struct RING {
+    char * data;        // storage (heap, or mmap of memfd once large)
+    size_t cap;         // size of data
+    size_t start;       // offset of oldest byte
+    size_t len;         // number of bytes held
+    size_t dropped;     // oldest bytes overwritten so far
+    int memfd;          // memfd backing data (-1 while on heap)
+};
+
+/* string hash table entry */
+struct HASH_ENT {
+    char * key;
+    void * val;
+    struct HASH_ENT * next;
+};
+
+/* string hash table */
+struct HASH {
+    struct HASH_ENT ** buckets;
+    int size;       // number of buckets
+    int len;        // number of entries
+};
+
+/* alias, the words its name is replaced with */
+struct ALIAS {
+    char * text;        // value as it was given
+    char ** words;      // value split into words (NULL terminated)
+    int num_words;
+};
+
+/* shell function, its body parsed and split when it is defined */
+struct FUNC {
+    char * text;        // body as it was given
+    char ** args;       // words of the body (NULL terminated)
+    int num_args;
+    struct NODE * body; // body parsed from args
+    int running;        // calls of it running now
+    int dropped;        // removed while running, freed once the calls end
+};
+
+/* latency histogram */
+struct HIST {
+    unsigned long count;
+    unsigned long total_us;
+    unsigned long bucket[HIST_BUCKETS];     // bucket b holds [2^(b-1), 2^b) us
+};
+
+/* counters of a session (see "stats") */
+struct STATS {
+    unsigned long builtins;         // built-in commands run
+    unsigned long externals;        // external commands launched
+    struct HIST parse;              // parsing and splitting a line
+    struct HIST launch;             // fork / zygote spawn in the shell
+    struct HIST run;                // whole line, including fg commands
+    unsigned long exec_us;          // time spent running lines
+    unsigned long prompt_us;        // time spent between lines
+    long last_us;                   // end of the last line (0 if none)
+    unsigned long jobs_started;
+    unsigned long jobs_reaped;
+    unsigned long cache_hits;       // command cache lookups
+    unsigned long cache_misses;
+    unsigned long zygote_launches;
+    unsigned long fork_launches;
+    unsigned long func_calls;       // shell functions called
+};
+
+/* deadline of a command run with a timeout (on the wheel while pprev
+ * is set) */
+struct DEADLINE {
+    int pid;                    // process (group) to signal
+    int pidfd;                  // pidfd of pid (-1 if none, not owned)
+    int stage;                  // 0 running, 1 sent SIGTERM, 2 sent SIGKILL
+    long rounds;                // turns of the wheel left before expiring
+    struct DEADLINE * next;     // next deadline in the same slot
+    struct DEADLINE ** pprev;   // pointer to this one in its slot's list
+};
+
+/* command run later ("at") or every so often ("every"), see sched.c */
+struct SCHED {
+    int id;                 // number shown by "sched"
+    long due_us;            // next run (monotonic, see _now_us)
+    long every_us;          // period (0 runs once)
+    int policy;             // SCHED_* when the last run is still going
+    char * cmd;             // command line, run as if followed by "&"
+    int pid;                // job of the last run (0 if none)
+    int queued;             // run waiting for the last one to finish (0 or 1)
+    unsigned long runs;     // runs started
+    unsigned long skipped;  // runs that didn't happen
+};
+
+/* task of a task file (see tasks.c) */
+struct TASK {
+    char * name;
+    char ** deps;           // tasks or files it depends on
+    int num_deps;
+    char ** lines;          // commands, run in order
+    int num_lines;
+    int state;              // TASK_*
+    int waiting;            // tasks it depends on that aren't done
+    int line;               // command running
+    int pid;                // job running it (0 if none)
+    long start_us;
+    long end_us;
+    long path_us;           // longest chain of work ending with it
+    int path_dep;           // task before it on that chain (-1 if none)
+};
+
+/* tasks of a task file being run */
+struct TASKS {
+    struct TASK * tasks;
+    int len;
+    int size;
+    struct HASH names;      // name to index + 1
+    int max;                // tasks run at once ("-j")
+    int running;
+    int ran;                // tasks started
+    int fresh;              // tasks up to date
+    int failed;             // tasks failed
+};
+
+/* background job */
+struct JOB {
+    int id;             // job number (%n)
+    int pid;            // process id
+    int done;           // process has been reaped
+    int stopped;        // process (group) is stopped
+    char * cmd;         // command line that started the job
+    struct RING * out;  // captured stdout/stderr (NULL if not captured)
+    int out_fd;         // read end of the capture pipe (-1 if closed)
+    struct DEADLINE * deadline; // timeout of the job (NULL if none)
+    int pidfd;          // readable once the process exits (-1 if none)
+    int ready;          // pidfd was readable, job is ready to be reaped
+    int status;         // wait status once done
+    int waited;         // "wait" is waiting for it, keep it once done
+    int helper;         // runs a process substitution, reaped quietly
+};
+
+/* fd watched for the caller (see watch_CL) */
+struct WATCH {
+    int fd;
+    watch_fn func;
+    void * data;
+};
+
+/* start of a startup snapshot (see rc.c), followed by the mtimes (ns) of
+ * the PATH directories, the records and the command index */
+struct SNAP_HEAD {
+    char magic[8];
+    int64_t rc_mtime;       // of the startup file (ns)
+    int64_t rc_size;
+    uint64_t path_hash;     // of $PATH before the startup file ran
+    uint64_t size;          // of the snapshot
+    uint32_t num_dirs;      // PATH directories (0 if there is no index)
+    uint32_t num_recs;      // records of what was defined
+    uint32_t num_cmds;      // commands in the index
+    uint32_t cmds_off;      // offset of the index's offsets
+};
+
+/* node of a BK-tree, kids are a list (see suggest.c) */
+struct BK_NODE {
+    uint32_t name;          // offset of the name in the pool
+    uint32_t kid;           // first kid (0 for none, the root is no kid)
+    uint32_t next;          // next kid of the same parent
+    uint32_t dist;          // distance to the parent
+};
+
+/* BK-tree of names, packed in a pool */
+struct BKTREE {
+    char * pool;
+    size_t pool_len;
+    size_t pool_size;
+    struct BK_NODE * nodes; // the first is the root
+    int len;
+    int size;
+    long long mtime;        // of the directory the names are from (ns)
+};
+
+/* directory in the jump index of "z" (see dirs.c) */
+struct ZDIR {
+    double rank;            // visits, aged
+    long time;              // of the last visit
+};
+
+/* directory matching "z"'s words */
+struct ZMATCH {
+    char * path;
+    double score;           // rank weighed by how recent
+};
+
+/* prompt segments found by the helper for a directory (see prompt.c) */
+struct PROMPT_DIR {
+    long long mtime;        // of the directory when they were found
+    long long git_mtime;    // of its repository's .git
+    char * git_dir;         // repository's .git ("" if none)
+    char * branch;          // branch checked out ("" if none)
+};
+
+/* line being edited at the prompt */
+struct LINE {
+    char * buf;     // contents of line (null terminated)
+    int size;       // size of buf
+    int len;        // length of line
+    int pos;        // cursor position in line
+    char seq[SEQ_MAX];  // escape sequence being read (after ESC)
+    int seq_len;    // length of seq (-1 when not in a sequence)
+    int paste;      // inside a bracketed paste
+    int hidden;     // line was cleared to print a message above it
+    int tty;        // drawn on a terminal (redrawn with escapes)
+    char * prompt;  // prompt shown before the line
+};
+
+/* session */
+struct CL {
+    // CL_* flags the session was created with
+    int flags;
+
+    // overall array of input
+    char * buffer;
+    int buffer_size;
+    
+    // array of space-delineated arguments
+    char ** args;
+    int num_args;
+    int args_size;          // size of args
+
+    // current directory (logical, links followed are kept in it)
+    char * pwd;
+    int pwd_size;
+    int pwd_len;
+
+    // directory stack of pushd, top last (the current one isn't in it)
+    char ** dirs;
+    int dirs_len;
+    int dirs_size;
+
+    // names suggested for commands not found, by PATH directory (struct
+    // BKTREE) and the built-ins, built on the first miss
+    struct HASH suggest_dirs;
+    struct BKTREE * suggest_builtins;
+    char * suggest;         // for the child about to fail to run a command
+
+    // startup snapshot, mapped while the session lasts (NULL if none)
+    char * snap;
+    size_t snap_size;
+    int snap_cmds;          // its command index is usable (-1 until checked)
+    int rc_pure;            // startup file only defined things so far
+
+    // jump index of "z", read on first use (path to struct ZDIR)
+    struct HASH z_dirs;
+    int z_loaded;
+    int z_lines;            // lines in the file, repeats and all
+    double z_total;         // ranks added up
+
+    // background processes
+    int job_size;
+    int job_len;
+    struct JOB * jobs;
+    int capture;            // capture bg output instead of /dev/null
+    int bg_block_mode;      // foreground-only mode ("&" is ignored)
+    int bg_quiet;           // bg commands keep the shell's output, no pid shown
+
+    // fg process status
+    int fg_status;
+    int fg_signaled;
+    int fg_exited;
+    int fg_ran;
+    int fg_timed_out;       // fg command was killed by its deadline
+
+    // is child process
+    int is_child;
+
+    // path contents
+    char ** path;
+    int path_len;
+
+    // zygote launcher (-1 if commands are forked)
+    int zyg_fd;             // socket to the zygote
+    int zyg_pid;
+
+    // helper copying the output of the last command to its targets
+    int fanout_pid;
+
+    // command deadlines
+    long timeout_ms;        // default timeout of commands (0 for none)
+    long next_timeout_ms;   // timeout of the next command (-1 for default)
+    struct DEADLINE * wheel[WHEEL_SLOTS];
+    int wheel_pos;          // slot of the last tick
+    int wheel_len;          // deadlines on the wheel
+    int wheel_fd;           // timerfd ticking every WHEEL_TICK_MS
+
+    // scheduled commands, a heap by when they are due
+    struct SCHED ** sched;
+    int sched_len;
+    int sched_size;
+    int sched_ids;          // last id given out
+    int sched_fd;           // timerfd for the earliest (-1 until needed)
+
+    // statistics
+    struct STATS stats;
+
+    // commands found on the path (name to full path)
+    struct HASH cmd_cache;
+
+    // aliases and functions (name to struct ALIAS / struct FUNC), and the
+    // positional parameters of the function being run ($0 is its name)
+    struct HASH aliases;
+    struct HASH funcs;
+    char ** params;
+    int num_params;
+    int func_depth;
+
+    // shell variables (name to value) and the loops being run
+    struct HASH vars;
+    int loop_depth;         // loops running (in the current function)
+    int loop_ctl;           // LOOP_* set by "break" / "continue"
+    int loop_levels;        // loops "break" / "continue" still has to leave
+    int expand_err;         // expanding the words of a command failed
+
+    // prompt, and the helper finding its slow segments
+    char * prompt_fmt;      // format ("prompt" built-in, see prompt.c)
+    char prompt_buf[PROMPT_MAX]; // last rendered prompt
+    int prompt_fd;          // socket to the helper (-1 until needed)
+    int prompt_pid;
+    int prompt_asked;       // question sent, no answer yet
+    struct HASH prompt_dirs; // segments by directory (struct PROMPT_DIR)
+    char prompt_load[16];   // load average
+    long prompt_load_us;    // when the load average was found
+
+    // history of commands, packed into a pool (oldest first) found through
+    // a ring of offsets, and a set of the sequence numbers + 1 (0 is
+    // empty) by string
+    char * hist_pool;
+    unsigned int hist_pool_size;
+    unsigned int hist_used;     // bytes of the pool in use, holes and all
+    unsigned int hist_dead;     // bytes of removed entries (holes)
+    unsigned int * hist_ring;
+    int hist_head;              // slot of the oldest
+    int hist_len;               // slots, dead ones (HISTORY_DEAD) included
+    int hist_cap;               // slots of the ring, twice hist_max
+    int hist_live;              // entries
+    int hist_max;               // HISTSIZE
+    unsigned int hist_base;     // sequence number of the oldest slot
+    unsigned int * hist_set;
+    int hist_set_size;          // power of two, at least twice hist_max
+    int curr_idx;
+
+    // event loop
+    int ev_fd;              // epoll instance
+    int sig_fd;             // signalfd for SIGCHLD, SIGINT and SIGTSTP
+    int timer_fd;           // timerfd for timed events
+    int in_always;          // stdin can't be polled (regular file)
+    int in_off;             // stdin is not watched (foreground child owns it)
+    int is_tty;             // stdin and stdout are a terminal
+    int term_fg;            // foreground jobs are given the terminal
+    struct termios tmodes;  // terminal modes restored after a fg job
+    sigset_t sig_mask;      // signals read through sig_fd
+    sigset_t old_mask;      // mask restored in children
+    int child_pending;      // SIGCHLD received since last pid check
+    int child_ready;        // jobs whose pidfd was readable since last check
+    int mode_changed;       // SIGTSTP toggled bg_block_mode
+    struct LINE * line;     // line being edited (NULL when not at prompt)
+    struct WATCH * watches; // caller's fds
+    int watch_len;
+    int watch_size;
+
+    // input read from stdin but not yet consumed
+    char in_pend[IN_PEND_SIZE];
+    int in_pend_len;
+    int in_pend_pos;
+};
+
+
+/*** interface prototypes ***/
+int setup_CL(struct CL*, int);          // setup CL struct (allocate)
+int free_CL(struct CL*);                // destroy CL struct (free)
+int clear_CL(struct CL*);               // clear CL struct to neutral state
+
+
+/*** hidden prototypes ***/
+int _run_line(struct CL*, char*);       // parse and execute a line
+int _parse_input(struct CL*, char*);    // parse a string into a command line struct
+int _parse_words(struct CL*, char*, int); // split line into args
+char * _split_ops(char*, int);          // copy of line with operators spaced out
+int _parse_arith(struct CL*, int);      // join words of "$(( ))" and "(( ))"
+int _parse_procsubs(struct CL*, int);   // join words of process substitutions
+int _parse_heredocs(struct CL*, int, char**); // take here-document bodies into args
+int _start_procsubs(struct CL*, int*);  // start process substitution helpers
+int _procsub_redirs(char**);            // open a helper's redirections
+char * _heredoc_delim(char*, int*);     // unquoted here-document delimiter
+int _heredoc_body(char**, char*, int, char**); // take lines up to delimiter
+int _heredoc_fd(char*);                 // sealed memfd holding text
+char * _expand_pid(char*);              // replace every $$ with the pid
+int _grow_args(struct CL*);             // grow args array
+int _execute_CL(struct CL*);            // execute command specified by CL_buffer
+int _process_special_args(struct CL*, int*, int*, int*, int*, int*, int*); // redirection / bg
+void _move_redirs(struct CL*);          // move redirections after the command's words
+void _exec_args(struct CL*, char*, char**, char**); // exec argv over the path (never returns)
+char * _find_cmd(struct CL*, char*);    // full path of command (cached, NULL if none)
+int _zygote_start(struct CL*);          // fork the zygote launcher
+int _zygote_stop(struct CL*);           // stop the zygote launcher
+void _zygote_main(struct CL*, int);     // zygote loop (never returns)
+int _zygote_spawn(struct CL*, char*, char**, int, int, int, int); // launch via zygote
+int _print(char*, FILE*);               // print string to file pointer passed
+int _grow_CL_pwd_buff(struct CL*);      // grow the size of the pwd buffer
+int _change_CL_pwd(struct CL*, char*);  // change the pwd member of CL to passed str
+int _set_curr_pwd(struct CL*);          // change pwd string to cwd
+int _get_path(struct CL*);              // fill the path member of the CL
+void _need_path(struct CL*);            // fill it if it wasn't yet
+void _path_changed(struct CL*);         // parse PATH again, forget found commands
+char * _builtin_name(int);              // name of built-in i (NULL past the end)
+struct JOB * _push_job(struct CL*, int, int, int); // add job to the list of bg processes
+int _remove_job(struct CL*, int);       // remove the job at the given index
+struct JOB * _find_job(struct CL*, char*); // find job by "%n" spec
+struct JOB * _resume_job(struct CL*, char*); // job for fg/bg ("%n" or newest)
+int _job_kill(int, int, int);           // signal job (group, pidfd or pid)
+int _job_stops(struct CL*);             // report jobs that stopped or continued
+int _job_drain(struct CL*, struct JOB*);   // read available captured output
+int _wait_fg(struct CL*, int, int, int*); // wait for fg child, servicing events
+int _foreground(struct CL*, int, int, struct DEADLINE**); // run pid in fg, record status
+void _child_setup(int, int, int);       // process group and signals of a child
+struct RING * _ring_new();              // allocate an empty capture buffer
+int _ring_write(struct RING*, char*, size_t); // append, evicting oldest bytes
+int _ring_print(struct RING*, int, FILE*);    // print last n lines (-1 for all)
+void _ring_free(struct RING*);          // free a capture buffer
+int _ev_input(struct CL*, int);         // start or stop watching stdin
+int _ev_setup(struct CL*);              // setup event loop fds and signal mask
+int _ev_wait(struct CL*, int);          // wait for events, returns EV_* mask
+int _ev_timer(struct CL*, int);         // arm timer_fd to expire in ms (0 disarms)
+int _ev_signals(struct CL*);            // handle signals pending on sig_fd
+int _wheel_setup(struct CL*);           // setup deadline wheel and its timerfd
+int _wheel_free(struct CL*);            // free deadline wheel
+int _wheel_link(struct CL*, struct DEADLINE*, long); // put deadline on wheel
+int _wheel_unlink(struct CL*, struct DEADLINE*);     // take deadline off wheel
+struct DEADLINE * _wheel_add(struct CL*, int, int, long); // start deadline for pid
+int _wheel_cancel(struct CL*, struct DEADLINE*);     // stop and free deadline
+int _wheel_tick(struct CL*);            // expire deadlines that are due
+long _parse_duration(char*);            // "30s", "5m" ... to ms (-1 if bad)
+int _sched_cmd(struct CL*, int, char**); // "at" / "every", schedule command
+long _sched_delay(char*);               // us until "HH:MM" or duration (-1 if bad)
+int _sched_launch(struct CL*, struct SCHED*); // run scheduled command as a job
+int _sched_running(struct CL*, struct SCHED*); // last run still going
+int _sched_arm(struct CL*);             // arm timer for earliest entry
+int _sched_push(struct CL*, struct SCHED*); // add entry to heap
+struct SCHED * _sched_remove(struct CL*, int); // take entry out of heap
+void _sched_up(struct CL*, int);        // sift entry up the heap
+void _sched_down(struct CL*, int);      // sift entry down the heap
+void _sched_free(struct SCHED*);        // free entry
+char * _sched_fmt(char*, long);         // short duration of us
+int _sched_cmp(const void*, const void*); // order entries by due time
+int _tasks_run(struct CL*, struct TASKS*); // run needed tasks, report
+int _tasks_load(struct TASKS*, char*);  // read task file
+void _tasks_free(struct TASKS*);        // free tasks
+int _tasks_find(struct TASKS*, char*);  // index of task (-1 if none)
+int _tasks_need(struct TASKS*, int);    // mark task and its deps needed
+int _tasks_fresh(struct TASKS*, struct TASK*); // task is up to date
+int _tasks_line(struct CL*, struct TASK*); // start next command of task
+void _tasks_end(struct TASKS*, int, int, long); // task is done with
+int _tasks_start(struct CL*, struct TASKS*); // start ready tasks
+int _tasks_reap(struct CL*, struct TASKS*); // go on with tasks whose job is done
+void _tasks_path(struct TASKS*, int);   // print critical path to task
+int _tasks_jobs();                      // default number of tasks at once
+int _dirs_cd(struct CL*, char*, int);   // change directory, set PWD/OLDPWD
+int _dirs_join(struct CL*, char*, char*, int, char*); // clean absolute path of dir
+void _dirs_clean(char*);                // take ".", ".." and "//" out of path
+int _dirs_init(struct CL*);             // first pwd, from $PWD if right
+void _dirs_print(struct CL*, int);      // print pwd and directory stack
+int _z_path(char*);                     // path of jump index
+int _z_load(struct CL*);                // read jump index (once)
+int _z_read(struct CL*);                // read jump index into table
+int _z_visit(struct CL*, char*);        // add visit of directory to index
+int _z_save(struct CL*);                // rewrite index, a line per path
+double _z_score(struct ZDIR*, long);    // rank weighed by how recent
+int _z_match(char*, char**, int);       // path has words in order
+int _z_cmp(const void*, const void*);   // order matches by score
+int _rc_path(char*);                    // path of startup file
+int _rc_run(struct CL*, char*);         // run lines of startup file
+int _rc_pure_cmd(struct CL*);           // command only defines things
+void _rc_env(struct HASH*);             // copy environment
+int _rc_save(struct CL*, char*, struct stat*, unsigned long, struct HASH*); // write snapshot
+void _rc_rec(FILE*, char, char*, char*); // write snapshot record
+int _rc_cmds(struct CL*, struct HASH*, struct HASH_ENT***); // commands in PATH, sorted
+int _rc_cmp(const void*, const void*);  // order commands by name
+int _rc_map(struct CL*, char*, struct stat*, unsigned long); // map and restore snapshot
+char * _rc_str(char**, char*);          // next string of snapshot
+int _rc_cmd(struct CL*, char*);         // PATH dir of command from index
+int _rc_dirs_same(struct CL*, int);     // PATH dirs unchanged since snapshot
+int _rc_check(char*, size_t);           // snapshot's parts lie inside it
+char * _suggest(struct CL*, char*);     // closest command name (NULL if none)
+struct BKTREE * _bk_new();              // empty BK-tree
+struct BKTREE * _bk_dir(char*);         // BK-tree of names in directory
+void _bk_add(struct BKTREE*, char*);    // add name to BK-tree
+void _bk_find(struct BKTREE*, char*, char**, int*); // closer name in BK-tree
+int _bk_dist(char*, char*, int);        // edit distance (swaps as one)
+void _bk_free(void*);                   // free BK-tree
+unsigned long _hash_str(char*);         // hash of a string
+int _hash_init(struct HASH*, int);      // setup empty hash table
+void _hash_free(struct HASH*, void (*)(void*)); // free hash table (and values)
+void * _hash_get(struct HASH*, char*);  // value for key (NULL if none)
+void * _hash_put(struct HASH*, char*, void*); // store value, returns old one
+void * _hash_del(struct HASH*, char*);  // remove key, returns its value
+int _hash_grow(struct HASH*);           // double buckets of hash table
+long _now_us();                         // monotonic time in us
+void _hist_add(struct HIST*, long);     // add latency sample to histogram
+long _hist_pct(struct HIST*, int);      // percentile of histogram (bucket bound)
+void _hist_print(char*, struct HIST*, FILE*); // print histogram as table line
+void _hist_json(char*, struct HIST*, FILE*);  // print histogram as json
+long _hist_bytes(struct CL*);           // bytes of history kept
+int _stats_print(struct CL*, FILE*);    // print statistics table
+int _stats_json(struct CL*, FILE*);     // print statistics as json
+int _stats_snapshot(struct CL*);        // append json to $SMALLSH_STATS
+int _fanout_start(struct CL*, int*, int); // helper copying to several fds
+int _fanout_copy(int, int*, int);       // copy pipe to fds with tee/splice
+void _fanout_move(int, int*, ssize_t);  // move bytes of pipe to fd
+void _fanout_close_others(int*, int);   // close all fds but the ones given
+void _fanout_wait(struct CL*);          // wait for the last fan-out helper
+int _expand_aliases(struct CL*);        // replace aliases with their words
+int _cmd_start(char*);                  // word before is followed by a command
+int _define_func(struct CL*, char*, char**, int); // store function
+void _drop_func(struct FUNC*);         // free function once no call runs it
+int _call_func(struct CL*, struct FUNC*, int, char**); // run function
+struct NODE * _ast_parse(char**, int);  // parse words into tree (NULL if error)
+struct NODE * _ast_new(int);            // allocate a node
+void _ast_free(struct NODE*);           // free a node, its kids and siblings
+struct NODE * _ast_list(struct PARSE*, char**); // parse commands up to an end word
+struct NODE * _ast_command(struct PARSE*); // parse one (compound) command
+struct NODE * _ast_if(struct PARSE*);   // parse if ... fi
+struct NODE * _ast_loop(struct PARSE*); // parse while / until ... done
+struct NODE * _ast_for(struct PARSE*);  // parse for ... done
+struct NODE * _ast_case(struct PARSE*); // parse case ... esac
+struct NODE * _ast_func(struct PARSE*); // parse function definition
+int _ast_expect(struct PARSE*, char*);  // take word, syntax error if not there
+int _ast_error(struct PARSE*);          // report syntax error at word
+int _ast_run(struct CL*, char**, struct NODE*); // run a node
+int _ast_cmd(struct CL*, char**, struct NODE*); // run a simple command
+int _ast_loop_end(struct CL*);          // handle break / continue in a loop
+int _ast_case_match(struct CL*, char*, char*); // word matches case patterns
+int _status_ok(struct CL*);             // last command succeeded
+int _status_code(struct CL*);           // exit value of last command ($?)
+void _set_status(struct CL*, int);      // set exit status (built-ins)
+int _var_name_len(char*);               // length of a variable name at start
+int _var_set(struct CL*, char*, char*); // set shell variable
+char * _var_get(struct CL*, char*);     // shell or environment variable
+int _assign_words(struct CL*, char**, int); // run "name=value ..." words
+char ** _expand_words(struct CL*, char**, int, int*); // expand $ in words
+char * _expand_word(struct CL*, char*); // expand $ in a word
+int _arith_eval(struct CL*, char*, int64_t*); // evaluate integer expression
+void _arith_space(struct ARITH*);       // skip spaces in expression
+int64_t _arith_expr(struct ARITH*);     // "," separated expressions
+int64_t _arith_assign(struct ARITH*);   // assignment expression
+int64_t _arith_cond(struct ARITH*);     // "?:" expression
+int64_t _arith_binary(struct ARITH*, int); // binary operators from precedence
+int64_t _arith_unary(struct ARITH*);    // unary operators
+int64_t _arith_primary(struct ARITH*);  // number, variable or parentheses
+int64_t _arith_apply(struct ARITH*, int, int64_t, int64_t); // binary operator
+int64_t _arith_var(struct ARITH*, char*, int); // value of a variable
+void _arith_store(struct ARITH*, char*, int, int64_t); // set a variable
+struct ALIAS * _new_alias(char*);       // alias of a value
+void _free_alias(void*);                // free an alias
+void _free_func(void*);                 // free a function
+struct FUNC * _new_func(char**, int);   // function with copied body, unparsed
+int _prompt_ask(struct CL*);            // ask helper for prompt segments
+int _prompt_reply(struct CL*);          // cache helper's answers
+int _prompt_start(struct CL*);          // fork prompt helper
+void _prompt_stop(struct CL*);          // stop prompt helper
+void _prompt_main(int);                 // prompt helper's loop
+void _prompt_git(char*, char*, int, char*, int); // git dir and branch of dir
+long long _prompt_mtime(char*);         // mtime of path in ns
+void _prompt_free_dir(void*);           // free cached prompt segments
+void _msg_begin(struct CL*);            // clear prompt for an async message
+int _add_to_hist(struct CL*, char*);    // add a command to the command history
+char * _history_get(struct CL*, int);   // history entry (0 is the oldest, NULL if removed)
+int _history_find(struct CL*, char*);   // set slot of command (-1 if none)
+void _history_set(struct CL*, int);     // add entry to set
+void _history_unset(struct CL*, int);   // take slot out of set
+void _history_remove(struct CL*, int, int); // take entry out of history
+void _history_compact(struct CL*);      // squeeze dead slots and holes out
+int _history_limit(struct CL*);         // size history for HISTSIZE
+void _history_free(struct CL*);         // free history
+
+
+/*** built-in prototypes ***/
+int _CL_exit(int, char**, struct CL*);  // exit command
+int _CL_cd(int, char**, struct CL*);    // cd command
+int _CL_status(int, char**, struct CL*); // status command
+int _CL_jobs(int, char**, struct CL*);  // jobs command
+int _CL_tail(int, char**, struct CL*);  // tail command (for "%n" args)
+int _CL_timeout(int, char**, struct CL*); // timeout command (session default)
+int _CL_fg(int, char**, struct CL*);    // fg command (resume job in fg)
+int _CL_bg(int, char**, struct CL*);    // bg command (resume job in bg)
+int _CL_wait(int, char**, struct CL*);  // wait command (wait for jobs)
+int _CL_stats(int, char**, struct CL*); // stats command (session statistics)
+int _CL_alias(int, char**, struct CL*); // alias command (define / show aliases)
+int _CL_unalias(int, char**, struct CL*); // unalias command (remove aliases)
+int _CL_functions(int, char**, struct CL*); // functions command (show functions)
+int _CL_unfunction(int, char**, struct CL*); // unfunction command (remove functions)
+int _CL_true(int, char**, struct CL*);  // true command
+int _CL_false(int, char**, struct CL*); // false command
+int _CL_test(int, char**, struct CL*);  // test and [ commands
+int _CL_break(int, char**, struct CL*); // break and continue commands
+int _CL_unset(int, char**, struct CL*); // unset command (remove variables)
+int _CL_let(int, char**, struct CL*);   // let command (arithmetic)
+int _CL_prompt(int, char**, struct CL*); // prompt command (set format)
+int _CL_sched(int, char**, struct CL*); // sched command (list / cancel scheduled)
+int _CL_tasks(int, char**, struct CL*); // tasks command (run task file)
+int _CL_pushd(int, char**, struct CL*); // pushd command (cd, stacking the old dir)
+int _CL_popd(int, char**, struct CL*);  // popd command (cd to top of stack)
+int _CL_dirs(int, char**, struct CL*);  // dirs command (print / clear stack)
+int _CL_z(int, char**, struct CL*);     // z command (jump to frecent dir)
+typedef int (*builtin_fn)(int, char**, struct CL*);
+builtin_fn _find_builtin(int, char**);  // look up built-in for argv (or NULL)
+
+#endif
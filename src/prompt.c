@@ -0,0 +1,347 @@
+/*
+ * library  -   libsmallsh (prompt)
+ * author   -   Nicholas Olson
+ *
+ * The prompt is rendered from a format ("prompt" built-in) whose
+ * segments are either known to the shell (directory, status, jobs) or
+ * may be slow to find (VCS branch, load average). Slow segments are never
+ * found on the way to the prompt: a helper process finds them, and the
+ * shell shows what it has cached until the answer arrives on the event
+ * loop, then redraws the prompt in place. Branches are cached by
+ * directory, valid while the directory and its repository's .git keep
+ * their mtimes, so showing the prompt costs two stat(2) calls at most.
+ *
+ *   %d  directory (~ for home)     %s  last exit value     %j  jobs
+ *   %b  VCS branch (helper)        %l  load average (helper)   %%  %
+ */
+
+/*** includes ***/
+#include <stdlib.h>     // std library stuff
+#include <stdio.h>      // I/O stuff
+#include <unistd.h>     // for fork and close
+#include <string.h>     // for strcmp, strdup
+#include <signal.h>     // for ignoring terminal signals
+#include <sys/stat.h>   // for directory mtimes
+#include <sys/socket.h> // for talking to the helper
+#include <sys/epoll.h>  // for watching the helper
+#include <sys/wait.h>   // for waitpid
+#include "libsmallsh.h" // private interface
+
+
+/*** structs ***/
+/* header of the helper's answer, followed by the directory, its
+ * repository's .git, the branch and the load average (NUL terminated) */
+struct PROMPT_REPLY {
+    long long mtime;        // of the directory when the branch was found
+    long long git_mtime;    // of the .git
+};
+
+
+/*** interface methods ***/
+/* render the session's prompt (never waits, segments the helper hasn't
+ * found yet are shown as last found, or empty)
+ * post-condition:  returned string is the session's, valid until the
+ *                  next call */
+char * prompt_CL(struct CL * cl)
+{
+    // declarations
+    struct PROMPT_DIR * dir = NULL;
+    char * fmt = cl->prompt_fmt;
+    char * out = cl->prompt_buf;
+    char * home = getenv("HOME");
+    char * val;
+    char num[16];
+    int stale = 0;
+    int len = 0;
+    int n;
+    int i;
+
+    for ( ; *fmt != '\0' && len < PROMPT_MAX - 1; fmt++)
+    {
+        if (fmt[0] != '%' || fmt[1] == '\0') { out[len++] = *fmt; continue; }
+        fmt++;
+
+        val = "";
+        switch (*fmt)
+        {
+        case 'd':
+            val = cl->pwd;
+            n = (home != NULL) ? strlen(home) : 0;
+            if (n > 1 && strncmp(val, home, n) == 0 && (val[n] == '/' || val[n] == '\0'))
+            {
+                out[len++] = '~';
+                val += n;
+            }
+            break;
+        case 's':
+            sprintf(num, "%d", _status_code(cl));
+            val = num;
+            break;
+        case 'j':
+            for (i = n = 0; i < cl->job_len; i++)
+            {
+                if (!cl->jobs[i].done && !cl->jobs[i].helper) { n++; }
+            }
+            sprintf(num, "%d", n);
+            val = num;
+            break;
+        case 'b':
+            // cached, and still valid if nothing it came from changed
+            if (dir == NULL) { dir = _hash_get(&cl->prompt_dirs, cl->pwd); }
+            if (dir == NULL) { stale = 1; break; }
+            if (_prompt_mtime(cl->pwd) != dir->mtime
+                || (dir->git_dir[0] != '\0' && _prompt_mtime(dir->git_dir) != dir->git_mtime))
+            {
+                stale = 1;
+            }
+            val = dir->branch;
+            break;
+        case 'l':
+            if (_now_us() - cl->prompt_load_us > PROMPT_LOAD_TTL_US) { stale = 1; }
+            val = cl->prompt_load;
+            break;
+        case '%':
+            val = "%";
+            break;
+        }
+
+        n = strlen(val);
+        if (len + n >= PROMPT_MAX) { n = PROMPT_MAX - 1 - len; }
+        memcpy(out + len, val, n);
+        len += n;
+    }
+    out[len] = '\0';
+
+    // fresher segments are found meanwhile
+    if (stale) { _prompt_ask(cl); }
+
+    return out;
+}
+
+
+/*** hidden methods ***/
+/* ask the helper (started if there is none) for the segments of the
+ * current directory, unless it is still busy with a question */
+int _prompt_ask(struct CL * cl)
+{
+    if (cl->prompt_asked) { return 0; }
+    if (cl->prompt_fd == -1 && _prompt_start(cl) != 0) { return -1; }
+
+    if (send(cl->prompt_fd, cl->pwd, strlen(cl->pwd) + 1, MSG_DONTWAIT) == -1) { return -1; }
+    cl->prompt_asked = 1;
+    return 0;
+}
+
+/* take the helper's answers into the cache (called from _ev_wait)
+ * post-condition:  returned 1 if the prompt shows something new */
+int _prompt_reply(struct CL * cl)
+{
+    // declarations
+    struct PROMPT_REPLY * rep;
+    struct PROMPT_DIR * dir;
+    char buff[PROMPT_MSG_MAX];
+    char * path;
+    char * git_dir;
+    char * branch;
+    char * load;
+    int changed = 0;
+    int n;
+
+    while ((n = recv(cl->prompt_fd, buff, sizeof(buff) - 1, MSG_DONTWAIT)) != -1)
+    {
+        // helper is gone, started again when needed
+        if (n == 0) { _prompt_stop(cl); break; }
+        cl->prompt_asked = 0;
+        if (n < (int) sizeof(struct PROMPT_REPLY)) { continue; }
+
+        // the strings after the header
+        buff[n] = '\0';
+        rep = (struct PROMPT_REPLY *) buff;
+        path = buff + sizeof(struct PROMPT_REPLY);
+        git_dir = path + strlen(path) + 1;
+        branch = (git_dir < buff + n) ? git_dir + strlen(git_dir) + 1 : git_dir;
+        load = (branch < buff + n) ? branch + strlen(branch) + 1 : branch;
+        if (load >= buff + n) { continue; }
+
+        // cached for its directory
+        if ((dir = _hash_get(&cl->prompt_dirs, path)) == NULL)
+        {
+            dir = calloc(1, sizeof(struct PROMPT_DIR));
+            _hash_put(&cl->prompt_dirs, path, dir);
+        }
+        if (strcmp((dir->branch != NULL) ? dir->branch : "", branch) != 0) { changed = 1; }
+        free(dir->git_dir);
+        free(dir->branch);
+        dir->mtime = rep->mtime;
+        dir->git_mtime = rep->git_mtime;
+        dir->git_dir = strdup(git_dir);
+        dir->branch = strdup(branch);
+
+        if (strcmp(cl->prompt_load, load) != 0) { changed = 1; }
+        snprintf(cl->prompt_load, sizeof(cl->prompt_load), "%s", load);
+        cl->prompt_load_us = _now_us();
+
+        // moved on meanwhile, ask about where the shell is now
+        if (strcmp(path, cl->pwd) != 0) { changed = 1; }
+    }
+
+    return changed;
+}
+
+/* fork the helper finding slow segments
+ * post-condition:  returned -1 if it couldn't be started */
+int _prompt_start(struct CL * cl)
+{
+    struct epoll_event ev = {0};
+    int sv[2];
+    int pid;
+
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) == -1) { return -1; }
+
+    fflush(stdout);
+    pid = fork();
+    if (pid == 0)
+    {
+        // holds nothing of the shell's (pipes of jobs above all)
+        signal(SIGINT, SIG_IGN);
+        signal(SIGTSTP, SIG_IGN);
+        _fanout_close_others(&sv[1], 1);
+        _prompt_main(sv[1]);
+    }
+    close(sv[1]);
+    if (pid == -1) { close(sv[0]); return -1; }
+
+    cl->prompt_fd = sv[0];
+    cl->prompt_pid = pid;
+    cl->prompt_asked = 0;
+
+    // answers arrive on the event loop
+    ev.events = EPOLLIN;
+    ev.data.u64 = EV_PROMPT;
+    epoll_ctl(cl->ev_fd, EPOLL_CTL_ADD, cl->prompt_fd, &ev);
+
+    return 0;
+}
+
+/* stop the helper (killed, it may be stuck on a slow file system) */
+void _prompt_stop(struct CL * cl)
+{
+    if (cl->prompt_fd == -1) { return; }
+
+    epoll_ctl(cl->ev_fd, EPOLL_CTL_DEL, cl->prompt_fd, NULL);
+    close(cl->prompt_fd);
+    kill(cl->prompt_pid, SIGKILL);
+    waitpid(cl->prompt_pid, NULL, 0);
+    cl->prompt_fd = -1;
+    cl->prompt_asked = 0;
+}
+
+/* helper: answer with the segments of every directory asked about, until
+ * the shell is gone */
+void _prompt_main(int sock)
+{
+    // declarations
+    struct PROMPT_REPLY * rep;
+    char path[PROMPT_MSG_MAX / 4];
+    char git_dir[PROMPT_MSG_MAX / 4];
+    char branch[256];
+    char buff[PROMPT_MSG_MAX];
+    double load[1];
+    int len;
+    int n;
+
+    rep = (struct PROMPT_REPLY *) buff;
+    while ((n = recv(sock, path, sizeof(path) - 1, 0)) > 0)
+    {
+        path[n] = '\0';
+
+        // mtimes first, so a change while reading is seen as one
+        rep->mtime = _prompt_mtime(path);
+        _prompt_git(path, git_dir, sizeof(git_dir), branch, sizeof(branch));
+        rep->git_mtime = (git_dir[0] != '\0') ? _prompt_mtime(git_dir) : 0;
+        if (getloadavg(load, 1) != 1) { load[0] = 0; }
+
+        len = sizeof(struct PROMPT_REPLY);
+        len += snprintf(buff + len, sizeof(buff) - len, "%s", path) + 1;
+        len += snprintf(buff + len, sizeof(buff) - len, "%s", git_dir) + 1;
+        len += snprintf(buff + len, sizeof(buff) - len, "%s", branch) + 1;
+        len += snprintf(buff + len, sizeof(buff) - len, "%.2f", load[0]) + 1;
+        if (send(sock, buff, len, 0) == -1) { break; }
+    }
+
+    _exit(0);
+}
+
+/* find the git repository path is in and the branch checked out there
+ * (the first 7 chars of the commit if detached), both "" if none */
+void _prompt_git(char * path, char * git_dir, int git_size, char * branch, int size)
+{
+    // declarations
+    struct stat st;
+    char head[512];
+    char * slash;
+    FILE * f;
+    int n;
+
+    git_dir[0] = '\0';
+    branch[0] = '\0';
+
+    // nearest ".git" up from path (a file in worktrees and submodules)
+    snprintf(git_dir, git_size, "%s", path);
+    while (1)
+    {
+        n = strlen(git_dir);
+        snprintf(git_dir + n, git_size - n, "%s.git", (n > 0 && git_dir[n-1] == '/') ? "" : "/");
+        if (stat(git_dir, &st) == 0) { break; }
+
+        git_dir[n] = '\0';
+        if ((slash = strrchr(git_dir, '/')) == NULL || n <= 1) { git_dir[0] = '\0'; return; }
+        slash[(slash == git_dir) ? 1 : 0] = '\0';
+    }
+
+    if (S_ISREG(st.st_mode) && (f = fopen(git_dir, "r")) != NULL)
+    {
+        if (fgets(head, sizeof(head), f) != NULL && strncmp(head, "gitdir: ", 8) == 0)
+        {
+            head[strcspn(head, "\n")] = '\0';
+            if (head[8] == '/') { snprintf(git_dir, git_size, "%s", head + 8); }
+            else
+            {
+                n = strlen(git_dir) - strlen(".git");
+                snprintf(git_dir + n, git_size - n, "%s", head + 8);
+            }
+        }
+        fclose(f);
+    }
+
+    // "ref: refs/heads/name", or a commit
+    snprintf(head, sizeof(head), "%s/HEAD", git_dir);
+    if ((f = fopen(head, "r")) == NULL) { return; }
+    if (fgets(head, sizeof(head), f) != NULL)
+    {
+        head[strcspn(head, "\n")] = '\0';
+        if (strncmp(head, "ref: refs/heads/", 16) == 0) { snprintf(branch, size, "%s", head + 16); }
+        else if (strncmp(head, "ref: ", 5) == 0)        { snprintf(branch, size, "%s", head + 5); }
+        else                                            { snprintf(branch, size, "%.7s", head); }
+    }
+    fclose(f);
+}
+
+/* mtime of path in ns (0 if it can't be found) */
+long long _prompt_mtime(char * path)
+{
+    struct stat st;
+
+    if (stat(path, &st) == -1) { return 0; }
+    return st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+}
+
+/* free a cached directory */
+void _prompt_free_dir(void * ptr)
+{
+    struct PROMPT_DIR * dir = ptr;
+
+    free(dir->git_dir);
+    free(dir->branch);
+    free(dir);
+}
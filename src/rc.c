@@ -0,0 +1,534 @@
+/*
+ * library  -   libsmallsh (startup file)
+ * author   -   Nicholas Olson
+ *
+ * ~/.smallshrc (or $SMALLSH_RC) is run when a session starts. If all it
+ * did was define things (aliases, functions, variables, the prompt), what
+ * it left behind is written next to it as a snapshot, along with an index
+ * of the commands in PATH, and later sessions map the snapshot instead of
+ * running the file. A snapshot is used while the file's mtime and size
+ * and $PATH are what they were when it was written.
+ *
+ * The command index names the PATH directory of every command, and is
+ * only trusted while the directories have their old mtimes (checked the
+ * first time a command isn't in the command cache); a command missing
+ * from it is then known not to exist without searching PATH. Function
+ * bodies from a snapshot are parsed on their first call.
+ */
+
+/*** includes ***/
+#include <stdlib.h>     // std library stuff
+#include <stdio.h>      // I/O stuff
+#include <unistd.h>     // for access, close
+#include <string.h>     // for strcmp, strlen, memcpy
+#include <limits.h>     // for PATH_MAX
+#include <fcntl.h>      // for open
+#include <dirent.h>     // for reading PATH directories
+#include <sys/stat.h>   // for stat
+#include <sys/mman.h>   // for mapping the snapshot
+#include "libsmallsh.h" // private interface
+
+extern char ** environ;
+
+
+/*** interface methods ***/
+/* run the startup file, or restore the snapshot of what it did
+ * post-condition:  returned -1 if it ran "exit", 0 otherwise */
+int rc_CL(struct CL * cl)
+{
+    // declarations
+    char rc[PATH_MAX];
+    char snap[PATH_MAX + 8];
+    char * path = getenv("PATH");
+    unsigned long path_hash = _hash_str(path != NULL ? path : "");
+    struct stat st;
+    struct HASH env;
+    int result;
+
+    if (_rc_path(rc) == -1 || stat(rc, &st) == -1) { return 0; }
+    snprintf(snap, sizeof(snap), "%s%s", rc, RC_SNAP_EXT);
+    if (_rc_map(cl, snap, &st, path_hash) == 0) { return 0; }
+
+    // run it, with the environment it starts with kept to compare
+    _rc_env(&env);
+    cl->rc_pure = 1;
+    result = _rc_run(cl, rc);
+    if (cl->rc_pure && result != -1) { _rc_save(cl, snap, &st, path_hash, &env); }
+    else                             { unlink(snap); }
+    cl->rc_pure = 0;
+    _hash_free(&env, free);
+
+    return result;
+}
+
+
+/*** hidden methods ***/
+/* path of the startup file into path (PATH_MAX bytes)
+ * post-condition:  returned 0, -1 if there is none ($SMALLSH_RC empty) */
+int _rc_path(char * path)
+{
+    char * file = getenv(RC_ENV);
+    char * home = getenv("HOME");
+
+    if (file != NULL)      { if (file[0] == '\0') { return -1; }
+                             snprintf(path, PATH_MAX, "%s", file); }
+    else if (home != NULL) { snprintf(path, PATH_MAX, "%s/%s", home, RC_FILE); }
+    else                   { return -1; }
+    return 0;
+}
+
+/* run the lines of file (a block or here-document takes the lines it
+ * needs, as at the prompt)
+ * post-condition:  returned -1 if it ran "exit", 0 otherwise */
+int _rc_run(struct CL * cl, char * file)
+{
+    // declarations
+    FILE * in = fopen(file, "r");
+    char * line = NULL;
+    char * text = NULL;
+    size_t size = 0;
+    size_t text_len = 0;
+    size_t text_size = 0;
+    ssize_t n;
+    int result = 0;
+
+    if (in == NULL) { return 0; }
+
+    while (result != -1 && (n = getline(&line, &size, in)) != -1)
+    {
+        if (n > 0 && line[n - 1] == '\n') { line[--n] = '\0'; }
+
+        // add the line to the text of the command
+        if (text_len + n + 2 > text_size)
+        {
+            text_size = 2 * (text_len + n + 2);
+            text = realloc(text, text_size);
+        }
+        if (text_len > 0) { text[text_len++] = '\n'; }
+        memcpy(text + text_len, line, n + 1);
+        text_len += n;
+
+        if (pending_CL(cl, text) > 0) { continue; }
+        if (run_CL(cl, text) == -1) { result = -1; }
+        text_len = 0;
+    }
+
+    // a block the file didn't finish
+    if (result != -1 && text_len > 0 && run_CL(cl, text) == -1) { result = -1; }
+
+    free(line);
+    free(text);
+    fclose(in);
+    return result;
+}
+
+/* command about to run can be left out of a snapshot, it only defines
+ * things and has no redirections */
+int _rc_pure_cmd(struct CL * cl)
+{
+    static char * pure[] = { "alias", "unalias", "unset", "let", "prompt",
+                             "true", "false", "test", "[", NULL };
+    int i;
+
+    for (i = 1; i < cl->num_args; i++)
+    {
+        if (cl->args[i][0] == '<' || cl->args[i][0] == '>' || strcmp(cl->args[i], "&") == 0)
+        {
+            return 0;
+        }
+    }
+    for (i = 0; pure[i] != NULL; i++)
+    {
+        if (strcmp(cl->args[0], pure[i]) == 0) { return 1; }
+    }
+    return 0;
+}
+
+/* copy the environment into env (name to value) */
+void _rc_env(struct HASH * env)
+{
+    char * eq;
+    char * name;
+    int i;
+
+    _hash_init(env, NAME_TABLE_SIZE);
+    for (i = 0; environ[i] != NULL; i++)
+    {
+        if ((eq = strchr(environ[i], '=')) == NULL) { continue; }
+        name = strndup(environ[i], eq - environ[i]);
+        free(_hash_put(env, name, strdup(eq + 1)));
+        free(name);
+    }
+}
+
+/* write what the startup file left (and the command index) to snap,
+ * env is the environment from before it ran */
+int _rc_save(struct CL * cl, char * snap, struct stat * st, unsigned long path_hash,
+             struct HASH * env)
+{
+    // declarations
+    struct SNAP_HEAD head = {0};
+    struct HASH_ENT * ent;
+    struct HASH_ENT ** cmds = NULL;
+    struct HASH seen;
+    struct FUNC * func;
+    struct stat dir;
+    char tmp[PATH_MAX + 16];
+    char count[16];
+    char * buf = NULL;
+    size_t len = 0;
+    uint32_t off;
+    int64_t mtime;
+    FILE * out;
+    char * eq;
+    char * val;
+    int fd;
+    int n = 0;
+    int i, j;
+
+    memcpy(head.magic, RC_SNAP_MAGIC, sizeof(head.magic));
+    head.rc_mtime = st->st_mtim.tv_sec * 1000000000LL + st->st_mtim.tv_nsec;
+    head.rc_size = st->st_size;
+    head.path_hash = path_hash;
+
+    out = open_memstream(&buf, &len);
+    fwrite(&head, sizeof(head), 1, out);
+
+    // mtimes of the PATH directories the index comes from
+    _need_path(cl);
+    head.num_dirs = (cl->path_len <= RC_SNAP_DIRS_MAX) ? cl->path_len : 0;
+    for (i = 0; i < (int) head.num_dirs; i++)
+    {
+        mtime = (stat(cl->path[i], &dir) == 0)
+              ? dir.st_mtim.tv_sec * 1000000000LL + dir.st_mtim.tv_nsec : -1;
+        fwrite(&mtime, sizeof(mtime), 1, out);
+    }
+
+    // what was defined, a type then its strings
+    for (i = 0; i < cl->aliases.size; i++)
+    {
+        for (ent = cl->aliases.buckets[i]; ent != NULL; ent = ent->next, head.num_recs++)
+        {
+            _rc_rec(out, 'a', ent->key, ((struct ALIAS*) ent->val)->text);
+        }
+    }
+    for (i = 0; i < cl->vars.size; i++)
+    {
+        for (ent = cl->vars.buckets[i]; ent != NULL; ent = ent->next, head.num_recs++)
+        {
+            _rc_rec(out, 'v', ent->key, ent->val);
+        }
+    }
+    for (i = 0; i < cl->funcs.size; i++)
+    {
+        for (ent = cl->funcs.buckets[i]; ent != NULL; ent = ent->next, head.num_recs++)
+        {
+            func = ent->val;
+            sprintf(count, "%d", func->num_args);
+            _rc_rec(out, 'f', ent->key, count);
+            for (j = 0; j < func->num_args; j++) { fwrite(func->args[j], strlen(func->args[j]) + 1, 1, out); }
+        }
+    }
+    if (strcmp(cl->prompt_fmt, PROMPT_DEFAULT) != 0)
+    {
+        _rc_rec(out, 'p', cl->prompt_fmt, NULL);
+        head.num_recs++;
+    }
+
+    // environment it changed
+    for (i = 0; environ[i] != NULL; i++)
+    {
+        if ((eq = strchr(environ[i], '=')) == NULL) { continue; }
+        *eq = '\0';
+        if ((val = _hash_get(env, environ[i])) == NULL || strcmp(val, eq + 1) != 0)
+        {
+            _rc_rec(out, 'e', environ[i], eq + 1);
+            head.num_recs++;
+        }
+        *eq = '=';
+    }
+    for (i = 0; i < env->size; i++)
+    {
+        for (ent = env->buckets[i]; ent != NULL; ent = ent->next)
+        {
+            if (getenv(ent->key) == NULL) { _rc_rec(out, 'u', ent->key, NULL); head.num_recs++; }
+        }
+    }
+
+    // command index: offsets of its entries (sorted by name), then the
+    // entries, a name and the number of its directory
+    _hash_init(&seen, CMD_CACHE_SIZE);
+    if (head.num_dirs > 0) { n = _rc_cmds(cl, &seen, &cmds); }
+    while (ftell(out) % sizeof(uint32_t) != 0) { fputc('\0', out); }
+    head.cmds_off = ftell(out);
+    head.num_cmds = n;
+    off = head.cmds_off + n * sizeof(uint32_t);
+    for (i = 0; i < n; i++)
+    {
+        fwrite(&off, sizeof(off), 1, out);
+        off += strlen(cmds[i]->key) + 2;
+    }
+    for (i = 0; i < n; i++)
+    {
+        fwrite(cmds[i]->key, strlen(cmds[i]->key) + 1, 1, out);
+        fputc((int) (long) cmds[i]->val - 1, out);
+    }
+    free(cmds);
+    _hash_free(&seen, NULL);
+
+    fclose(out);
+    head.size = len;
+    memcpy(buf, &head, sizeof(head));
+
+    // replaced whole, sessions starting now map the old one or the new one
+    snprintf(tmp, sizeof(tmp), "%s.%d", snap, (int) getpid());
+    if ((fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600)) == -1) { free(buf); return -1; }
+    if (write(fd, buf, len) != (ssize_t) len || close(fd) == -1 || rename(tmp, snap) == -1)
+    {
+        unlink(tmp);
+        free(buf);
+        return -1;
+    }
+
+    free(buf);
+    return 0;
+}
+
+/* write a record of a snapshot, type and one or two strings */
+void _rc_rec(FILE * out, char type, char * a, char * b)
+{
+    fputc(type, out);
+    fwrite(a, strlen(a) + 1, 1, out);
+    if (b != NULL) { fwrite(b, strlen(b) + 1, 1, out); }
+}
+
+/* the commands in PATH put in seen (with the number + 1 of the first
+ * directory they are found in), and its entries sorted by name into *cmds
+ * post-condition:  returned number of commands, *cmds is the caller's */
+int _rc_cmds(struct CL * cl, struct HASH * seen, struct HASH_ENT *** cmds)
+{
+    // declarations
+    char file[PATH_MAX];
+    struct HASH_ENT * ent;
+    struct dirent * de;
+    struct stat st;
+    DIR * dir;
+    int n = 0;
+    int i;
+
+    for (i = 0; i < cl->path_len; i++)
+    {
+        if ((dir = opendir(cl->path[i])) == NULL) { continue; }
+        while ((de = readdir(dir)) != NULL)
+        {
+            if (de->d_name[0] == '.' || _hash_get(seen, de->d_name) != NULL) { continue; }
+            snprintf(file, sizeof(file), "%s/%s", cl->path[i], de->d_name);
+            if (access(file, X_OK) != 0 || stat(file, &st) != 0 || S_ISDIR(st.st_mode)) { continue; }
+            _hash_put(seen, de->d_name, (void*) (long) (i + 1));
+        }
+        closedir(dir);
+    }
+
+    *cmds = malloc((seen->len + 1) * sizeof(struct HASH_ENT*));
+    for (i = 0; i < seen->size; i++)
+    {
+        for (ent = seen->buckets[i]; ent != NULL; ent = ent->next)
+        {
+            (*cmds)[n++] = ent;
+        }
+    }
+    qsort(*cmds, n, sizeof(struct HASH_ENT*), _rc_cmp);
+
+    return n;
+}
+
+/* order of entries by name (for qsort) */
+int _rc_cmp(const void * a, const void * b)
+{
+    return strcmp((*(struct HASH_ENT **) a)->key, (*(struct HASH_ENT **) b)->key);
+}
+
+/* map snap and restore what it holds, if it is of the startup file as it
+ * is (st) and of the PATH the session started with
+ * post-condition:  returned 0 if it was used, -1 if not */
+int _rc_map(struct CL * cl, char * snap, struct stat * st, unsigned long path_hash)
+{
+    // declarations
+    struct SNAP_HEAD * head;
+    struct stat sst;
+    char * map;
+    char * end;
+    char * p;
+    char * a;
+    char * b;
+    char ** words;
+    int type;
+    int n;
+    int fd;
+    uint32_t i;
+    int j;
+
+    if ((fd = open(snap, O_RDONLY | O_CLOEXEC)) == -1) { return -1; }
+    if (fstat(fd, &sst) == -1 || sst.st_size < (off_t) sizeof(struct SNAP_HEAD) ||
+        (map = mmap(NULL, sst.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED)
+    {
+        close(fd);
+        return -1;
+    }
+    close(fd);
+
+    head = (struct SNAP_HEAD*) map;
+    if (memcmp(head->magic, RC_SNAP_MAGIC, sizeof(head->magic)) != 0 ||
+        head->size != (uint64_t) sst.st_size || head->path_hash != path_hash ||
+        head->rc_mtime != st->st_mtim.tv_sec * 1000000000LL + st->st_mtim.tv_nsec ||
+        head->rc_size != st->st_size || _rc_check(map, sst.st_size) == -1)
+    {
+        munmap(map, sst.st_size);
+        return -1;
+    }
+
+    // records, after the directory mtimes
+    p = map + sizeof(struct SNAP_HEAD) + head->num_dirs * sizeof(int64_t);
+    end = map + head->cmds_off;
+    for (i = 0; i < head->num_recs && p < end; i++)
+    {
+        type = *p++;
+        a = _rc_str(&p, end);
+        b = (type != 'p' && type != 'u') ? _rc_str(&p, end) : "";
+        if (a == NULL || b == NULL) { break; }
+
+        if (type == 'a')      { _free_alias(_hash_put(&cl->aliases, a, _new_alias(b))); }
+        else if (type == 'v') { free(_hash_put(&cl->vars, a, strdup(b))); }
+        else if (type == 'e') { setenv(a, b, 1); }
+        else if (type == 'u') { unsetenv(a); }
+        else if (type == 'p') { free(cl->prompt_fmt); cl->prompt_fmt = strdup(a); }
+        else if (type == 'f')
+        {
+            n = atoi(b);
+            words = malloc((n + 1) * sizeof(char*));
+            for (j = 0; j < n && (words[j] = _rc_str(&p, end)) != NULL; j++) { }
+            if (j == n) { _drop_func(_hash_put(&cl->funcs, a, _new_func(words, n))); }
+            free(words);
+            if (j != n) { break; }
+        }
+    }
+
+    cl->snap = map;
+    cl->snap_size = sst.st_size;
+    cl->snap_cmds = -1;
+    return 0;
+}
+
+/* check that what the header of the snapshot at map (of size bytes)
+ * says is where it is lies inside it, so nothing read from it later
+ * (directory mtimes, the index and its entries) is past the end
+ * post-condition:  returned -1 if it is cut short or corrupt */
+int _rc_check(char * map, size_t size)
+{
+    struct SNAP_HEAD * head = (struct SNAP_HEAD*) map;
+    uint32_t * offs;
+    uint64_t start;
+    char * nul;
+    uint32_t i;
+
+    if (head->num_dirs > RC_SNAP_DIRS_MAX || head->cmds_off % sizeof(uint32_t) != 0) { return -1; }
+
+    // directory mtimes, then the records, then the index
+    start = sizeof(struct SNAP_HEAD) + head->num_dirs * sizeof(int64_t);
+    if (head->cmds_off < start || head->cmds_off > size ||
+        head->num_cmds > (size - head->cmds_off) / sizeof(uint32_t))
+    {
+        return -1;
+    }
+
+    // every entry is a name and its directory, after the offsets
+    offs = (uint32_t*) (map + head->cmds_off);
+    start = head->cmds_off + (uint64_t) head->num_cmds * sizeof(uint32_t);
+    for (i = 0; i < head->num_cmds; i++)
+    {
+        if (offs[i] < start || offs[i] >= size) { return -1; }
+        nul = memchr(map + offs[i], '\0', size - offs[i]);
+        if (nul == NULL || nul + 1 >= map + size) { return -1; }
+    }
+
+    return 0;
+}
+
+/* string at *p (before end), *p moves past it
+ * post-condition:  returned NULL if it doesn't end before end */
+char * _rc_str(char ** p, char * end)
+{
+    char * str = *p;
+    char * nul = memchr(str, '\0', end - str);
+
+    if (nul == NULL) { return NULL; }
+    *p = nul + 1;
+    return str;
+}
+
+/* directory of name from the snapshot's command index, as long as the
+ * PATH directories it could be in (or was missing from) are unchanged
+ * post-condition:  returned its index in cl->path, -1 if it isn't a
+ *                  command, -2 if the index can't say (none, or stale) */
+int _rc_cmd(struct CL * cl, char * name)
+{
+    // declarations
+    struct SNAP_HEAD * head = (struct SNAP_HEAD*) cl->snap;
+    uint32_t * offs;
+    char * entry;
+    int lo, hi, mid;
+    int cmp;
+    int dir;
+
+    if (cl->snap == NULL) { return -2; }
+
+    // same directories as when it was written
+    if (cl->snap_cmds == -1)
+    {
+        cl->snap_cmds = (head->num_dirs > 0 && (int) head->num_dirs == cl->path_len);
+    }
+    if (!cl->snap_cmds) { return -2; }
+
+    // binary search of the sorted names
+    offs = (uint32_t*) (cl->snap + head->cmds_off);
+    lo = 0;
+    hi = head->num_cmds - 1;
+    dir = -1;
+    while (lo <= hi && dir == -1)
+    {
+        mid = (lo + hi) / 2;
+        entry = cl->snap + offs[mid];
+        if ((cmp = strcmp(name, entry)) == 0) { dir = (unsigned char) entry[strlen(entry) + 1]; }
+        else if (cmp < 0)                     { hi = mid - 1; }
+        else                                  { lo = mid + 1; }
+    }
+
+    if (dir >= cl->path_len) { cl->snap_cmds = 0; return -2; }
+
+    // a directory before its own (or any, if there is none) may have
+    // gained it since, then the index is done with
+    if (!_rc_dirs_same(cl, (dir == -1) ? cl->path_len : dir))
+    {
+        cl->snap_cmds = 0;
+        return -2;
+    }
+    return dir;
+}
+
+/* the first n PATH directories have the mtimes the snapshot has for them
+ * pre-condition:   n is at most the snapshot's number of directories */
+int _rc_dirs_same(struct CL * cl, int n)
+{
+    int64_t * mtimes = (int64_t*) (cl->snap + sizeof(struct SNAP_HEAD));
+    struct stat st;
+    int64_t mtime;
+    int i;
+
+    for (i = 0; i < n; i++)
+    {
+        mtime = (stat(cl->path[i], &st) == 0)
+              ? st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec : -1;
+        if (mtime != mtimes[i]) { return 0; }
+    }
+    return 1;
+}
@@ -0,0 +1,370 @@
+/*
+ * library  -   libsmallsh (scheduled commands)
+ * author   -   Nicholas Olson
+ *
+ * Commands run later ("at") or every so often ("every"), kept in a heap
+ * ordered by when they are due. A single timerfd is armed for the
+ * earliest, so nothing runs or wakes up between runs however many are
+ * scheduled. Due commands are started from the prompt's event loop,
+ * between lines, as background jobs (as if typed with "&"); one that
+ * comes due while a command runs in the foreground starts once it is done.
+ *
+ * A periodic command still running when it comes due again is skipped
+ * ("every -s", the default), run once it is done ("every -q", one run
+ * waits at most, so a slow command doesn't pile up a backlog) or run
+ * alongside it ("every -p").
+ */
+
+/*** includes ***/
+#include <stdlib.h>     // std library stuff
+#include <stdio.h>      // I/O stuff
+#include <unistd.h>     // for read and close
+#include <string.h>     // for strcmp, strlen
+#include <time.h>       // for clock times of "at"
+#include <stdint.h>     // for fixed size ints
+#include <sys/epoll.h>  // for the event loop
+#include <sys/timerfd.h>  // for the heap's timer
+#include "libsmallsh.h" // private interface
+
+
+/*** interface methods ***/
+/* start the scheduled commands that are due, and the queued runs of those
+ * whose last run is done (between lines only, they run through the
+ * session's command line)
+ * post-condition:  returned number of commands started */
+int sched_CL(struct CL * cl)
+{
+    // declarations
+    struct SCHED * s;
+    long now = _now_us();
+    long missed;
+    int started = 0;
+    int i;
+
+    // queued runs that can go now
+    for (i = 0; i < cl->sched_len; i++)
+    {
+        s = cl->sched[i];
+        if (s->queued > 0 && !_sched_running(cl, s))
+        {
+            s->queued--;
+            started += _sched_launch(cl, s);
+        }
+    }
+
+    // due ones, earliest first
+    while (cl->sched_len > 0 && cl->sched[0]->due_us <= now)
+    {
+        s = cl->sched[0];
+        if (s->policy != SCHED_PARALLEL && _sched_running(cl, s))
+        {
+            if (s->policy == SCHED_QUEUE && s->queued == 0) { s->queued++; }
+            else                                            { s->skipped++; }
+        }
+        else { started += _sched_launch(cl, s); }
+
+        // "at" is done with
+        if (s->every_us == 0)
+        {
+            _sched_free(_sched_remove(cl, 0));
+            continue;
+        }
+
+        // next period, periods that went by (e.g. behind a long foreground
+        // command) are skipped rather than run back to back
+        s->due_us += s->every_us;
+        if (s->due_us <= now)
+        {
+            missed = (now - s->due_us) / s->every_us + 1;
+            s->due_us += missed * s->every_us;
+            s->skipped += missed;
+        }
+        _sched_down(cl, 0);
+    }
+
+    _sched_arm(cl);
+    return started;
+}
+
+
+/*** hidden methods ***/
+/* schedule a command, "at TIME cmd ..." or "every [-s|-q|-p] INTERVAL
+ * cmd ..." (the words of cl that follow, redirections and all)
+ * post-condition:  returned 0, status is set */
+int _sched_cmd(struct CL * cl, int argc, char ** argv)
+{
+    // declarations
+    struct SCHED * s;
+    int every = (strcmp(argv[0], "every") == 0);
+    int policy = SCHED_SKIP;
+    long delay;
+    int len = 1;
+    int first;
+    int i = 1;
+
+    // overlap policy
+    if (every && i < argc && argv[i][0] == '-')
+    {
+        if      (strcmp(argv[i], "-s") == 0) { policy = SCHED_SKIP; }
+        else if (strcmp(argv[i], "-q") == 0) { policy = SCHED_QUEUE; }
+        else if (strcmp(argv[i], "-p") == 0) { policy = SCHED_PARALLEL; }
+        else    { i = argc; }
+        i++;
+    }
+
+    // a trailing "&" is implied
+    if (argc > 0 && strcmp(argv[argc - 1], "&") == 0) { argc--; }
+    if (i + 1 >= argc)
+    {
+        fprintf(stderr, every ? "smallsh: usage: every [-s|-q|-p] INTERVAL command ...\n"
+                              : "smallsh: usage: at HH:MM[:SS]|[+]DURATION command ...\n");
+        fflush(stderr);
+        _set_status(cl, 1);
+        return 0;
+    }
+
+    // when
+    if (every) { delay = _parse_duration(argv[i]); delay = (delay > 0) ? delay * 1000 : -1; }
+    else       { delay = _sched_delay(argv[i]); }
+    if (delay == -1)
+    {
+        fprintf(stderr, "smallsh: %s: %s: invalid %s\n", argv[0], argv[i],
+                        every ? "interval" : "time");
+        fflush(stderr);
+        _set_status(cl, 1);
+        return 0;
+    }
+
+    // the command, as a line
+    s = malloc(sizeof(struct SCHED));
+    s->id = ++cl->sched_ids;
+    s->due_us = _now_us() + delay;
+    s->every_us = every ? delay : 0;
+    s->policy = policy;
+    s->pid = 0;
+    s->queued = 0;
+    s->runs = 0;
+    s->skipped = 0;
+    for (first = ++i; i < argc; i++) { len += strlen(argv[i]) + 1; }
+    s->cmd = malloc(len);
+    s->cmd[0] = '\0';
+    for (i = first; i < argc; i++)
+    {
+        if (i != first) { strcat(s->cmd, " "); }
+        strcat(s->cmd, argv[i]);
+    }
+
+    _sched_push(cl, s);
+    _sched_arm(cl);
+
+    fflush(stdout);
+    printf("scheduled id is %d\n", s->id);
+    fflush(stdout);
+    _set_status(cl, 0);
+
+    return 0;
+}
+
+/* delay until str, a time of day "HH:MM[:SS]" (the next time the clock
+ * shows it) or a duration (see _parse_duration, "+" in front is allowed)
+ * post-condition:  returned us from now, -1 if str is neither */
+long _sched_delay(char * str)
+{
+    // declarations
+    struct tm tm;
+    time_t now = time(NULL);
+    time_t then;
+    long ms;
+    int h, m;
+    int s = 0;
+    int n = 0;
+
+    if (strchr(str, ':') == NULL)
+    {
+        ms = _parse_duration(str[0] == '+' ? str + 1 : str);
+        return (ms == -1) ? -1 : ms * 1000;
+    }
+
+    if (sscanf(str, "%d:%d%n:%d%n", &h, &m, &n, &s, &n) < 2 || str[n] != '\0' ||
+        h < 0 || h > 23 || m < 0 || m > 59 || s < 0 || s > 59) { return -1; }
+
+    // today, or tomorrow if that went by
+    localtime_r(&now, &tm);
+    tm.tm_hour = h;
+    tm.tm_min = m;
+    tm.tm_sec = s;
+    tm.tm_isdst = -1;
+    if ((then = mktime(&tm)) <= now)
+    {
+        tm.tm_mday++;
+        tm.tm_isdst = -1;
+        then = mktime(&tm);
+    }
+
+    return (long) (then - now) * 1000000L;
+}
+
+/* run s once, in the background whatever the mode, leaving $? as it was
+ * post-condition:  returned 1 if a job was started, 0 if not */
+int _sched_launch(struct CL * cl, struct SCHED * s)
+{
+    // declarations
+    int fg_status = cl->fg_status;
+    int fg_signaled = cl->fg_signaled;
+    int fg_exited = cl->fg_exited;
+    int fg_ran = cl->fg_ran;
+    int fg_timed_out = cl->fg_timed_out;
+    int block_mode = cl->bg_block_mode;
+    int job_len = cl->job_len;
+    char * line = malloc(strlen(s->cmd) + 3);
+
+    sprintf(line, "%s &", s->cmd);
+    _msg_begin(cl);
+    cl->bg_block_mode = 0;
+    _run_line(cl, line);
+    clear_CL(cl);
+    free(line);
+
+    cl->bg_block_mode = block_mode;
+    cl->fg_status = fg_status;
+    cl->fg_signaled = fg_signaled;
+    cl->fg_exited = fg_exited;
+    cl->fg_ran = fg_ran;
+    cl->fg_timed_out = fg_timed_out;
+    s->runs++;
+
+    // the job is the newest one (its helpers come before it)
+    if (cl->job_len == job_len) { s->pid = 0; return 0; }
+    s->pid = cl->jobs[cl->job_len - 1].pid;
+    return 1;
+}
+
+/* last run of s is still going */
+int _sched_running(struct CL * cl, struct SCHED * s)
+{
+    int i;
+
+    if (s->pid == 0) { return 0; }
+    for (i = 0; i < cl->job_len; i++)
+    {
+        if (cl->jobs[i].pid == s->pid) { return !cl->jobs[i].done; }
+    }
+    return 0;
+}
+
+/* arm the timer for the earliest entry (disarmed if there is none) */
+int _sched_arm(struct CL * cl)
+{
+    struct itimerspec its = {0};
+
+    if (cl->sched_fd == -1) { return 0; }
+
+    // (a time that went by expires right away)
+    if (cl->sched_len > 0)
+    {
+        its.it_value.tv_sec = cl->sched[0]->due_us / 1000000L;
+        its.it_value.tv_nsec = (cl->sched[0]->due_us % 1000000L) * 1000L;
+        if (its.it_value.tv_sec == 0 && its.it_value.tv_nsec == 0) { its.it_value.tv_nsec = 1; }
+    }
+    return timerfd_settime(cl->sched_fd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+/* add s to the heap, creating the timer on first use */
+int _sched_push(struct CL * cl, struct SCHED * s)
+{
+    struct epoll_event ev = {0};
+
+    if (cl->sched_fd == -1)
+    {
+        cl->sched_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        ev.events = EPOLLIN;
+        ev.data.u64 = EV_SCHED;
+        epoll_ctl(cl->ev_fd, EPOLL_CTL_ADD, cl->sched_fd, &ev);
+    }
+
+    // check if heap needs to grow
+    if (cl->sched_len == cl->sched_size)
+    {
+        cl->sched_size = cl->sched_size ? cl->sched_size * 2 : 4;
+        cl->sched = realloc(cl->sched, cl->sched_size * sizeof(struct SCHED*));
+    }
+
+    cl->sched[cl->sched_len++] = s;
+    _sched_up(cl, cl->sched_len - 1);
+
+    return 0;
+}
+
+/* take the entry at idx out of the heap
+ * post-condition:  returned entry is the caller's */
+struct SCHED * _sched_remove(struct CL * cl, int idx)
+{
+    struct SCHED * s = cl->sched[idx];
+
+    // last one fills the hole, and moves whichever way it has to
+    cl->sched[idx] = cl->sched[--cl->sched_len];
+    if (idx < cl->sched_len)
+    {
+        _sched_up(cl, idx);
+        _sched_down(cl, idx);
+    }
+
+    return s;
+}
+
+/* move the entry at idx up to its place */
+void _sched_up(struct CL * cl, int idx)
+{
+    struct SCHED * s = cl->sched[idx];
+    int parent;
+
+    while (idx > 0 && cl->sched[parent = (idx - 1) / 2]->due_us > s->due_us)
+    {
+        cl->sched[idx] = cl->sched[parent];
+        idx = parent;
+    }
+    cl->sched[idx] = s;
+}
+
+/* move the entry at idx down to its place */
+void _sched_down(struct CL * cl, int idx)
+{
+    struct SCHED * s = cl->sched[idx];
+    int kid;
+
+    while ((kid = 2 * idx + 1) < cl->sched_len)
+    {
+        if (kid + 1 < cl->sched_len && cl->sched[kid + 1]->due_us < cl->sched[kid]->due_us) { kid++; }
+        if (cl->sched[kid]->due_us >= s->due_us) { break; }
+        cl->sched[idx] = cl->sched[kid];
+        idx = kid;
+    }
+    cl->sched[idx] = s;
+}
+
+/* free a scheduled command */
+void _sched_free(struct SCHED * s)
+{
+    free(s->cmd);
+    free(s);
+}
+
+/* print us as a short duration ("4.2s", "5m03s", "2h15m") into buf */
+char * _sched_fmt(char * buf, long us)
+{
+    long s = us / 1000000L;
+
+    if (s < 60)        { sprintf(buf, "%.1fs", us / 1000000.0); }
+    else if (s < 3600) { sprintf(buf, "%ldm%02lds", s / 60, s % 60); }
+    else               { sprintf(buf, "%ldh%02ldm", s / 3600, s / 60 % 60); }
+    return buf;
+}
+
+/* order of entries by when they are due (for qsort) */
+int _sched_cmp(const void * a, const void * b)
+{
+    long x = (*(struct SCHED **) a)->due_us;
+    long y = (*(struct SCHED **) b)->due_us;
+
+    return (x > y) - (x < y);
+}
@@ -0,0 +1,332 @@
+/*
+ * program  -   smallsh (daemon mode)
+ * author   -   Nicholas Olson
+ *
+ * "smallsh --serve PATH" listens on a unix domain socket. Every client
+ * gets a worker process of its own holding a session (cwd, jobs, status),
+ * so running a command costs the client one spawn.
+ */
+
+/*** includes ***/
+#define _GNU_SOURCE     // for pipe2 and accept4
+#include <stdlib.h>     // std library stuff
+#include <stdio.h>      // I/O stuff
+#include <unistd.h>     // launching processess
+#include <string.h>     // for strlen, strcmp, etc
+#include <errno.h>      // for errno checking
+#include <fcntl.h>      // for opening
+#include <signal.h>     // for signal control
+#include <sys/stat.h>   // for checking the socket path
+#include <sys/wait.h>   // for waitpid
+#include <sys/epoll.h>  // for the event loop
+#include <sys/signalfd.h> // for reading signals in the event loop
+#include <sys/socket.h> // for the socket
+#include <sys/un.h>     // for unix domain sockets
+#include <stdint.h>     // for fixed size ints
+#include <arpa/inet.h>  // for ntohl
+#include "smallsh.h"    // shell engine
+#include "serve.h"      // protocol
+
+
+/*** defines ***/
+#define SERVE_BACKLOG 128
+
+
+/*** structs ***/
+/* client served by a worker */
+struct CLIENT {
+    int fd;             // client socket
+    int out_fd;         // read end of the session's stdout
+    int err_fd;         // read end of the session's stderr
+    char * in;          // bytes received but not yet run
+    int in_len;
+    int in_size;
+    int gone;           // client hung up
+};
+
+
+/*** hidden prototypes ***/
+int _serve_client(int, int);            // worker: run one client's session
+int _client_read(struct CL*, int, void*);  // buffer frames from client
+int _client_pump(struct CL*, int, void*);  // forward session output to client
+int _next_cmd(struct CLIENT*, char*, int); // pop a command frame from buffer
+void _client_refuse(struct CLIENT*, char*); // send error and end session
+
+
+/*** interface methods ***/
+/* run the daemon on the socket at path until SIGINT or SIGTERM
+ * post-condition:  returned 1 if the socket couldn't be set up */
+int serve(char * path, int flags)
+{
+    // declarations
+    struct sockaddr_un addr = {0};
+    struct epoll_event ev = {0};
+    struct signalfd_siginfo info;
+    struct stat st;
+    sigset_t mask, old_mask;
+    int lfd, sfd, efd, cfd;
+    int stop = 0;
+    int pid;
+
+    // socket (a stale one from an earlier daemon is replaced)
+    if (strlen(path) >= sizeof(addr.sun_path))
+    {
+        fprintf(stderr, "smallsh: %s: socket path too long\n", path);
+        return 1;
+    }
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    if (stat(path, &st) == 0 && S_ISSOCK(st.st_mode)) { unlink(path); }
+
+    lfd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (lfd == -1 || bind(lfd, (struct sockaddr*) &addr, sizeof(addr)) == -1 ||
+        listen(lfd, SERVE_BACKLOG) == -1)
+    {
+        char perr[256];
+        snprintf(perr, sizeof(perr), "smallsh: %s", path);
+        perror(perr);
+        return 1;
+    }
+
+    // signals through a signalfd, like the shell
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    sigprocmask(SIG_BLOCK, &mask, &old_mask);
+    sfd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+
+    // watch for clients and signals
+    efd = epoll_create1(EPOLL_CLOEXEC);
+    ev.events = EPOLLIN;
+    ev.data.fd = lfd;
+    epoll_ctl(efd, EPOLL_CTL_ADD, lfd, &ev);
+    ev.data.fd = sfd;
+    epoll_ctl(efd, EPOLL_CTL_ADD, sfd, &ev);
+
+    while (!stop)
+    {
+        if (epoll_wait(efd, &ev, 1, -1) != 1) { continue; }
+
+        // new client, hand it to a worker
+        if (ev.data.fd == lfd)
+        {
+            cfd = accept4(lfd, NULL, NULL, SOCK_CLOEXEC);
+            if (cfd == -1) { continue; }
+
+            pid = fork();
+            if (pid == 0)
+            {
+                close(lfd);
+                close(sfd);
+                close(efd);
+                sigprocmask(SIG_SETMASK, &old_mask, NULL);
+                _exit(_serve_client(cfd, flags));
+            }
+            close(cfd);
+        }
+        // reap workers, stop on SIGINT/SIGTERM
+        else
+        {
+            while (read(sfd, &info, sizeof(info)) == sizeof(info))
+            {
+                if (info.ssi_signo != SIGCHLD) { stop = 1; }
+            }
+            while (waitpid(-1, NULL, WNOHANG) > 0) { }
+        }
+    }
+
+    // cleanup (workers finish their clients on their own)
+    close(efd);
+    close(sfd);
+    close(lfd);
+    unlink(path);
+    sigprocmask(SIG_SETMASK, &old_mask, NULL);
+
+    return 0;
+}
+
+
+/*** hidden methods ***/
+/* worker: run commands sent by the client on fd in a session of its own,
+ * sending back their output and status
+ * post-condition:  returned exit code of the worker */
+int _serve_client(int fd, int flags)
+{
+    // declarations
+    struct CLIENT client = {0};
+    struct CL * cl;
+    char status[64];
+    char * line;
+    int out[2], err[2];
+    int signaled;
+    int result;
+    int value;
+    int null;
+
+    // commands never read the daemon's stdin
+    null = open("/dev/null", O_RDONLY);
+    dup2(null, STDIN_FILENO);
+    close(null);
+
+    // everything the session prints goes back to the client
+    if (pipe2(out, O_CLOEXEC) == -1 || pipe2(err, O_CLOEXEC) == -1) { return 1; }
+    dup2(out[1], STDOUT_FILENO);
+    dup2(err[1], STDERR_FILENO);
+    close(out[1]);
+    close(err[1]);
+    fcntl(out[0], F_SETFL, O_NONBLOCK);
+    fcntl(err[0], F_SETFL, O_NONBLOCK);
+
+    client.fd = fd;
+    client.out_fd = out[0];
+    client.err_fd = err[0];
+    client.in_size = FRAME_MAX + FRAME_HDR;
+    client.in = malloc(client.in_size);
+    line = malloc(FRAME_MAX + 1);
+
+    // session of this client, its event loop drives the worker
+    cl = new_CL(CL_SIGNALS | flags);
+    watch_CL(cl, fd, _client_read, &client);
+    watch_CL(cl, out[0], _client_pump, &client);
+    watch_CL(cl, err[0], _client_pump, &client);
+
+    while (1)
+    {
+        // run every command received so far
+        while (_next_cmd(&client, line, FRAME_MAX + 1) >= 0)
+        {
+            result = run_CL(cl, line);
+
+            // forward everything printed before the status
+            fflush(stdout);
+            fflush(stderr);
+            _client_pump(cl, out[0], &client);
+            _client_pump(cl, err[0], &client);
+
+            value = status_CL(cl, &signaled);
+            sprintf(status, "%s %d", signaled ? "signal" : "exit", value);
+
+            // session exited, the last status says goodbye
+            if (result == -1)
+            {
+                send_frame(fd, FRAME_BYE, status, strlen(status));
+                client.gone = 1;
+                client.in_len = 0;
+            }
+            else
+            {
+                send_frame(fd, FRAME_STATUS, status, strlen(status));
+            }
+        }
+
+        if (client.gone) { break; }
+        poll_CL(cl, -1);
+    }
+
+    // cleanup
+    delete_CL(cl);
+    free(client.in);
+    free(line);
+    close(fd);
+
+    return 0;
+}
+
+/* watch callback: buffer what the client sent */
+int _client_read(struct CL * cl, int fd, void * data)
+{
+    struct CLIENT * client = data;
+    int n;
+
+    // the buffer fits the largest frame, and holds no more than part of
+    // one between runs of the loop (longer ones are refused when seen)
+    if (client->in_len == client->in_size) { return 0; }
+
+    n = recv(fd, client->in + client->in_len, client->in_size - client->in_len,
+                MSG_DONTWAIT);
+    if (n > 0) { client->in_len += n; }
+    else if (n == 0 || (errno != EAGAIN && errno != EINTR))
+    {
+        // hung up, the commands already received still run
+        client->gone = 1;
+        unwatch_CL(cl, fd);
+    }
+
+    return 0;
+}
+
+/* watch callback: forward output of the session to the client */
+int _client_pump(struct CL * cl, int fd, void * data)
+{
+    struct CLIENT * client = data;
+    int type = (fd == client->out_fd) ? FRAME_OUT : FRAME_ERR;
+    char buff[FRAME_MAX];
+    int n;
+
+    (void) cl;
+    while ((n = read(fd, buff, sizeof(buff))) > 0)
+    {
+        if (!client->gone && send_frame(client->fd, type, buff, n) == -1)
+        {
+            client->gone = 1;
+        }
+    }
+
+    return 0;
+}
+
+/* pop the first command frame out of the client's buffer into line, a
+ * frame longer than FRAME_MAX ends the session with an error
+ * post-condition:  returned -1 if no whole frame has been received */
+int _next_cmd(struct CLIENT * client, char * line, int size)
+{
+    // declarations
+    uint32_t nlen;
+    int type;
+    int len;
+    int total;
+
+    while (client->in_len >= FRAME_HDR)
+    {
+        type = client->in[0];
+        memcpy(&nlen, client->in + 1, 4);
+        len = ntohl(nlen);
+
+        // too long to ever fit, the client is told and let go
+        if (len < 0 || len > FRAME_MAX || len > size - 1)
+        {
+            _client_refuse(client, "smallsh: frame too long\n");
+            return -1;
+        }
+
+        total = FRAME_HDR + len;
+        if (client->in_len < total) { return -1; }
+
+        // copy command out, without a trailing newline
+        memcpy(line, client->in + FRAME_HDR, len);
+        if (len > 0 && line[len - 1] == '\n') { len--; }
+        line[len] = '\0';
+
+        // drop frame from buffer
+        memmove(client->in, client->in + total, client->in_len - total);
+        client->in_len -= total;
+
+        if (type == FRAME_CMD) { return len; }
+    }
+
+    return -1;
+}
+
+/* send msg as an error and end the client's session, what it sent is
+ * dropped */
+void _client_refuse(struct CLIENT * client, char * msg)
+{
+    if (!client->gone)
+    {
+        send_frame(client->fd, FRAME_ERR, msg, strlen(msg));
+        send_frame(client->fd, FRAME_BYE, "exit 2", 6);
+    }
+    client->gone = 1;
+    client->in_len = 0;
+}
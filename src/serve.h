@@ -0,0 +1,30 @@
+/*
+ * program  -   smallsh (daemon mode and its protocol)
+ * author   -   Nicholas Olson
+ *
+ * Every message on the socket is a frame: one type byte, the payload
+ * length as 4 bytes in network order, then the payload.
+ */
+
+#ifndef SERVE_H
+#define SERVE_H
+
+
+/*** defines ***/
+/* frame types */
+#define FRAME_CMD    'C'    // client -> daemon: command line to run
+#define FRAME_OUT    'O'    // daemon -> client: stdout of the command
+#define FRAME_ERR    'E'    // daemon -> client: stderr of the command
+#define FRAME_STATUS 'S'    // daemon -> client: "exit N" or "signal N"
+#define FRAME_BYE    'X'    // daemon -> client: status, then session ends
+
+#define FRAME_HDR 5         // size of type and length
+#define FRAME_MAX 65536     // largest payload
+
+
+/*** interface prototypes ***/
+int send_frame(int, int, char*, int);   // write a whole frame to fd
+int recv_frame(int, int*, char*, int);  // read a whole frame from fd
+int serve(char*, int);                  // run daemon on socket path
+
+#endif
@@ -9,1330 +9,589 @@
 #include <unistd.h>     // launching processess
 #include <string.h>     // for strlen, strcmp, etc
 #include <errno.h>      // for errno checking
-#include <sys/types.h>  // for opening
-#include <fcntl.h>      // for opening
-#include <sys/stat.h>   // for opening
-#include <signal.h>     // for signal control
 #include <termios.h>    // for terminal attr control
 #include <ctype.h>      // for iscntrl
+#include <getopt.h>     // for command line options
+#include "libsmallsh.h" // shell engine
+#include "serve.h"      // daemon mode
 
 
 /*** defines ***/
-#define CL_BUFF_SIZE 2048
-#define CL_ARGS_SIZE 512
-#define IN_BUFF_SIZE 2048
-#define PWD_BUFF_SIZE 100
-
-
-/*** the two required global variables ***/
-int bg_block_mode_changed = 0;
-int signal_received = 0;
-int bg_block_mode = 0;
-int is_child = 0;
-
-
-/*** structs ***/
-struct CL {
-    // overall array of input
-    char * buffer;
-    
-    // array of space-delineated arguments
-    char ** args;
-    int num_args;
-
-    // current directory
-    char * pwd;
-    int pwd_size;
-    int pwd_len;
-
-    // background processes
-    int pid_size;
-    int pid_len;
-    int * pids;
-
-    // fg process status
-    int fg_status;
-    int fg_signaled;
-    int fg_exited;
-
-    // is child process
-    int is_child;
-
-    // path contents
-    char ** path;
-    int path_len;
-
-    // history of commands
-    char ** history;
-    int hist_size;
-    int hist_len;
-    int curr_idx;
+#define IN_BUFF_SIZE 16384
+#define ESC_TIMEOUT_MS 50
+
+/* keys decoded from the input, besides plain bytes */
+#define KEY_NONE        -1      // byte was part of an unfinished sequence
+#define KEY_UP          256
+#define KEY_DOWN        257
+#define KEY_RIGHT       258
+#define KEY_LEFT        259
+#define KEY_HOME        260
+#define KEY_END         261
+#define KEY_DELETE      262
+#define KEY_WORD_LEFT   263
+#define KEY_WORD_RIGHT  264
+#define KEY_PASTE_START 265
+#define KEY_PASTE_END   266
+#ifndef CTRL
+#define CTRL(c) ((c) & 0x1f)
+#endif
+
+/* terminal modes */
+#define PASTE_ON  "\033[?2004h"    // bracketed paste (pastes are marked)
+#define PASTE_OFF "\033[?2004l"
+#define NL_MARK   "\033[7m;\033[m" // newline in the line (a column wide)
+
+
+/*** key table ***/
+/* escape sequences (after ESC) of the keys handled */
+struct KEYSEQ {
+    char * seq;
+    int key;
+} keyseqs[] = {
+    { "[A",     KEY_UP },
+    { "[B",     KEY_DOWN },
+    { "[C",     KEY_RIGHT },
+    { "[D",     KEY_LEFT },
+    { "OA",     KEY_UP },
+    { "OB",     KEY_DOWN },
+    { "OC",     KEY_RIGHT },
+    { "OD",     KEY_LEFT },
+    { "[H",     KEY_HOME },
+    { "[F",     KEY_END },
+    { "OH",     KEY_HOME },
+    { "OF",     KEY_END },
+    { "[1~",    KEY_HOME },
+    { "[4~",    KEY_END },
+    { "[7~",    KEY_HOME },
+    { "[8~",    KEY_END },
+    { "[3~",    KEY_DELETE },
+    { "[1;5C",  KEY_WORD_RIGHT },   // ctrl-right
+    { "[1;5D",  KEY_WORD_LEFT },    // ctrl-left
+    { "[1;3C",  KEY_WORD_RIGHT },   // alt-right
+    { "[1;3D",  KEY_WORD_LEFT },    // alt-left
+    { "f",      KEY_WORD_RIGHT },   // alt-f
+    { "b",      KEY_WORD_LEFT },    // alt-b
+    { "[200~",  KEY_PASTE_START },
+    { "[201~",  KEY_PASTE_END },
+    { NULL,     0 }
 };
 
 
 /*** interface prototypes ***/
-int setup_CL(struct CL*);               // setup CL struct (allocate)
-int free_CL(struct CL*);                // destroy CL struct (free)
-int run_CL(struct CL*, char*);          // parse and execute line of command
-int get_input(struct CL*, char*, int);  // get user input and put it in buffer
-int clear_CL(struct CL*);               // clear CL struct to neutral state
-int pid_check_CL(struct CL*);           // checks the statuses of all bg pids
+int get_input(struct CL*, char*, char*, int); // get user input and put it in buffer
 int main(int, char**);                  // main runtime
 
 
 /*** hidden prototypes ***/
-int _parse_input(struct CL*, char*);    // parse a string into a command line struct
-int _execute_CL(struct CL*);            // execute command specified by CL_buffer
-int _print(char*, FILE*);               // print string to file pointer passed
-int _grow_CL_pwd_buff(struct CL*);      // grow the size of the pwd buffer
-int _change_CL_pwd(struct CL*, char*);  // change the pwd member of CL to passed str
-int _set_curr_pwd(struct CL*);          // change pwd string to cwd
-int _get_path(struct CL*);              // fill the path member of the CL
-int _push_pid(struct CL*, int);         // add pid to the list of running processes
-int _remove_pid(struct CL*, int);       // remove a pid of the given value from arr
-void _sigint_handler(int signum);       // act on sigint during shell operation
-void _sigtstp_handler(int signum);      // act on sigtstp during shell operation
-int _add_to_hist(struct CL*, char*);    // add a command to the command history
-int _grow_history(struct CL*);          // grow history dynarr
+int _next_input(struct CL*);            // next byte of input, -1 if none buffered
+int _fill_input(struct CL*);            // read available input, 0 on EOF
+int _decode_key(struct LINE*, int);     // decode input byte into key
+int _edit_line(struct CL*, struct LINE*, int); // apply input byte to line
+void _insert_char(struct LINE*, int);   // insert char at cursor
+void _delete_range(struct LINE*, int, int); // delete part of line and redraw
+void _move_cursor(struct LINE*, int);   // move cursor in line
+int _word_start(struct LINE*);          // start of word before cursor
+void _redraw_line(struct LINE*);        // reprint prompt and line
+void _put_text(char*);                  // print part of line
 int _tab_complete(struct CL*, char*, int); // update passed buffer w/ tab complete
 
 
-/*** built-in prototypes ***/
-int _CL_exit();                         // exit command
-int _CL_cd(int, char**, struct CL*);    // cd command
-int _CL_status(struct CL*);             // status command
-
-
 /*** interface methods ***/
-/* allocate memory for CL struct */
-int setup_CL(struct CL * cl)
-{
-    // declarations
-    char * tmp;
-    char * res;
-    int i;
-
-    // initializations
-    cl->pwd_size = PWD_BUFF_SIZE;
-    cl->pwd_len = 0;
-    cl->num_args = 0;
-    cl->pid_len = 0;
-    cl->pid_size = 5;
-    cl->fg_status = 0;
-    cl->is_child = 0;
-    cl->fg_signaled = 0;
-    cl->fg_exited = 1;
-    cl->path_len = 0;
-    cl->hist_len = 0;
-    cl->hist_size = 10;
-    cl->curr_idx = 0;
-
-    // mallocs
-    cl->buffer = malloc(CL_BUFF_SIZE * sizeof(char));
-    cl->args = malloc(CL_ARGS_SIZE * sizeof(char*));
-    cl->pwd = malloc(cl->pwd_size * sizeof(char));
-    cl->pids = malloc(cl->pid_size * sizeof(int));
-    cl->history = malloc(cl->hist_size * sizeof(char*));
-
-    // read path
-    _get_path(cl);
-
-    // set initial pwd
-    _set_curr_pwd(cl);
-}
-
-/* free memory for CL struct
- * pre-condition:   cl has been setup using setup_CL */
-int free_CL(struct CL * cl)
-{
-    // declarations
-    int i;
-
-    // only done for malloc'd args
-    for (i = 0; i < cl->num_args; i++)
-    {
-        free(cl->args[i]);
-    }
-
-    // only done for malloc'd paths
-    for (i = 0; i < cl->path_len; i++)
-    {
-        free(cl->path[i]);
-    }
-
-    // only done for malloc'd history
-    for (i = 0; i < cl->hist_len; i++)
-    {
-        free(cl->history[i]);
-    }
-
-    // frees
-    free(cl->buffer);
-    free(cl->args);
-    free(cl->pids);
-    free(cl->pwd);
-    free(cl->path);
-    free(cl->history);
-}
-
-/* parse and execute command in "input" using CL struct "cl"
- * pre-condition:   CL struct has been setup
- * post-condition:  returned 1 if parsing error,
- *                  returned 2 if execution error,
- *                  returned -1 if successful but exiting
- *                  returned 0 if successful */
-int run_CL(struct CL * cl, char * input)
-{
-    // parse into CL
-    if (_parse_input(cl, input) != 0) { return 1; }
-
-    // execute command
-    int result = _execute_CL(cl);
-    if (result > 0) { return result; }
-    else if (result == -1) { return -1; }
-
-    // return
-    return 0;
-}
-
-/* get user input and put it in provided buffer */
-int get_input(struct CL * cl, char * buffer, int buffer_size)
+/* get user input after showing prompt (the session's prompt if NULL,
+ * redrawn as its segments change) and put it in provided buffer
+ * post-condition:  returned 0 if a command was read,
+ *                  returned 2 if line was empty,
+ *                  returned -1 on end of input */
+int get_input(struct CL * cl, char * prompt, char * buffer, int buffer_size)
 {
     // declaration
     struct termios termInfo, save;
-    int curr_len = 0;
-    int saved_out;
-    int null_out;
-    char str[5];
-    int i = 0;
-    int j = 0;
+    struct LINE line;
+    int dynamic = (prompt == NULL);
+    int events;
+    int done = 0;
+    int eof = 0;
     int c;
-    int t;
 
-    // setup timeout stuff
-    fd_set rfds;
-    struct timeval tv;
-    int retval;
-    FD_ZERO(&rfds);
-    FD_SET(0, &rfds);
-    tv.tv_sec = 1; // 1 second
-    tv.tv_usec = 0; // 1/10 second
+    // setup line
+    line.buf = buffer;
+    line.size = buffer_size;
+    line.len = 0;
+    line.pos = 0;
+    line.seq_len = -1;
+    line.paste = 0;
+    line.hidden = 0;
+    line.tty = cl->is_tty;
+    line.prompt = dynamic ? prompt_CL(cl) : prompt;
+    buffer[0] = '\0';
 
     // move curr_idx to top
     cl->curr_idx = cl->hist_len;
 
-    // get terminal attributes
-    t = tcgetattr(0, &termInfo);
-
-    // turn echo off
-    termInfo.c_lflag &= ~ECHO; /* turn off ECHO */
-    termInfo.c_lflag &= ~ICANON; /* turn on raw mode */
-
-    // set attributes
-    tcsetattr(0, TCSANOW, &termInfo);
-
-    // stop buffering
-    //setvbuf(stdout, NULL, _IONBF, 0);
+    // turn echo and canonical mode off
+    if (cl->is_tty)
+    {
+        tcgetattr(0, &termInfo);
+        save = termInfo;
+        termInfo.c_lflag &= ~ECHO;   /* turn off ECHO */
+        termInfo.c_lflag &= ~ICANON; /* turn on raw mode */
+        termInfo.c_cc[VMIN] = 1;
+        termInfo.c_cc[VTIME] = 0;
+        tcsetattr(0, TCSANOW, &termInfo);
+        fputs(PASTE_ON, stdout);
+    }
 
     // printf PS1 string
     fflush(stdout);
-    fputs(": ", stdout);
+    fputs(line.prompt, stdout);
     fflush(stdout);
-    //fflush(stdin);
 
-    //t = -1;
+    // messages printed from here on go above the line
+    cl->line = &line;
+
     // get input
-    curr_len = 0;
-    //while ((t != -1) ||
-    //        (c = getchar()) != EOF && c != '\n' && c != '\0' && (i < buffer_size - 1))
-    while ((c = getchar()) != EOF && c != '\n' && c != '\0' && (i < buffer_size - 1))
-    //do
+    while (!done)
     {
-        //t = 0;
-        //fflush(stdin);
-        //c = getchar();
-        //scanf("%c", &c);
-        //fflush(stdin);
-
-        // do special stuff
-        if (c == 127) // backspace
-        {
-            // if not at beginning
-            if (i != 0)
-            {
-                // move cursor left
-                printf("%c%c%c", 27, '[', 'D');
-
-                // shift buffer and print
-                for (j = i - 1; j < curr_len - 1; j++)
-                {
-                    buffer[j] = buffer[j+1];
-                    putchar(buffer[j]);
-                }
-                //buffer[curr_len] = '\0';
-                //printf("\n%s\n", buffer);
-
-                // clear last char
-                putchar(' ');
-
-                // move cursor back to where it should be
-                if (curr_len - i + 1 != 0)
-                {
-                    printf("%c%c%c%c", 27, '[', '0' + (curr_len - i + 1), 'D');
-                }
-
-                curr_len--;
-                i--;
-
-                // add null termination
-                buffer[curr_len] = '\0';
-            }
-        }
-        else if (c == 27) // ansi escape sequences
+        // use buffered input first
+        if ((c = _next_input(cl)) != -1)
         {
-            // get rest of escape sequence
-            fgets(str, 3, stdin);
-
-            // handle sequence
-            if (strcmp(str, "[A") == 0) // up arrow
-            {
-                // move earlier in history
-                if (cl->curr_idx != 0)
-                {
-                    // move back
-                    cl->curr_idx--;
-
-                    // copy the thing there
-                    strcpy(buffer, cl->history[cl->curr_idx]);
-
-                    // move cursor back and remove what's there
-                    for (j = 0; j < curr_len; j++)
-                    {
-                        printf("%c%c%c", 27, '[', 'D');
-                        putchar(' ');
-                        printf("%c%c%c", 27, '[', 'D');
-                    }
-
-                    // get len
-                    curr_len = strlen(cl->history[cl->curr_idx]);
-                    i = curr_len;
-
-                    // print command
-                    printf(buffer);
-                }
-            }
-            else if (strcmp(str, "[B") == 0) // down arrow
-            {
-                // move later in history
-                if (cl->curr_idx != cl->hist_len)
-                {
-                    // move forward
-                    cl->curr_idx++;
-
-                    // move cursor back and remove what's there
-                    for (j = 0; j < curr_len; j++)
-                    {
-                        printf("%c%c%c", 27, '[', 'D');
-                        putchar(' ');
-                        printf("%c%c%c", 27, '[', 'D');
-                    }
-
-                    if (cl->curr_idx == cl->hist_len)
-                    {
-                        buffer[0] = '\0';
-                        curr_len = 0;
-                        i = curr_len;
-                    }
-                    else
-                    {
-                        // copy the thing there
-                        strcpy(buffer, cl->history[cl->curr_idx]);
-                        curr_len = strlen(cl->history[cl->curr_idx]);
-                        i = curr_len;
-                    }
-
-                    // print command
-                    printf(buffer);
-
-                }
-            }
-            else if (strcmp(str, "[C") == 0) // right arrow
-            {
-                // move cursor right
-                if (i < curr_len)
-                {
-                    printf("%c%c%c", 27, '[', 'C');
-                    i++;
-                }
-            }
-            else if (strcmp(str, "[D") == 0) // left arrow
-            {
-                // move cursor left
-                if (i != 0)
-                {
-                    printf("%c%c%c", 27, '[', 'D');
-                    i--;
-                }
-            }
-            else
-            {
-                // Unsupported escape sequence
-            }
+            done = _edit_line(cl, &line, c);
+            eof = (done == 2);
+            continue;
         }
-        else
-        {
-            // normal character
-
-            // put new char
-            putchar(c);
-
-            // shift following chars back
-            for (j = curr_len; j > i; j--)
-            {
-                buffer[j] = buffer[j-1];
-            }
+        fflush(stdout);
 
-            // store char in buff
-            buffer[i] = c;
+        // wait for something to happen
+        events = _ev_wait(cl, -1);
 
-            // put following chars
-            for (j = i + 1; j <= curr_len; j++)
-            {
-                putchar(buffer[j]);
-            }
+        // background completions and mode toggles, and scheduled
+        // commands that are due (or were waiting on a job just done)
+        if (events & (EV_SIGNAL | EV_CHILD | EV_SCHED))
+        {
+            pid_check_CL(cl);
+            sched_CL(cl);
+            if (line.hidden) { _redraw_line(&line); }
+        }
 
-            // if not at end, move cursor back
-            if (curr_len - i != 0)
-            {
-                printf("%c%c%c%c", 27, '[', '0' + (curr_len - i), 'D');
-            }
+        // fresher prompt segments arrived
+        if ((events & EV_PROMPT) && dynamic)
+        {
+            line.prompt = prompt_CL(cl);
+            _redraw_line(&line);
+        }
 
-            // add null termination
-            buffer[curr_len+1] = '\0';
+        // lone escape key (or cut off sequence), drop it
+        if (events & EV_TIMER) { line.seq_len = -1; }
 
-            // add to length
-            curr_len++;
-            
-            // move cursor forward            
-            i++;
+        // new input
+        if ((events & EV_INPUT) && _fill_input(cl) == 0)
+        {
+            eof = (line.len == 0);
+            done = 1;
         }
-        
-        // flush
-        fflush(stdout);
     }
-    
-    // get rid of buffered stuff
-    fflush(stdin);
-    
-    // add end of string
-    buffer[curr_len+1] = '\0';
+
+    // not at prompt anymore
+    cl->line = NULL;
+    _ev_timer(cl, 0);
 
     // newline
-    putchar('\n');
+    if (!eof) { putchar('\n'); }
+    fflush(stdout);
 
     // turn ECHO back on
-    termInfo.c_lflag |= ECHO; /* turn on ECHO */
-    termInfo.c_lflag |= ICANON; /* turn on raw mode */
-   
-    // set attributes
-    tcsetattr(0, TCSANOW, &termInfo);
-
-    // stop buffering
-    //setvbuf(stdout, NULL, _IOLBF, 0);
-
-    // trim the newline
-    //strtok(buffer, "\n");
+    if (cl->is_tty)
+    {
+        fputs(PASTE_OFF, stdout);
+        fflush(stdout);
+        tcsetattr(0, TCSANOW, &save);
+    }
 
-    // flush input
-    fflush(stdin);
+    // end of input
+    if (eof) { return -1; }
 
     // add command to history
-    if (curr_len != 0) { _add_to_hist(cl, buffer); }
+    if (line.len != 0) { _add_to_hist(cl, buffer); }
     else { return 2; }
 
     // that's it, it's pretty simple
     return 0;
 }
 
-/* add string to command history
- * pre-condition:   command has no newline */
-int _add_to_hist(struct CL * cl, char * command)
-{
-    // if command is empty
-    if (command[0] == '\0') { return 1; }
-
-    // if history needs to grow
-    if (cl->hist_len == cl->hist_size - 1) { _grow_history(cl); }
-
-    // malloc new element
-    cl->history[cl->hist_len] = malloc((strlen(command)+1) * sizeof(char));
-
-    // add new element
-    strcpy(cl->history[cl->hist_len], command);
 
-    // increment length
-    cl->hist_len++;
-
-    // move curr_idx
-    cl->curr_idx = cl->hist_len;
-    
-    // return
-    return 0;
-}
-
-/* double size of history array */
-int _grow_history(struct CL * cl)
+/*** hidden methods ***/
+/* feed a byte of input through the escape sequence decoder
+ * post-condition:  returned the key (a byte or KEY_*), or KEY_NONE if
+ *                  the byte belongs to a sequence still being read */
+int _decode_key(struct LINE * line, int c)
 {
     // declarations
-    char ** tmp;
+    int prefix = 0;
+    int first;
     int i;
 
-    // copy old elements
-    tmp = malloc(cl->hist_len * sizeof(char*));
-    for (i = 0; i < cl->hist_len; i++)
-    {
-        tmp[i] = cl->history[i];
-    }
-    
-    // free old buff
-    free(cl->history);
-    
-    // double size
-    cl->hist_size *= 2;
-    
-    // malloc new buff
-    cl->history = malloc(cl->hist_size * sizeof(char*));
-    
-    // copy elements in
-    for (i = 0; i < cl->hist_len; i++)
+    // start of a sequence
+    if (line->seq_len == -1)
     {
-        cl->history[i] = tmp[i];
+        if (c == 27) { line->seq_len = 0; return KEY_NONE; }
+        return c;
     }
-    
-    // free tmp
-    free(tmp);
-
-    // return
-    return 0;
-}
 
-/* update passed buffer w/ tab complete
- * pre-conditions:  cl is setup, buffer is null terminated */
-int _tab_complete(struct CL * cl, char * buffer, int idx)
-{
-    char * ptr;
-    char * end;
-    int size = 10;
-    int len = 0;
-    char ** matches = malloc(size * sizeof(char*));
-    int longest = 0;
-    struct dirent * ep;
-    //DIR * dp;
-
-    // move to cursor
-    ptr = buffer + idx;
-
-    // ensure cursor is at end of word or buffer
-    if (strlen(buffer) != idx && *(ptr + 1) == ' ') { return 1; }
-
-    if ((ptr = strstr(buffer, " ")) != NULL)
-    {
-        // find last arg
-        while(strstr(buffer, " ") != NULL)
-            { ptr = strstr(buffer, " ") + 1; }
-        end = strstr(buffer, " ");
-    }
-    else
-    {
-        ptr = buffer;
-    }
+    line->seq[line->seq_len++] = c;
+    line->seq[line->seq_len] = '\0';
 
-    // at start of last arg or beginning
-    if (ptr == buffer)
+    // whole sequence, or the start of one
+    for (i = 0; keyseqs[i].seq != NULL; i++)
     {
-        /* complete command or file */
-        if (strlen(buffer) != 0 && buffer[0] == '.')
-        {
-            /* check check current dir */
-        }
-        else if (strlen(buffer) != 0)
+        if (strcmp(keyseqs[i].seq, line->seq) == 0)
         {
-            /* match whatever is already there */
+            line->seq_len = -1;
+            return keyseqs[i].key;
         }
+        if (strncmp(keyseqs[i].seq, line->seq, line->seq_len) == 0) { prefix = 1; }
     }
-    else
+    if (prefix) { return KEY_NONE; }
+
+    // unknown sequences are dropped whole: "ESC x", "ESC O x", and
+    // "ESC [ ... x" with x the final byte of a CSI sequence
+    first = line->seq[0];
+    if ((first != '[' && first != 'O') || (first == 'O' && line->seq_len == 2)
+        || (first == '[' && line->seq_len > 1 && c >= 0x40 && c <= 0x7e)
+        || line->seq_len == SEQ_MAX - 1)
     {
-        /* complete argument (file) */
-        
+        line->seq_len = -1;
     }
+    return KEY_NONE;
 }
 
-
-/* clear the command line struct back to default state */
-int clear_CL(struct CL * cl)
+/* apply a byte of input to the line being edited
+ * post-condition:  returned 1 if the line is complete,
+ *                  returned 2 on end of input (Ctrl-D on an empty line) */
+int _edit_line(struct CL * cl, struct LINE * line, int c)
 {
-    int i;
+    // declarations
+    char * buffer = line->buf;
+    int key;
+    int j;
 
-    // free arguments
-    for (i = 0; i < cl->num_args; i++)
+    // decode, giving lone escape keys a moment to become sequences
+    key = _decode_key(line, c);
+    if (key == KEY_NONE)
     {
-        free(cl->args[i]);
+        if (line->seq_len == 0) { _ev_timer(cl, ESC_TIMEOUT_MS); }
+        return 0;
     }
 
-    // reset vars
-    cl->num_args = 0;
-    cl->buffer[0] = '\0';
-}
-
-/* checks if the background processes have completed */
-int pid_check_CL(struct CL * cl)
-{
-    int result;
-    int i;
-
-    // check for bg blocking mode change
-    if (bg_block_mode_changed == 1)
+    // pasted text is taken as is and drawn once the paste ends
+    if (line->paste)
     {
-        if (bg_block_mode == 1)
+        if (key == KEY_PASTE_END)
         {
-            fputs("Entering foreground-only mode (& is now ignored)\n", stdout);
+            line->paste = 0;
+            _redraw_line(line);
         }
-        else if (bg_block_mode == 0)
+        else if (key == '\n' || key == '\r')
         {
-            fputs("Exiting foreground-only mode\n", stdout);
+            // kept, each line runs as a command (see _run_line)
+            _insert_char(line, '\n');
         }
-        bg_block_mode_changed = 0;
-    }
-
-    for(i = 0; i < cl->pid_len; i++)
-    {
-        // get whether bg process has exited
-        pid_t cpid = 0;
-        result = 0;
-        cpid = waitpid(cl->pids[i], &result, WNOHANG);
-        //cpid = waitpid(cl->pids[i], &result, WNOHANG);
-        /*if (errno == ECHILD) printf("does not exist\n");
-        if (errno == EINVAL) printf("bad options\n");
-        if (errno == ENOSYS) printf("bad pid\n");*/
-
-        /*
-        printf("Stored pid = \"%d\"\n", cl->pids[i]);
-        printf("Waitpid result =  \"%d\"\n", cpid);
-        printf("Status = %d\n", result);
-        printf("WIFEXITED = %d\n", WIFEXITED(result));*/
-        if (cpid != 0 && WIFEXITED(result))
+        else if (key == '\t')
         {
-            fflush(stdout);
-            printf("background pid %d is done: exit value %d\n",
-                        cl->pids[i], WEXITSTATUS(result));
-            fflush(stdout);
-            _remove_pid(cl, cl->pids[i]);
+            _insert_char(line, ' ');
         }
-        else if (cpid != 0 && WIFSIGNALED(result))
+        else if (key >= ' ' && key < 256 && key != 127)
         {
-            fflush(stdout);
-            printf("\nbackground pid %d is done: terminated by signal %d\n",
-                        cl->pids[i], WTERMSIG(result));
-            fflush(stdout);
-            _remove_pid(cl, cl->pids[i]);
+            _insert_char(line, key);
         }
+        return 0;
     }
-}
 
+    // end of line
+    if (key == '\n' || key == '\0') { return 1; }
 
-/*** hidden methods ***/
-/* parses the "input" string into a CL struct
- * pre-condition:   cl has been setup */
-int _parse_input(struct CL * cl, char * input)
-{
-    // declarations
-    int start = 0;
-    int end = 0;
-    int i = 0;
-    int len;
-
-    // copy input into buffer
-    sprintf(cl->buffer, "%s\0", input);
-    
-    // get length of buffer
-    len = strlen(cl->buffer);
-
-    // set first arg to null for now
-    cl->args[0] = NULL;
-
-    // check for comment
-    if (len > 0 && cl->buffer[0] == '#')
+    if (key == KEY_PASTE_START)
     {
-        return 0;
+        line->paste = 1;
     }
-
-    // parse into args array
-    for (end = 0; end < len; end++)
+    else if (key == KEY_UP)
     {
-        // beginning and/or end of word
-        if ((cl->buffer[end] == ' ') || (end == len - 1))
+        // move earlier in history (removed entries are skipped)
+        for (j = cl->curr_idx - 1; j >= 0 && _history_get(cl, j) == NULL; j--) { }
+        if (j >= 0)
         {
-            // if there has been at least one char since last space
-            if ((end - start > 0) || ((end == len - 1) && (cl->buffer[end] != ' ')))
-            {
-                if (end == len - 1) { end++; }
-                cl->args[cl->num_args] = malloc((end - start + 1) * sizeof(char));
-                sprintf(cl->args[cl->num_args], "%.*s\0", (end - start), (cl->buffer + start));
-
-                // check for $$
-                char * wow = strstr(cl->args[cl->num_args], "$$");
-                if (wow != NULL)
-                {
-                    // get pid
-                    pid_t pid = getpid();
-                    char pid_buff[100]; // RIP pids longer than 100 digits
-                    sprintf(pid_buff, "%d\0", pid);
-
-                    // copy arg into tmp
-                    char * tmp = malloc((end - start + 1) * sizeof(char));
-                    strcpy(tmp, cl->args[cl->num_args]);
-
-                    // cut-off string before &&
-                    wow = tmp + (wow - cl->args[cl->num_args]);
-                    wow[0] = '\0';
-
-                    // re-allocate arg buffer
-                    free(cl->args[cl->num_args]);
-                    cl->args[cl->num_args] = malloc((strlen(pid_buff)+(end-start+1))*sizeof(char));
-
-                    // compile full string 
-                    sprintf(cl->args[cl->num_args], "%s%s%s", tmp, pid_buff, (wow+2));
-
-                    // free tmp
-                    free(tmp);
-                }
-
-                cl->num_args += 1;
-            }
-
-            // move start forward
-            start = end + 1;
-        }
-    }
-
-    // add final null to signify end of args
-    cl->args[cl->num_args] = (char*) NULL;
+            // move back
+            cl->curr_idx = j;
 
-    // return
-    return 0;
-}
+            // copy the thing there
+            snprintf(buffer, line->size, "%s", _history_get(cl, cl->curr_idx));
+            line->len = strlen(buffer);
+            line->pos = line->len;
 
-/* executes the command contained within the CL struct
- * pre-condition:   cl has been setup */
-int _execute_CL(struct CL * cl)
-{
-    // declarations
-    int in_stream = STDIN_FILENO;
-    int out_stream = STDOUT_FILENO;
-    int saved_in;
-    int saved_out;
-    int in_redir = 0;
-    int out_redir = 0;
-    int background = 0;
-    int special_count = 0;
-    int result = 0;
-    int i = 0;
-    int j = 0;
-
-    // if command was empty
-    if (cl->args[0] == NULL || strcmp(cl->args[0], "\n") == 0) { return 0; }
-
-    // if exit (save the time of parsing)
-    if (strcmp(cl->args[0], "exit") == 0) { return -1; }
-
-    // check for special args
-    if (_process_special_args(cl, &special_count,
-                        &in_stream, &out_stream,
-                        &in_redir, &out_redir, &background) != 0)
-    {
-        /* redirection error */
-        if (!background)
-        {
-            // foreground, set status
-            cl->fg_status = 1;
-            cl->fg_exited = 1;
-            cl->fg_signaled = 0;
+            // print command
+            _redraw_line(line);
         }
-        
-        return 0;
     }
-
-    // don't pass special arguments in
-    char * tmp = cl->args[cl->num_args - special_count];
-    cl->args[cl->num_args - special_count] = NULL;
-        
-    // execute built-in commands
-    if (strcmp(cl->args[0], "cd") == 0)
-        { _CL_cd((cl->num_args - special_count), cl->args, cl); }
-    else if (strcmp(cl->args[0], "exit") == 0)
-        { _CL_exit(); }
-    else if (strcmp(cl->args[0], "status") == 0)
-        { _CL_status(cl); }
-
-    // execute non built-ins
-    else {
-        // fork process
-        result = 0; 
-        signal(SIGINT, _sigint_handler);
-        i = fork();
-
-        // if parent process
-        if (i > 0)
+    else if (key == KEY_DOWN)
+    {
+        // move later in history
+        if (cl->curr_idx != cl->hist_len)
         {
-            // is parent
-            cl->is_child = 0;
-            is_child = 0;
-
-            // status var
-            int status = 0;
+            // move forward
+            for (j = cl->curr_idx + 1; j < cl->hist_len && _history_get(cl, j) == NULL; j++) { }
+            cl->curr_idx = j;
 
-            // background process
-            if (background)
+            if (cl->curr_idx == cl->hist_len)
             {
-                signal(SIGINT, SIG_IGN);
-                
-                fflush(stdout);
-                printf("background pid is %d\n", i);
-                fflush(stdout);
-
-                _push_pid(cl, i);
+                buffer[0] = '\0';
             }
-            // foreground process
             else
             {
-                fflush(stdout);
-
-                j = 0;
-                is_child = 1;
-                status = 0;
-                j = waitpid(i, &status, 0);
-                //while (j == 0) { j = waitpid(i, &status, WNOHANG); }
-                is_child = 0;
-
-                signal(SIGINT, _sigint_handler);
-
-                /*
-                printf("j = %d\n", j);
-                printf("status = %d\n", status);
-                printf("WIFSIGNALED = %d\n", WIFSIGNALED(status));
-                printf("WIFEXITED = %d\n", WIFEXITED(status));
-                */
-
-                // if no waitpid error occurred
-                if (j != -1)//status != 0)
-                {
-                    //printf("~~WAITPID %d\n", j);
-                    if (WIFSIGNALED(status))
-                    {
-                        //printf("~~SIGNAL %d\n", WTERMSIG(status));
-                        cl->fg_status = WTERMSIG(status);
-                        cl->fg_exited = 0;
-                        cl->fg_signaled = 1;
-                    }
-                    else if (WIFEXITED(status))
-                    {
-                        //printf("~~EXIT %d\n", WEXITSTATUS(status));
-                        cl->fg_status = WEXITSTATUS(status);
-                        cl->fg_exited = 1;
-                        cl->fg_signaled = 0;
-                    }
-                    else
-                    {
-                        //printf("~~NOT SIGNALED OR EXITED\n");
-                    }
-                }
-            }
-            
-            signal(SIGINT, SIG_IGN);
-        }
-        // if forked child process
-        else if (i == 0)
-        {
-            // is child
-            cl->is_child = 1;
-            is_child = 1;
-
-            // redirect input and output
-            if (in_redir)  { saved_in = dup(STDIN_FILENO); 
-                             dup2(in_stream, STDIN_FILENO); }
-            if (out_redir) { fflush(stdout);
-                             saved_out = dup(STDOUT_FILENO);
-                             dup2(out_stream, STDOUT_FILENO); }
-            
-            // always ignore sigtstp
-            signal(SIGTSTP, SIG_IGN);
-
-            // ignore sigint if in background
-            if (background) { signal(SIGINT, SIG_IGN); }
-            else            { signal(SIGINT, _sigint_handler); }
-
-            // not a built-in command
-            for (j = 0; j < cl->path_len; j++)
-            {
-                char * path_tmp = malloc((strlen(cl->args[0]) + strlen(cl->path[j]) + 2) * sizeof(char));
-                sprintf(path_tmp, "%s/%s", cl->path[j], cl->args[0]);
-                execv(path_tmp, cl->args);
-                //execvp(cl->args[0], cl->args);
-                free(path_tmp);
+                // copy the thing there
+                snprintf(buffer, line->size, "%s", _history_get(cl, cl->curr_idx));
             }
+            line->len = strlen(buffer);
+            line->pos = line->len;
 
-            // following is only reached if execvp failed
-            cl->fg_status = 1;
-            cl->is_child = 1;
-            result = -1;
-
-            // print system error
-            char perr[CL_BUFF_SIZE] = "smallsh: ";
-            sprintf(perr, "%s%s", perr, cl->args[0]);
-            perror(perr);
-            
-            // close streams
-            if (in_redir)  { close(in_stream);
-                             dup2(STDIN_FILENO, saved_in);
-                             close(saved_in); }
-            if (out_redir) { close(out_stream); 
-                             dup2(STDOUT_FILENO, saved_out);
-                             close(saved_out); }
-
-        } // child thing
+            // print command
+            _redraw_line(line);
+        }
     }
-
-    // put old special arguments back
-    cl->args[cl->num_args - special_count] = tmp;
-
-    // return
-    return result;
-}
-
-/* check the argument list for special arguments (redirection / bg)
- * pre-condition:   cl setup and parsed
- * post-condition:  flags and streams passed are updated */
-_process_special_args(struct CL * cl, int * special_count,
-                      int * in_stream, int * out_stream,
-                      int * in_redir, int * out_redir,
-                      int * background)
-{
-    // declarations
-    int i;
-
-    // initial values
-    *in_stream = STDIN_FILENO;
-    *out_stream = STDOUT_FILENO;
-    *special_count = 0;
-    *background = 0;
-    *out_redir = 0;
-    *in_redir = 0;
-
-    // check for background first
-    if (strcmp(cl->args[cl->num_args - 1], "&") == 0)
+    else if (key == KEY_RIGHT || key == CTRL('F'))
     {
-        // open in background
-        *special_count += 1;
-
-        // background ( redir can be overwritten )
-        if (bg_block_mode == 0)
-        {
-            *in_stream = open("/dev/null", O_RDONLY);
-            *out_stream = open("/dev/null", O_WRONLY);
-            *in_redir = 1;
-            *out_redir = 1;
-            *background = 1;
-        }
+        if (line->pos < line->len) { _move_cursor(line, line->pos + 1); }
     }
-
-    // check for redirection special args
-    for (i = 0; i < cl->num_args; i++)
+    else if (key == KEY_LEFT || key == CTRL('B'))
     {
-        if (strcmp(cl->args[i], "<") == 0)
-        {
-            // new input file
-            *special_count += 2;
-
-            // if background or already redir'd, close the old one
-            if (*background || *in_redir) { close(*in_stream); }
+        if (line->pos != 0) { _move_cursor(line, line->pos - 1); }
+    }
+    else if (key == KEY_HOME || key == CTRL('A'))
+    {
+        _move_cursor(line, 0);
+    }
+    else if (key == KEY_END || key == CTRL('E'))
+    {
+        _move_cursor(line, line->len);
+    }
+    else if (key == KEY_WORD_LEFT)
+    {
+        _move_cursor(line, _word_start(line));
+    }
+    else if (key == KEY_WORD_RIGHT)
+    {
+        // skip spaces, then the word
+        for (j = line->pos; j < line->len && buffer[j] == ' '; j++) { }
+        for (; j < line->len && buffer[j] != ' '; j++) { }
+        _move_cursor(line, j);
+    }
+    else if (key == CTRL('D') && line->len == 0)
+    {
+        return 2;
+    }
+    else if (key == KEY_DELETE || key == CTRL('D'))
+    {
+        // delete char under cursor
+        if (line->pos < line->len) { _delete_range(line, line->pos, line->pos + 1); }
+    }
+    else if (key == 127 || key == CTRL('H')) // backspace
+    {
+        // if not at beginning
+        if (line->pos != 0) { _delete_range(line, line->pos - 1, line->pos); }
+    }
+    else if (key == CTRL('W'))
+    {
+        // delete word before cursor
+        _delete_range(line, _word_start(line), line->pos);
+    }
+    else if (key == CTRL('K'))
+    {
+        // delete to end of line
+        _delete_range(line, line->pos, line->len);
+    }
+    else if (key == CTRL('U'))
+    {
+        // delete to start of line
+        _delete_range(line, 0, line->pos);
+    }
+    else if (key >= 256 || (key < ' ' && key != '\t'))
+    {
+        // unsupported key
+    }
+    else if (line->len < line->size - 1)
+    {
+        // normal character
+        _insert_char(line, key);
 
-            // "<" is not last arg
-            *in_stream = open(cl->args[i+1], O_RDONLY);
-            *in_redir = 1;
+        // put new char and following chars
+        _put_text(buffer + line->pos - 1);
 
-            // check for open failure
-            if (*in_stream == -1)
-            {
-                char perr[CL_BUFF_SIZE] = "smallsh: ";
-                sprintf(perr, "%s%s", perr, cl->args[i+1]);
-                perror(perr);
-                return 1;
-            }
-        }
-        else if (strcmp(cl->args[i], ">") == 0)
+        // if not at end, move cursor back
+        if (line->len - line->pos != 0)
         {
-            // new output file
-            *special_count += 2;
-           
-            // if background or already redir'd, close the old one
-            if (*background || *out_redir) { close(*out_stream); }
-
-            // ">" is not last arg
-            *out_stream = open(cl->args[i+1], O_WRONLY | O_TRUNC | O_CREAT, 0600);
-            *out_redir = 1;
-            
-            // check for open failure
-            if (*out_stream == -1)
-            {
-                char perr[CL_BUFF_SIZE] = "smallsh: ";
-                sprintf(perr, "%s%s", perr, cl->args[i+1]);
-                perror(perr);
-                return 1;
-            }
-        }
-        else if (strcmp(cl->args[i], ">>") == 0)
-        {
-            // new output file (append)
-            *special_count += 2;
-            
-            // if background or already redir'd, close the old one
-            if (*background || *out_redir) { close(*out_stream); }
-            
-            // ">>" is not last arg
-            *out_stream = open(cl->args[i+1], O_WRONLY | O_APPEND | O_CREAT, 0600);
-            *out_redir = 1;
-            
-            // check for open failure
-            if (*out_stream == -1)
-            {
-                char perr[CL_BUFF_SIZE] = "smallsh: ";
-                sprintf(perr, "%s%s", perr, cl->args[i+1]);
-                perror(perr);
-                return 1;
-            }
+            printf("\033[%dD", line->len - line->pos);
         }
     }
+    else
+    {
+        // line is full
+        return 1;
+    }
 
     return 0;
 }
 
-/* grow the size of the pwd buffer */
-int _grow_CL_pwd_buff(struct CL * cl)
+/* insert c at the cursor (without drawing it) */
+void _insert_char(struct LINE * line, int c)
 {
-    // declarations
-    char * tmp;
+    if (line->len >= line->size - 1) { return; }
 
-    // allocate temporary array
-    tmp = malloc(cl->pwd_size * sizeof(char));
+    // shift following chars back
+    memmove(line->buf + line->pos + 1, line->buf + line->pos, line->len - line->pos);
 
-    // fill temporary array
-    strcpy(tmp, cl->pwd);
+    // store char in buff
+    line->buf[line->pos] = c;
+    line->len++;
+    line->pos++;
 
-    // free old array
-    free(cl->pwd);
-
-    // double size
-    cl->pwd_size *= 2;
-
-    // allocate new pwd buffer
-    cl->pwd = malloc(cl->pwd_size * sizeof(char));
-
-    // copy tmp into new buffer
-    strcpy(cl->pwd, tmp);
-
-    // free tmp buffer
-    free(tmp);
+    // add null termination
+    line->buf[line->len] = '\0';
 }
 
-/* change pwd to the passed string
- * pre-condition:   new_dir is null-terminated */
-int _change_CL_pwd(struct CL * cl, char * new_dir)
+/* delete chars from "from" up to "to", leaving the cursor at "from" */
+void _delete_range(struct LINE * line, int from, int to)
 {
-    // grow as needed
-    while (strlen(new_dir) >= cl->pwd_size) { _grow_CL_pwd_buff(cl); }
+    if (from >= to) { return; }
 
-    // set new length
-    cl->pwd_len = strlen(new_dir);
+    memmove(line->buf + from, line->buf + to, line->len - to + 1);
+    line->len -= to - from;
+    line->pos = from;
 
-    // copy new_dir into pwd
-    strcpy(cl->pwd, new_dir);
+    _redraw_line(line);
 }
 
-/* change the pwd string in cl to the cwd */
-int _set_curr_pwd(struct CL * cl)
+/* move the cursor to pos */
+void _move_cursor(struct LINE * line, int pos)
 {
-    // declarations
-    char * tmp;
-    char * res;
-    int i;
-
-    // try to allocate cwd buffer
-    i = PWD_BUFF_SIZE / 2;
-    tmp = malloc(i * sizeof(char));
-    res = getcwd(tmp, i);
-
-    // while buff is not big enough for cwd
-    while (res == NULL && errno == ERANGE)
-    {
-        free(tmp);
-        i *= 2;
-        tmp = malloc(i * sizeof(char));
-        res = getcwd(tmp, i);
-    }
-
-    // big enough, use the cwd
-    _change_CL_pwd(cl, tmp);
-
-    // free temp stuff
-    free(tmp);
+    if (pos > line->pos)      { printf("\033[%dC", pos - line->pos); }
+    else if (pos < line->pos) { printf("\033[%dD", line->pos - pos); }
+    line->pos = pos;
 }
 
-/* parse current PATH var into cl members */
-int _get_path(struct CL * cl)
+/* position of the start of the word before the cursor */
+int _word_start(struct LINE * line)
 {
-    // declarations
-    const char * c_tmp;
-    int tmp_size = 10;
-    int tmp_len = 0;
-    char * tmp;
-    char * tmp2;
-    char * tmp_free;
-    int count = 0;
-    int i;
-
-    // if path has been alloc'd
-    if (cl->path_len != 0)
-    {
-        for (i = 0; i < cl->path_len; i++) { free(cl->path[i]); }
-        free(cl->path);
-        cl->path_len = 0;
-    }
+    int j = line->pos;
 
-    // get path var
-    c_tmp = getenv("PATH");
-    tmp = malloc((strlen(c_tmp) + 1) * sizeof(char));
-    tmp_free = tmp;
-    strcpy(tmp, c_tmp);
-
-    // get count of ":"
-    tmp2 = tmp;
-    while((tmp2 = strstr(tmp2, ":")) != NULL)
-    {
-       count++;
-       tmp2++;
-    }
-
-    // allocate path arr
-    cl->path_len = count + 1;
-    cl->path = malloc(cl->path_len * sizeof(char *));
-
-    // if path is empty
-    if (strlen(c_tmp) == 0)
-    {
-        free(tmp_free);
-        cl->path[0] = ".";
-        return 1;
-    }
-
-    // for each ":" between paths (tmp is at beginning)
-    count = 0;
-    for (i = 0; i < cl->path_len && tmp != NULL; i++)
-    {
-        // ensure char after curr path is '\0'
-        if ((tmp2 = strstr(tmp, ":")) != NULL)
-        {
-            // set the following ":" to "\0"
-            tmp2[0] = '\0';
-        }
-
-        // allocate current path string
-        cl->path[i] = malloc((strlen(tmp) + 1) * sizeof(char));
-    
-        // copy path into arr
-        strcpy(cl->path[i], tmp);
-
-        // move forward
-        if (tmp2 != NULL) { tmp = tmp2 + 1; }
-        else              { tmp = NULL; }
-
-        //printf("~%d~%s\n", i, cl->path[i]);
-    }
-
-    // cleanup temp
-    free(tmp_free);
+    // skip spaces, then the word
+    while (j > 0 && line->buf[j - 1] == ' ') { j--; }
+    while (j > 0 && line->buf[j - 1] != ' ') { j--; }
+    return j;
 }
 
-/* add pid to the list of background processes */
-int _push_pid(struct CL * cl, int new_pid)
+/* reprint the prompt and line, leaving the cursor at its position (only
+ * on a terminal, piped output would get the escapes as text) */
+void _redraw_line(struct LINE * line)
 {
-    // local
-    int i;
+    if (!line->tty) { return; }
 
-    // check if pid list needs to grow
-    if (cl->pid_len == cl->pid_size)
+    fputs("\r\033[K", stdout);
+    fputs(line->prompt, stdout);
+    _put_text(line->buf);
+    if (line->len - line->pos != 0)
     {
-        int * tmp = malloc(cl->pid_size * sizeof(int));
-        for (i = 0; i < cl->pid_size; i++) { tmp[i] = cl->pids[i]; }
-        free(cl->pids);
-        cl->pids = malloc(cl->pid_size * 2 * sizeof(int));
-        cl->pid_size *= 2;
-        free(tmp);
+        printf("\033[%dD", line->len - line->pos);
     }
-
-    // add new pid
-    cl->pids[cl->pid_len] = new_pid;
-    cl->pid_len++;
-
-    // return
-    return 0;
+    line->hidden = 0;
+    fflush(stdout);
 }
 
-int _remove_pid(struct CL * cl, int target_pid)
+/* print text of the line, newlines (from pastes) are marked so the line
+ * stays on one row and a byte is still a column */
+void _put_text(char * text)
 {
-    // local
-    int found = 0;
-    int i;
+    char * nl;
 
-    // check pid list
-    for (i = 0; i < cl->pid_len; i++)
+    while ((nl = strchr(text, '\n')) != NULL)
     {
-        // shift elements after target_pid up
-        if (cl->pids[i] == target_pid || found == 1)
-        {
-            found = 1;
-            if (i == cl->pid_len - 1) { cl->pid_len--; }
-            else { cl->pids[i] = cl->pids[i+1]; }
-        }
+        fwrite(text, 1, nl - text, stdout);
+        fputs(NL_MARK, stdout);
+        text = nl + 1;
     }
-
-    // return
-    return 0;
+    fputs(text, stdout);
 }
 
-/* act assigned to sigint invocation */
-void _sigint_handler(int signum)
+/* update passed buffer w/ tab complete
+ * pre-conditions:  cl is setup, buffer is null terminated */
+int _tab_complete(struct CL * cl, char * buffer, int idx)
 {
-    // exit process if child
-    //if (is_child) { printf("SIGINT\n"); }
-    //else { printf("\n"); }
-   
-    // flush out
-    fflush(stdout);
-
-    //printf("is_child = %d\n", is_child);
-    //if (is_child) printf("terminated by signal %d\n", signum);
-    
-    //printf("terminated by signal %d\n", signum);
-    fputs("terminated by signal 2\n", stdout);
+    char * ptr;
+    char * end;
+    int size = 10;
+    int len = 0;
+    char ** matches = malloc(size * sizeof(char*));
+    int longest = 0;
+    struct dirent * ep;
+    //DIR * dp;
 
-    //else { printf("\n"); }
-    //signal_received = 1;
-    //if (is_child) signal_received = 1;
+    // move to cursor
+    ptr = buffer + idx;
 
-    // flush stdin
-    fflush(stdin);
-    fflush(stdout);
-}
+    // ensure cursor is at end of word or buffer
+    if (strlen(buffer) != idx && *(ptr + 1) == ' ') { return 1; }
 
-/* act assigned to sigtstp invocation */
-void _sigtstp_handler(int signum)
-{
-    // toggle background blocking mode
-    if (bg_block_mode == 0)
+    if ((ptr = strstr(buffer, " ")) != NULL)
     {
-        bg_block_mode = 1;
-        bg_block_mode_changed = 1;
+        // find last arg
+        while(strstr(buffer, " ") != NULL)
+            { ptr = strstr(buffer, " ") + 1; }
+        end = strstr(buffer, " ");
     }
-    else if (bg_block_mode == 1)
+    else
     {
-        bg_block_mode = 0;
-        bg_block_mode_changed = 1;
+        ptr = buffer;
     }
 
-    /*
-    // declaration
-    int i;
-
-    // flush
-    fflush(stdout);
-
-    // wait for children
-    wait(&i);
-
-    // toggle background blocking mode
-    if (bg_block_mode == 0)
+    // at start of last arg or beginning
+    if (ptr == buffer)
     {
-        bg_block_mode = 1;
-        //printf("\nEntering foreground-only mode (& is now ignored)\n");
-        fputs("\nEntering foreground-only mode (& is now ignored)\n", stdout);
+        /* complete command or file */
+        if (strlen(buffer) != 0 && buffer[0] == '.')
+        {
+            /* check check current dir */
+        }
+        else if (strlen(buffer) != 0)
+        {
+            /* match whatever is already there */
+        }
     }
-    else if (bg_block_mode == 1)
+    else
     {
-        bg_block_mode = 0;
-        //printf("\nExiting foreground-only mode\n");
-        fputs("\nExiting foreground-only mode\n", stdout);
+        /* complete argument (file) */
+        
     }
-    
-    // flush stdin and stdout
-    fflush(stdin);
-    fflush(stdout);
-    */
 }
 
-
-/*** built-ins ***/
-/* built-in exit command (exits the shell) */
-int _CL_exit()
+/* get the next byte of buffered input
+ * post-condition:  returned -1 if nothing is buffered */
+int _next_input(struct CL * cl)
 {
-    return -1;
+    if (cl->in_pend_pos == cl->in_pend_len) { return -1; }
+    return (unsigned char) cl->in_pend[cl->in_pend_pos++];
 }
 
-/* built-in cd command (change directory) */
-int _CL_cd(int argc, char ** argv, struct CL * cl)
+/* read whatever input is available into the pending buffer
+ * post-condition:  returned 0 on end of input */
+int _fill_input(struct CL * cl)
 {
-    // declarations
-    int i;
+    int n;
 
-    // move home
-    if (argc == 1)
-    {
-        chdir(getenv("HOME"));
-    }
-
-    // change directory
-    for(i = 0; i < argc; i++)
-    {
-        chdir(argv[i]);
-    }
-
-    // update pwd member
-    _set_curr_pwd(cl);
-
-    /* printing pwd
-    _print(cl->pwd, out_stream);
-    printf("\n"); */
+    n = read(STDIN_FILENO, cl->in_pend, IN_PEND_SIZE);
+    if (n == -1 && (errno == EAGAIN || errno == EINTR)) { return 1; }
+    if (n <= 0) { return 0; }
 
-    // return
-    return 0;
-}
-
-/* built-in status command (shows shell status) */
-int _CL_status(struct CL * cl)
-{
-    if      (cl->fg_exited)
-    {
-        fflush(stdout);
-        printf("exit value %d\n", cl->fg_status);
-        fflush(stdout);
-    }
-    else if (cl->fg_signaled || signal_received)
-    {
-        fflush(stdout);
-        printf("terminated by signal %d\n", cl->fg_status);
-        fflush(stdout);
-        signal_received = 0;
-    }
-    return 0;
+    cl->in_pend_len = n;
+    cl->in_pend_pos = 0;
+    return n;
 }
 
 
@@ -1341,53 +600,94 @@ int main(int argc, char** argv)
 {
     // declarations
     char * in_buff;
+    char * text;
+    int text_size = IN_BUFF_SIZE;
+    int text_len;
     int keep_going;
-    struct CL cl;
+    struct CL * cl;
     int result;
+    int flags = CL_INTERACTIVE;
+    char * serve_path = NULL;
+    int fg_only = 0;
     int i;
 
-    // malloc input buffer
-    in_buff = malloc(IN_BUFF_SIZE * sizeof(char));
+    // command line options
+    struct option long_opts[] = {
+        { "capture", no_argument, NULL, 'o' },
+        { "serve", required_argument, NULL, 's' },
+        { "zygote", no_argument, NULL, 'z' },
+        { "fg-only", no_argument, NULL, 'f' },
+        { NULL, 0, NULL, 0 }
+    };
+    while ((i = getopt_long(argc, argv, "os:zf", long_opts, NULL)) != -1)
+    {
+        if (i == 'o')      { flags |= CL_CAPTURE; }
+        else if (i == 's') { serve_path = optarg; }
+        else if (i == 'z') { flags |= CL_ZYGOTE; }
+        else if (i == 'f') { fg_only = 1; }
+        else
+        {
+            fprintf(stderr, "usage: %s [-o|--capture] [-z|--zygote] [-f|--fg-only] [-s|--serve PATH]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    // job control, unless SIGTSTP should toggle foreground-only mode
+    // (always the case without a terminal, e.g. when running a script)
+    if (!fg_only && (serve_path != NULL || isatty(STDIN_FILENO))) { flags |= CL_JOBCTL; }
 
-    // setup command line struct
-    setup_CL(&cl);
+    // daemon mode, sessions belong to the clients
+    if (serve_path != NULL) { return serve(serve_path, flags & ~CL_INTERACTIVE); }
 
-    // declare sigaction structs
-    struct sigaction sigint_action  = {0};
-    struct sigaction sigtstp_action = {0};
+    // malloc input buffer, and the text of a command with its
+    // here-documents (grows as lines are added)
+    in_buff = malloc(IN_BUFF_SIZE * sizeof(char));
+    text = malloc(text_size * sizeof(char));
 
-    // set signal handlers
-    sigint_action.sa_handler  = _sigint_handler;
-    sigtstp_action.sa_handler = _sigtstp_handler;
+    // setup command line session (signals are handled by its event loop)
+    cl = new_CL(flags);
 
-    // assign signal actions with sigaction
-    //sigaction(SIGINT,  &sigint_action,  NULL);
-    signal(SIGINT, SIG_IGN);
-    sigaction(SIGTSTP, &sigtstp_action, NULL);
+    // startup file, "exit" in it ends the shell
+    keep_going = rc_CL(cl);
 
     // command loop
-    keep_going = 0;
     while (keep_going == 0)
     {
-        // clear CL
-        clear_CL(&cl);
-
-        // check background
-        pid_check_CL(&cl);
+        // check background, start what came due during the last line
+        pid_check_CL(cl);
+        sched_CL(cl);
 
         // get commands
-        if (get_input(&cl, in_buff, IN_BUFF_SIZE) != 0) { continue; };
+        result = get_input(cl, NULL, in_buff, IN_BUFF_SIZE);
+        if (result == -1) { break; }
+        if (result != 0) { continue; }
+        strcpy(text, in_buff);
+
+        // here-documents and compound commands take the lines that follow
+        while (pending_CL(cl, text) > 0 &&
+               get_input(cl, "> ", in_buff, IN_BUFF_SIZE) != -1)
+        {
+            text_len = strlen(text);
+            if (text_len + strlen(in_buff) + 2 > (size_t) text_size)
+            {
+                text_size = 2 * (text_len + strlen(in_buff) + 2);
+                text = realloc(text, text_size * sizeof(char));
+            }
+            sprintf(text + text_len, "\n%s", in_buff);
+        }
 
-        // run commands
-        keep_going = run_CL(&cl, in_buff);
+        // run commands (only stop if exiting)
+        keep_going = run_CL(cl, text);
+        if (keep_going > 0) { keep_going = 0; }
     }
 
     // destroy command line
-    free_CL(&cl);
+    delete_CL(cl);
 
-    // free input buffer
+    // free input buffers
     free(in_buff);
+    free(text);
 
-    // return (last exit status if child)
-    return (cl.is_child) ? (cl.fg_status) : (0);
+    // return
+    return 0;
 }
@@ -0,0 +1,60 @@
+/*
+ * library  -   libsmallsh (public interface)
+ * author   -   Nicholas Olson
+ *
+ * The parse/execute engine of smallsh as a library. A session holds its
+ * own args, jobs, status, history and variables, but the working
+ * directory and the environment are the process's ("cd" calls chdir and
+ * setenv, as exporting a variable does), so sessions must not share a
+ * process: run each in a process of its own (as the daemon's workers
+ * are). CL_INTERACTIVE and CL_SIGNALS take over SIGCHLD, SIGINT and
+ * SIGTSTP.
+ */
+
+#ifndef SMALLSH_H
+#define SMALLSH_H
+
+
+/*** defines ***/
+/* session flags for new_CL */
+#define CL_INTERACTIVE 1    // route signals through the session, read stdin
+#define CL_CAPTURE     2    // capture background output (see "jobs -o")
+#define CL_SIGNALS     4    // route signals through the session, no stdin
+#define CL_ZYGOTE      8    // launch commands from a pre-forked helper
+#define CL_JOBCTL     16    // job control (process groups, stop and resume)
+
+
+/*** structs ***/
+/* a session (opaque) */
+struct CL;
+
+/* callback for watch_CL */
+typedef int (*watch_fn)(struct CL*, int, void*);
+
+/* background job as seen through job_CL */
+struct CL_JOB {
+    int id;             // job number (%n)
+    int pid;            // process id
+    int done;           // process has exited
+    int stopped;        // process is stopped (see "fg" and "bg")
+    const char * cmd;   // command line that started the job
+};
+
+
+/*** interface prototypes ***/
+struct CL * new_CL(int);                // create a session (CL_* flags)
+void delete_CL(struct CL*);             // destroy a session
+int run_CL(struct CL*, char*);          // parse and execute line of command
+int pending_CL(struct CL*, char*);      // here-documents, blocks missing lines
+char * prompt_CL(struct CL*);           // render prompt (never waits)
+int status_CL(struct CL*, int*);        // last fg status, sets if signaled
+int job_CL(struct CL*, int, struct CL_JOB*); // get job at index (-1 if none)
+int fd_CL(struct CL*);                  // fd that is readable when events wait
+int poll_CL(struct CL*, int);           // handle events, wait up to ms
+int watch_CL(struct CL*, int, watch_fn, void*); // call back when fd is readable
+int unwatch_CL(struct CL*, int);        // stop watching fd
+int pid_check_CL(struct CL*);           // checks the statuses of all bg pids
+int sched_CL(struct CL*);               // start scheduled commands that are due
+int rc_CL(struct CL*);                  // run startup file (or its snapshot)
+
+#endif
@@ -0,0 +1,159 @@
+/*
+ * library  -   libsmallsh (session statistics)
+ * author   -   Nicholas Olson
+ *
+ * Counters and latency histograms kept by every session. Updating them is
+ * a few additions, so they are always on. Histograms have one bucket per
+ * power of two microseconds, percentiles are reported as the upper bound
+ * of the bucket they fall in.
+ */
+
+/*** includes ***/
+#include <stdlib.h>     // std library stuff
+#include <stdio.h>      // I/O stuff
+#include <string.h>     // for strlen
+#include <time.h>       // for clock_gettime
+#include <malloc.h>     // for mallinfo2
+#include <unistd.h>     // for getpid
+#include "libsmallsh.h" // private interface
+
+
+/*** hidden methods ***/
+/* microseconds on the monotonic clock */
+long _now_us()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000L + ts.tv_nsec / 1000;
+}
+
+/* add a sample of us microseconds to the histogram */
+void _hist_add(struct HIST * hist, long us)
+{
+    int b = 0;
+
+    if (us < 0) { us = 0; }
+    while ((1L << b) <= us && b < HIST_BUCKETS - 1) { b++; }
+
+    hist->bucket[b]++;
+    hist->count++;
+    hist->total_us += us;
+}
+
+/* upper bound in us of the bucket holding the pct percentile (0 if empty) */
+long _hist_pct(struct HIST * hist, int pct)
+{
+    unsigned long seen = 0;
+    int b;
+
+    if (hist->count == 0) { return 0; }
+    for (b = 0; b < HIST_BUCKETS; b++)
+    {
+        seen += hist->bucket[b];
+        if (seen * 100 >= hist->count * pct) { break; }
+    }
+    return 1L << b;
+}
+
+/* print a histogram as a line of the stats table */
+void _hist_print(char * name, struct HIST * hist, FILE * out)
+{
+    fprintf(out, "%-14s %8lu  avg %8luus  p50 <%lu  p90 <%lu  p99 <%lu\n",
+            name, hist->count,
+            hist->count ? hist->total_us / hist->count : 0,
+            _hist_pct(hist, 50), _hist_pct(hist, 90), _hist_pct(hist, 99));
+}
+
+/* print a histogram as a json object */
+void _hist_json(char * name, struct HIST * hist, FILE * out)
+{
+    int last = HIST_BUCKETS - 1;
+    int b;
+
+    // trailing empty buckets are left out
+    while (last > 0 && hist->bucket[last] == 0) { last--; }
+
+    fprintf(out, "\"%s\":{\"count\":%lu,\"total_us\":%lu,\"buckets\":[",
+            name, hist->count, hist->total_us);
+    for (b = 0; b <= last; b++)
+    {
+        fprintf(out, "%s%lu", b ? "," : "", hist->bucket[b]);
+    }
+    fputs("]}", out);
+}
+
+/* bytes of history kept */
+long _hist_bytes(struct CL * cl)
+{
+    return (long) cl->hist_used - cl->hist_dead;
+}
+
+/* print the session's statistics as a table */
+int _stats_print(struct CL * cl, FILE * out)
+{
+    struct STATS * st = &cl->stats;
+    unsigned long lookups = st->cache_hits + st->cache_misses;
+
+    fprintf(out, "%-14s %8lu  (%lu built-in, %lu external, %lu function calls)\n", "commands",
+            st->builtins + st->externals, st->builtins, st->externals, st->func_calls);
+    _hist_print("parse", &st->parse, out);
+    _hist_print("launch", &st->launch, out);
+    _hist_print("run", &st->run, out);
+    fprintf(out, "%-14s %8.1fs\n", "executing", st->exec_us / 1e6);
+    fprintf(out, "%-14s %8.1fs\n", "at prompt", st->prompt_us / 1e6);
+    fprintf(out, "%-14s %8lu  (%lu reaped, %lu running)\n", "jobs",
+            st->jobs_started, st->jobs_reaped, st->jobs_started - st->jobs_reaped);
+    fprintf(out, "%-14s %8d  (%ld bytes, %u in pool)\n", "history", cl->hist_live,
+            _hist_bytes(cl), cl->hist_pool_size);
+    fprintf(out, "%-14s %8lu  bytes in use\n", "heap",
+            (unsigned long) mallinfo2().uordblks);
+    fprintf(out, "%-14s %8lu  (%lu hits, %.1f%%)\n", "command cache",
+            lookups, st->cache_hits, lookups ? 100.0 * st->cache_hits / lookups : 0.0);
+    fprintf(out, "%-14s %8lu  (%lu by zygote)\n", "launches",
+            st->zygote_launches + st->fork_launches, st->zygote_launches);
+
+    return 0;
+}
+
+/* print the session's statistics as one line of json */
+int _stats_json(struct CL * cl, FILE * out)
+{
+    struct STATS * st = &cl->stats;
+
+    fprintf(out, "{\"pid\":%d,\"commands\":%lu,\"builtins\":%lu,\"externals\":%lu,\"func_calls\":%lu,",
+            (int) getpid(), st->builtins + st->externals, st->builtins, st->externals, st->func_calls);
+    _hist_json("parse", &st->parse, out);
+    fputc(',', out);
+    _hist_json("launch", &st->launch, out);
+    fputc(',', out);
+    _hist_json("run", &st->run, out);
+    fprintf(out, ",\"exec_us\":%lu,\"prompt_us\":%lu", st->exec_us, st->prompt_us);
+    fprintf(out, ",\"jobs_started\":%lu,\"jobs_reaped\":%lu",
+            st->jobs_started, st->jobs_reaped);
+    fprintf(out, ",\"history\":%d,\"history_bytes\":%ld,\"history_pool\":%u",
+            cl->hist_live, _hist_bytes(cl), cl->hist_pool_size);
+    fprintf(out, ",\"heap_bytes\":%lu", (unsigned long) mallinfo2().uordblks);
+    fprintf(out, ",\"cache_hits\":%lu,\"cache_misses\":%lu",
+            st->cache_hits, st->cache_misses);
+    fprintf(out, ",\"zygote_launches\":%lu,\"fork_launches\":%lu}\n",
+            st->zygote_launches, st->fork_launches);
+
+    return 0;
+}
+
+/* append a json snapshot of the statistics to the file named by the
+ * SMALLSH_STATS environment variable (if set) */
+int _stats_snapshot(struct CL * cl)
+{
+    char * path = getenv(STATS_ENV);
+    FILE * out;
+
+    if (path == NULL || path[0] == '\0') { return 0; }
+    if ((out = fopen(path, "a")) == NULL) { return -1; }
+
+    _stats_json(cl, out);
+    fclose(out);
+
+    return 0;
+}
@@ -0,0 +1,244 @@
+/*
+ * library  -   libsmallsh (command suggestions)
+ * author   -   Nicholas Olson
+ *
+ * When a command isn't found the closest name (edit distance) among the
+ * built-ins and the commands in PATH is suggested. The names are kept in
+ * BK-trees, where a node's kids are filed by their distance to it, so a
+ * lookup only compares the names whose distance can still be in range
+ * instead of every name. There is a tree per PATH directory, built the
+ * first time a command isn't found and built again only if the
+ * directory's mtime changes, so nothing is done for commands that are.
+ */
+
+/*** includes ***/
+#include <stdlib.h>     // std library stuff
+#include <string.h>     // for strlen, strcmp, memcpy
+#include <dirent.h>     // for reading PATH directories
+#include <sys/stat.h>   // for stat
+#include "libsmallsh.h" // private interface
+
+
+/*** hidden methods ***/
+/* closest name to name (which wasn't found) among the built-ins and the
+ * commands in PATH, a swap of two bytes settles ties, then those found
+ * first win
+ * post-condition:  returned name (the caller's), NULL if none is close */
+char * _suggest(struct CL * cl, char * name)
+{
+    // declarations
+    struct BKTREE * tree;
+    struct stat st;
+    char * best = NULL;
+    long long mtime;
+    int len = strlen(name);
+    int dist;
+    int i;
+
+    // short names are close to too much
+    if (len < 2 || len > SUGGEST_NAME_MAX) { return NULL; }
+    dist = (len <= 3) ? 1 : SUGGEST_DIST;
+
+    if (cl->suggest_builtins == NULL)
+    {
+        cl->suggest_builtins = _bk_new();
+        for (i = 0; _builtin_name(i) != NULL; i++) { _bk_add(cl->suggest_builtins, _builtin_name(i)); }
+    }
+    _bk_find(cl->suggest_builtins, name, &best, &dist);
+
+    // directories that changed since their tree was built
+    _need_path(cl);
+    for (i = 0; i < cl->path_len; i++)
+    {
+        if (stat(cl->path[i], &st) == -1) { continue; }
+        mtime = st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+        if ((tree = _hash_get(&cl->suggest_dirs, cl->path[i])) == NULL || tree->mtime != mtime)
+        {
+            _bk_free(tree);
+            tree = _bk_dir(cl->path[i]);
+            tree->mtime = mtime;
+            _hash_put(&cl->suggest_dirs, cl->path[i], tree);
+        }
+        _bk_find(tree, name, &best, &dist);
+    }
+
+    return (best != NULL) ? strdup(best) : NULL;
+}
+
+/* empty tree */
+struct BKTREE * _bk_new()
+{
+    struct BKTREE * tree = malloc(sizeof(struct BKTREE));
+
+    tree->pool_size = 1024;
+    tree->pool_len = 0;
+    tree->pool = malloc(tree->pool_size);
+    tree->size = 64;
+    tree->len = 0;
+    tree->nodes = malloc(tree->size * sizeof(struct BK_NODE));
+    tree->mtime = 0;
+    return tree;
+}
+
+/* tree of the commands in dir (its files, not looked at closer) */
+struct BKTREE * _bk_dir(char * dir)
+{
+    struct BKTREE * tree = _bk_new();
+    struct dirent * de;
+    DIR * d;
+
+    if ((d = opendir(dir)) == NULL) { return tree; }
+    while ((de = readdir(d)) != NULL)
+    {
+        if (de->d_name[0] == '.' || de->d_type == DT_DIR) { continue; }
+        _bk_add(tree, de->d_name);
+    }
+    closedir(d);
+
+    return tree;
+}
+
+/* add name to tree, under the kid at its distance from each node on the
+ * way down (names already in it, and long ones, are left out) */
+void _bk_add(struct BKTREE * tree, char * name)
+{
+    // declarations
+    struct BK_NODE * node;
+    int len = strlen(name);
+    int dist = 0;
+    int at = 0;
+    int kid;
+
+    if (len > SUGGEST_NAME_MAX) { return; }
+
+    // where it goes
+    while (tree->len > 0)
+    {
+        dist = _bk_dist(name, tree->pool + tree->nodes[at].name, 0);
+        if (dist == 0) { return; }
+        for (kid = tree->nodes[at].kid; kid != 0 && (int) tree->nodes[kid].dist != dist;
+             kid = tree->nodes[kid].next) { }
+        if (kid == 0) { break; }
+        at = kid;
+    }
+
+    // check if tree needs to grow
+    if (tree->pool_len + len + 1 > tree->pool_size)
+    {
+        while (tree->pool_len + len + 1 > tree->pool_size) { tree->pool_size *= 2; }
+        tree->pool = realloc(tree->pool, tree->pool_size);
+    }
+    if (tree->len == tree->size)
+    {
+        tree->size *= 2;
+        tree->nodes = realloc(tree->nodes, tree->size * sizeof(struct BK_NODE));
+    }
+
+    node = &tree->nodes[tree->len];
+    node->name = tree->pool_len;
+    node->kid = 0;
+    node->next = 0;
+    node->dist = 0;
+    memcpy(tree->pool + tree->pool_len, name, len + 1);
+    tree->pool_len += len + 1;
+
+    // first kid of at (the root is nobody's)
+    if (tree->len > 0)
+    {
+        node->dist = dist;
+        node->next = tree->nodes[at].kid;
+        tree->nodes[at].kid = tree->len;
+    }
+    tree->len++;
+}
+
+/* look for a name no further from name than *dist (but not name itself)
+ * and closer than *best, or as close but with fewer edits if swaps count
+ * as one, *dist is updated with *best if one is found */
+void _bk_find(struct BKTREE * tree, char * name, char ** best, int * dist)
+{
+    // declarations
+    char * cand;
+    int * stack;
+    int top = 0;
+    int at;
+    int d;
+    int kid;
+
+    if (tree == NULL || tree->len == 0) { return; }
+
+    // only kids within *dist of the node's distance can be as close (a
+    // node is on the stack once at most)
+    stack = malloc(tree->len * sizeof(int));
+    stack[top++] = 0;
+    while (top > 0)
+    {
+        at = stack[--top];
+        cand = tree->pool + tree->nodes[at].name;
+        d = _bk_dist(name, cand, 0);
+        if (d > 0 && d <= *dist && (*best == NULL || d < *dist ||
+                                    _bk_dist(name, cand, 1) < _bk_dist(name, *best, 1)))
+        {
+            *dist = d;
+            *best = cand;
+        }
+
+        for (kid = tree->nodes[at].kid; kid != 0; kid = tree->nodes[kid].next)
+        {
+            if ((int) tree->nodes[kid].dist < d - *dist || (int) tree->nodes[kid].dist > d + *dist) { continue; }
+            stack[top++] = kid;
+        }
+    }
+
+    free(stack);
+}
+
+/* edit distance (insertions, deletions and substitutions) of a and b,
+ * with swaps of adjacent bytes as one edit too if swaps is set (no
+ * longer a metric, so only to order names the tree found)
+ * pre-condition:   neither is longer than SUGGEST_NAME_MAX */
+int _bk_dist(char * a, char * b, int swaps)
+{
+    // declarations
+    int rows[3][SUGGEST_NAME_MAX + 1];
+    int * last2;
+    int * last = rows[0];
+    int * row = rows[1];
+    int la = strlen(a);
+    int lb = strlen(b);
+    int i, j;
+
+    // row of b against the first i bytes of a, from the two before it
+    for (j = 0; j <= lb; j++) { row[j] = j; }
+    for (i = 1; i <= la; i++)
+    {
+        last2 = last;
+        last = row;
+        row = rows[(i + 1) % 3];
+        row[0] = i;
+        for (j = 1; j <= lb; j++)
+        {
+            row[j] = last[j - 1] + (a[i - 1] != b[j - 1]);
+            if (last[j] + 1 < row[j])    { row[j] = last[j] + 1; }
+            if (row[j - 1] + 1 < row[j]) { row[j] = row[j - 1] + 1; }
+            if (swaps && i > 1 && j > 1 && a[i - 1] == b[j - 2] && a[i - 2] == b[j - 1] &&
+                last2[j - 2] + 1 < row[j])
+            {
+                row[j] = last2[j - 2] + 1;
+            }
+        }
+    }
+
+    return row[lb];
+}
+
+/* free a tree (NULL is ignored) */
+void _bk_free(void * ptr)
+{
+    struct BKTREE * tree = ptr;
+
+    if (tree == NULL) { return; }
+    free(tree->pool);
+    free(tree->nodes);
+    free(tree);
+}
@@ -0,0 +1,452 @@
+/*
+ * library  -   libsmallsh (task runner)
+ * author   -   Nicholas Olson
+ *
+ * "tasks" runs the tasks of a task file in dependency order, as many at
+ * once as it is allowed to. The file is a list of tasks, each a line
+ * "name: deps ..." followed by its commands, indented:
+ *
+ *   app: main.o util.o
+ *       cc -o app main.o util.o
+ *   main.o: main.c
+ *       cc -c main.c
+ *
+ * A task starts as soon as the tasks it depends on are done, its commands
+ * run one after the other as background jobs (each only if the last one
+ * succeeded), so the runner itself just waits on the event loop. A task
+ * whose name is a file newer than every file it depends on, and none of
+ * whose dependencies ran, is up to date and skipped. After a failure no
+ * new task is started, the running ones are waited for.
+ */
+
+/*** includes ***/
+#include <stdlib.h>     // std library stuff
+#include <stdio.h>      // I/O stuff
+#include <unistd.h>     // for sysconf
+#include <string.h>     // for strcmp, strtok_r
+#include <sys/stat.h>   // for file mtimes
+#include <sys/wait.h>   // for exit statuses of jobs
+#include "libsmallsh.h" // private interface
+
+
+/*** hidden methods ***/
+/* run the needed tasks of ts, waiting for their jobs on the event loop,
+ * then report what happened and the critical path
+ * post-condition:  returned 1 if a task failed, 0 otherwise */
+int _tasks_run(struct CL * cl, struct TASKS * ts)
+{
+    // declarations
+    int block_mode = cl->bg_block_mode;
+    long start = _now_us();
+    char took[32];
+    int last = -1;
+    int left = 0;
+    int i;
+
+    // commands are jobs even in foreground only mode, input waits till after
+    cl->bg_block_mode = 0;
+    _ev_input(cl, 0);
+
+    _tasks_start(cl, ts);
+    while (ts->running > 0)
+    {
+        // (without signals or pidfds, exits are only noticed every tick)
+        _ev_wait(cl, (cl->sig_fd == -1) ? WHEEL_TICK_MS : -1);
+        pid_check_CL(cl);
+        if (_tasks_reap(cl, ts) > 0) { _tasks_start(cl, ts); }
+    }
+
+    _ev_input(cl, 1);
+    cl->bg_block_mode = block_mode;
+
+    // what ran, and the longest chain of it
+    for (i = 0; i < ts->len; i++)
+    {
+        if (ts->tasks[i].state == TASK_WAITING) { left++; }
+        if ((ts->tasks[i].state == TASK_DONE || ts->tasks[i].state == TASK_FAILED) &&
+            (last == -1 || ts->tasks[i].path_us > ts->tasks[last].path_us)) { last = i; }
+    }
+
+    fflush(stdout);
+    printf("tasks: %d run, %d up to date", ts->ran, ts->fresh);
+    if (ts->failed > 0) { printf(", %d failed, %d not run", ts->failed, left); }
+    printf(" in %s", _sched_fmt(took, _now_us() - start));
+    if (last != -1)
+    {
+        printf(", critical path %s: ", _sched_fmt(took, ts->tasks[last].path_us));
+        _tasks_path(ts, last);
+    }
+    putchar('\n');
+    fflush(stdout);
+
+    return ts->failed > 0;
+}
+
+/* read the task file at path into ts
+ * post-condition:  returned 1 on error (reported), 0 otherwise */
+int _tasks_load(struct TASKS * ts, char * path)
+{
+    // declarations
+    struct TASK * task = NULL;
+    FILE * file;
+    char * line = NULL;
+    char * word;
+    char * save;
+    char * colon;
+    size_t size = 0;
+    ssize_t len;
+    int num = 0;
+    int err = 0;
+
+    if ((file = fopen(path, "r")) == NULL)
+    {
+        fprintf(stderr, "smallsh: tasks: ");
+        perror(path);
+        return 1;
+    }
+
+    while (!err && (len = getline(&line, &size, file)) != -1)
+    {
+        num++;
+        if (len > 0 && line[len - 1] == '\n') { line[--len] = '\0'; }
+        for (word = line; *word == ' ' || *word == '\t'; word++) { }
+        if (*word == '\0' || *word == '#') { continue; }
+
+        // indented, a command of the task above
+        if (word != line)
+        {
+            if (task == NULL) { err = 1; break; }
+            task->lines = realloc(task->lines, (task->num_lines + 1) * sizeof(char*));
+            task->lines[task->num_lines++] = strdup(word);
+            continue;
+        }
+
+        // "name: deps ..."
+        if ((colon = strchr(line, ':')) == NULL) { err = 1; break; }
+        *colon = '\0';
+        if ((word = strtok_r(line, " \t", &save)) == NULL || strtok_r(NULL, " \t", &save) != NULL)
+        {
+            err = 1;
+            break;
+        }
+        if (_hash_get(&ts->names, word) != NULL)
+        {
+            fprintf(stderr, "smallsh: tasks: %s:%d: %s: defined twice\n", path, num, word);
+            err = 2;
+            break;
+        }
+
+        // check if task list needs to grow
+        if (ts->len == ts->size)
+        {
+            ts->size = ts->size ? ts->size * 2 : 8;
+            ts->tasks = realloc(ts->tasks, ts->size * sizeof(struct TASK));
+        }
+        task = &ts->tasks[ts->len];
+        memset(task, 0, sizeof(struct TASK));
+        task->name = strdup(word);
+        task->path_dep = -1;
+        for (word = strtok_r(colon + 1, " \t", &save); word != NULL; word = strtok_r(NULL, " \t", &save))
+        {
+            task->deps = realloc(task->deps, (task->num_deps + 1) * sizeof(char*));
+            task->deps[task->num_deps++] = strdup(word);
+        }
+        _hash_put(&ts->names, task->name, (void *) (long) ++ts->len);
+    }
+
+    if (err == 1) { fprintf(stderr, "smallsh: tasks: %s:%d: \"name: deps ...\" expected\n", path, num); }
+    if (err) { fflush(stderr); }
+    free(line);
+    fclose(file);
+
+    return err != 0;
+}
+
+/* free the tasks of ts */
+void _tasks_free(struct TASKS * ts)
+{
+    int i, j;
+
+    for (i = 0; i < ts->len; i++)
+    {
+        for (j = 0; j < ts->tasks[i].num_deps; j++)  { free(ts->tasks[i].deps[j]); }
+        for (j = 0; j < ts->tasks[i].num_lines; j++) { free(ts->tasks[i].lines[j]); }
+        free(ts->tasks[i].deps);
+        free(ts->tasks[i].lines);
+        free(ts->tasks[i].name);
+    }
+    free(ts->tasks);
+    _hash_free(&ts->names, NULL);
+}
+
+/* index of the task called name (-1 if there is none) */
+int _tasks_find(struct TASKS * ts, char * name)
+{
+    return (int) (long) _hash_get(&ts->names, name) - 1;
+}
+
+/* mark task idx and everything it depends on as needed, counting the
+ * tasks each one waits for (depth first, "on" marks the way down)
+ * post-condition:  returned 1 on error (reported), 0 otherwise */
+int _tasks_need(struct TASKS * ts, int idx)
+{
+    struct TASK * task = &ts->tasks[idx];
+    struct stat st;
+    int dep;
+    int i;
+
+    if (task->state == TASK_ON)
+    {
+        fprintf(stderr, "smallsh: tasks: %s: depends on itself\n", task->name);
+        return 1;
+    }
+    if (task->state != TASK_UNSEEN) { return 0; }
+
+    task->state = TASK_ON;
+    for (i = 0; i < task->num_deps; i++)
+    {
+        if ((dep = _tasks_find(ts, task->deps[i])) == -1)
+        {
+            // not a task, a file that has to be there
+            if (stat(task->deps[i], &st) == 0) { continue; }
+            fprintf(stderr, "smallsh: tasks: %s: %s: no such task or file\n", task->name, task->deps[i]);
+            return 1;
+        }
+        if (_tasks_need(ts, dep) != 0) { return 1; }
+        task->waiting++;
+    }
+    task->state = TASK_WAITING;
+
+    return 0;
+}
+
+/* task is up to date, its name is a file newer than the files it
+ * depends on and none of the tasks it depends on ran */
+int _tasks_fresh(struct TASKS * ts, struct TASK * task)
+{
+    struct stat st;
+    long long mtime;
+    int dep;
+    int i;
+
+    if (stat(task->name, &st) != 0) { return 0; }
+    mtime = st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+
+    for (i = 0; i < task->num_deps; i++)
+    {
+        dep = _tasks_find(ts, task->deps[i]);
+        if (dep != -1 && ts->tasks[dep].state != TASK_FRESH) { return 0; }
+        if (stat(task->deps[i], &st) == 0 &&
+            st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec > mtime) { return 0; }
+    }
+
+    return 1;
+}
+
+/* start the next command of task as a background job (built-ins run in
+ * the shell, and are done right away)
+ * post-condition:  returned 1 if a job runs it, 0 if it is done, -1 if
+ *                  it failed */
+int _tasks_line(struct CL * cl, struct TASK * task)
+{
+    // declarations
+    struct NODE * tree;
+    char ** words;
+    char * copy = strdup(task->lines[task->line]);
+    char * word;
+    char * save;
+    int job_len = cl->job_len;
+    int num = 0;
+
+    fflush(stdout);
+    printf("[%s] %s\n", task->name, task->lines[task->line]);
+    fflush(stdout);
+
+    // the command's words and "&"
+    words = malloc((strlen(copy) / 2 + 3) * sizeof(char*));
+    for (word = strtok_r(copy, " \t", &save); word != NULL; word = strtok_r(NULL, " \t", &save))
+    {
+        words[num++] = word;
+    }
+    words[num++] = "&";
+    words[num] = NULL;
+
+    // one simple command
+    cl->fg_ran = 0;
+    tree = _ast_parse(words, num);
+    if (tree != NULL && (tree->type != NODE_LIST || tree->kids == NULL ||
+                         tree->kids->next != NULL || tree->kids->type != NODE_CMD))
+    {
+        fprintf(stderr, "smallsh: tasks: %s: a command line is one command\n", task->name);
+        fflush(stderr);
+        _ast_free(tree);
+        tree = NULL;
+    }
+    if (tree == NULL) { free(words); free(copy); return -1; }
+
+    cl->bg_quiet = 1;
+    _ast_run(cl, words, tree);
+    cl->bg_quiet = 0;
+    _ast_free(tree);
+    free(words);
+    free(copy);
+
+    // a job, kept once done until its status is read
+    if (cl->job_len > job_len)
+    {
+        task->pid = cl->jobs[cl->job_len - 1].pid;
+        cl->jobs[cl->job_len - 1].helper = 1;
+        cl->jobs[cl->job_len - 1].waited = 1;
+        return 1;
+    }
+
+    task->pid = 0;
+    return _status_ok(cl) ? 0 : -1;
+}
+
+/* task is done with (state says how), its dependents waiting on one task
+ * less, the critical path through it is known */
+void _tasks_end(struct TASKS * ts, int idx, int state, long now)
+{
+    struct TASK * task = &ts->tasks[idx];
+    struct TASK * other;
+    int i, j;
+
+    task->state = state;
+    task->end_us = now;
+    task->path_us += (state == TASK_FRESH) ? 0 : now - task->start_us;
+    ts->running -= (state != TASK_FRESH);
+
+    for (i = 0; i < ts->len; i++)
+    {
+        other = &ts->tasks[i];
+        if (other->state != TASK_WAITING) { continue; }
+        for (j = 0; j < other->num_deps; j++)
+        {
+            if (strcmp(other->deps[j], task->name) != 0) { continue; }
+            other->waiting--;
+
+            // longest chain of work leading to it
+            if (task->path_us >= other->path_us)
+            {
+                other->path_us = task->path_us;
+                other->path_dep = idx;
+            }
+        }
+    }
+}
+
+/* start the tasks whose dependencies are done, up to the limit
+ * post-condition:  returned number of tasks that failed to start */
+int _tasks_start(struct CL * cl, struct TASKS * ts)
+{
+    struct TASK * task;
+    int failed = 0;
+    int result;
+    int i;
+
+    for (i = 0; i < ts->len && !ts->failed; i++)
+    {
+        task = &ts->tasks[i];
+        if (task->state != TASK_WAITING || task->waiting > 0) { continue; }
+
+        // up to date, its dependents may be ready now too (look again)
+        if (_tasks_fresh(ts, task))
+        {
+            _tasks_end(ts, i, TASK_FRESH, _now_us());
+            ts->fresh++;
+            i = -1;
+            continue;
+        }
+        if (ts->running == ts->max) { break; }
+
+        // its commands in order, until one is a job
+        task->state = TASK_RUNNING;
+        task->start_us = _now_us();
+        ts->running++;
+        ts->ran++;
+        for (task->line = 0, result = 0; task->line < task->num_lines; task->line++)
+        {
+            if ((result = _tasks_line(cl, task)) != 0) { break; }
+        }
+        if (result == 1) { continue; }
+
+        // done (or failed) without a job
+        _tasks_end(ts, i, result == 0 ? TASK_DONE : TASK_FAILED, _now_us());
+        if (result == -1) { ts->failed++; failed++; }
+        i = -1;
+    }
+
+    return failed;
+}
+
+/* read the status of jobs of running tasks that are done, going on with
+ * their next commands
+ * post-condition:  returned number of tasks that ended */
+int _tasks_reap(struct CL * cl, struct TASKS * ts)
+{
+    // declarations
+    struct TASK * task;
+    struct JOB * job;
+    int ended = 0;
+    int result;
+    int ok;
+    int i, j;
+
+    for (i = 0; i < ts->len; i++)
+    {
+        task = &ts->tasks[i];
+        if (task->state != TASK_RUNNING || task->pid == 0) { continue; }
+
+        for (j = 0; j < cl->job_len && cl->jobs[j].pid != task->pid; j++) { }
+        if (j == cl->job_len) { ok = 0; }
+        else
+        {
+            job = &cl->jobs[j];
+            if (!job->done) { continue; }
+            ok = WIFEXITED(job->status) && WEXITSTATUS(job->status) == 0;
+            if (!ok)
+            {
+                fprintf(stderr, "smallsh: tasks: %s: %s %d\n", task->name,
+                        WIFEXITED(job->status) ? "exit value" : "terminated by signal",
+                        WIFEXITED(job->status) ? WEXITSTATUS(job->status) : WTERMSIG(job->status));
+                fflush(stderr);
+            }
+            _remove_job(cl, j);
+        }
+
+        // next command, unless it failed
+        result = ok ? 0 : -1;
+        task->pid = 0;
+        while (result == 0 && ++task->line < task->num_lines)
+        {
+            result = _tasks_line(cl, task);
+        }
+        if (result == 1) { continue; }
+
+        _tasks_end(ts, i, result == 0 ? TASK_DONE : TASK_FAILED, _now_us());
+        if (result == -1) { ts->failed++; }
+        ended++;
+    }
+
+    return ended;
+}
+
+/* print the chain of tasks that took longest, ending at task idx */
+void _tasks_path(struct TASKS * ts, int idx)
+{
+    if (ts->tasks[idx].path_dep != -1)
+    {
+        _tasks_path(ts, ts->tasks[idx].path_dep);
+        fputs(" -> ", stdout);
+    }
+    fputs(ts->tasks[idx].name, stdout);
+}
+
+/* number of tasks run at once unless "-j" says otherwise */
+int _tasks_jobs()
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return (n > 0) ? n : 1;
+}
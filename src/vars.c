@@ -0,0 +1,230 @@
+/*
+ * library  -   libsmallsh (shell variables)
+ * author   -   Nicholas Olson
+ *
+ * Shell variables, kept in a hash table by name, and the "$" expansion of
+ * the words of a command. A command made only of "name=value" words sets
+ * variables; a variable already in the environment is set there instead,
+ * so commands started later see it. Words are expanded each time their
+ * command runs (a loop body sees the new value on every pass), into copies
+ * so the parsed line stays as it was. "$(( expr ))" is evaluated in the
+ * shell (see arith.c), without starting a process.
+ */
+
+/*** includes ***/
+#include <stdlib.h>     // std library stuff
+#include <stdio.h>      // I/O stuff
+#include <string.h>     // for strcmp, strdup
+#include <ctype.h>      // for isalpha, isalnum
+#include <inttypes.h>   // for PRId64
+#include "libsmallsh.h" // private interface
+
+
+/*** hidden methods ***/
+/* length of the variable name s starts with (0 if it doesn't) */
+int _var_name_len(char * s)
+{
+    int len = 0;
+
+    if (!isalpha((unsigned char) s[0]) && s[0] != '_') { return 0; }
+    while (isalnum((unsigned char) s[len]) || s[len] == '_') { len++; }
+    return len;
+}
+
+/* set the variable name to (a copy of) value */
+int _var_set(struct CL * cl, char * name, char * value)
+{
+    // commands are looked for through PATH, it is always exported
+    if (strcmp(name, "PATH") == 0)
+    {
+        setenv(name, value, 1);
+        _path_changed(cl);
+        return 0;
+    }
+    if (getenv(name) != NULL) { return setenv(name, value, 1); }
+
+    free(_hash_put(&cl->vars, name, strdup(value)));
+    return 0;
+}
+
+/* value of the variable name, from the shell's own or the environment
+ * post-condition:  returned "" if it isn't set */
+char * _var_get(struct CL * cl, char * name)
+{
+    char * value;
+
+    if ((value = _hash_get(&cl->vars, name)) != NULL) { return value; }
+    if ((value = getenv(name)) != NULL) { return value; }
+    return "";
+}
+
+/* set variables if all n words are "name=value"
+ * post-condition:  returned 1 if they were (and are set), 0 if not */
+int _assign_words(struct CL * cl, char ** words, int n)
+{
+    int len;
+    int i;
+
+    // all or nothing, "a=1 cmd" is a command
+    for (i = 0; i < n; i++)
+    {
+        len = _var_name_len(words[i]);
+        if (len == 0 || words[i][len] != '=') { return 0; }
+    }
+
+    for (i = 0; i < n; i++)
+    {
+        len = _var_name_len(words[i]);
+        words[i][len] = '\0';
+        _var_set(cl, words[i], words[i] + len + 1);
+        words[i][len] = '=';
+    }
+
+    return n > 0;
+}
+
+/* copy of the n words with "$" expanded in each (a word that is just "$@"
+ * becomes one word per parameter, here-document text is left as it is)
+ * post-condition:  returned malloc'd NULL terminated array of malloc'd
+ *                  words, its length in *len */
+char ** _expand_words(struct CL * cl, char ** words, int n, int * len)
+{
+    // declarations
+    char ** out;
+    int size = n + 1;
+    int i, j;
+
+    for (i = 0; i < n; i++)
+    {
+        if (strcmp(words[i], "$@") == 0) { size += cl->num_params; }
+    }
+    out = malloc(size * sizeof(char*));
+
+    *len = 0;
+    for (i = 0; i < n; i++)
+    {
+        if (i > 0 && strcmp(words[i-1], "<<") == 0) { out[(*len)++] = strdup(words[i]); }
+        else if (strcmp(words[i], "$@") == 0)
+        {
+            for (j = 1; j < cl->num_params; j++) { out[(*len)++] = strdup(cl->params[j]); }
+        }
+        else if (strchr(words[i], '$') == NULL) { out[(*len)++] = strdup(words[i]); }
+        else { out[(*len)++] = _expand_word(cl, words[i]); }
+    }
+    out[*len] = NULL;
+
+    return out;
+}
+
+/* copy of word with "$name", "${name}", "$0".."$9", "$#", "$@", "$?" and
+ * "$(( expr ))" replaced by their values ("$" before anything else stays,
+ * cl->expand_err is set if an expression fails)
+ * post-condition:  returned malloc'd string */
+char * _expand_word(struct CL * cl, char * word)
+{
+    // declarations
+    char num[32];
+    char * out;
+    char * val;
+    char * name;
+    int64_t value;
+    int size = strlen(word) + 1;
+    int len = 0;
+    int depth;
+    int need;
+    int skip;
+    int j;
+
+    out = malloc(size);
+    while (*word != '\0')
+    {
+        // value of what follows the "$" (skip chars of the word)
+        val = NULL;
+        skip = 2;
+        if (word[0] != '$') { }
+        else if (word[1] == '(' && word[2] == '(')
+        {
+            // up to the "))" closing it
+            depth = 0;
+            for (j = 1; word[j] != '\0'; j++)
+            {
+                if      (word[j] == '(') { depth++; }
+                else if (word[j] == ')' && --depth == 0) { break; }
+            }
+
+            // "$" in the expression first, then its value
+            if (word[j] == ')' && word[j-1] == ')')
+            {
+                name = strndup(word + 3, j - 4);
+                val = _expand_word(cl, name);
+                free(name);
+                if (_arith_eval(cl, val, &value) == 0) { sprintf(num, "%" PRId64, value); }
+                else                                   { num[0] = '\0'; cl->expand_err = 1; }
+                free(val);
+                val = num;
+                skip = j + 1;
+            }
+        }
+        else if (word[1] >= '0' && word[1] <= '9')
+        {
+            j = word[1] - '0';
+            if (j < cl->num_params) { val = cl->params[j]; }
+            else                    { val = (j == 0) ? "smallsh" : ""; }
+        }
+        else if (word[1] == '#')
+        {
+            sprintf(num, "%d", (cl->num_params > 0) ? cl->num_params - 1 : 0);
+            val = num;
+        }
+        else if (word[1] == '?')
+        {
+            sprintf(num, "%d", _status_code(cl));
+            val = num;
+        }
+        else if (word[1] == '@')
+        {
+            // parameters joined by spaces (a bare "$@" was split already)
+            need = 1;
+            for (j = 1; j < cl->num_params; j++) { need += strlen(cl->params[j]) + 1; }
+            while (len + need >= size) { size *= 2; out = realloc(out, size); }
+            for (j = 1; j < cl->num_params; j++)
+            {
+                len += sprintf(out + len, (j == 1) ? "%s" : " %s", cl->params[j]);
+            }
+            word += 2;
+            continue;
+        }
+        else if (word[1] == '{' && (j = _var_name_len(word + 2)) > 0 && word[2 + j] == '}')
+        {
+            name = strndup(word + 2, j);
+            val = _var_get(cl, name);
+            free(name);
+            skip = j + 3;
+        }
+        else if ((j = _var_name_len(word + 1)) > 0)
+        {
+            name = strndup(word + 1, j);
+            val = _var_get(cl, name);
+            free(name);
+            skip = j + 1;
+        }
+
+        // copy the value, or the char
+        if (val != NULL)
+        {
+            need = strlen(val);
+            while (len + need >= size) { size *= 2; out = realloc(out, size); }
+            memcpy(out + len, val, need);
+            len += need;
+            word += skip;
+        }
+        else
+        {
+            if (len + 1 >= size) { size *= 2; out = realloc(out, size); }
+            out[len++] = *word++;
+        }
+    }
+    out[len] = '\0';
+
+    return out;
+}
@@ -0,0 +1,207 @@
+/*
+ * library  -   libsmallsh (deadline timer wheel)
+ * author   -   Nicholas Olson
+ *
+ * Deadlines of commands run with a timeout. All of them share one
+ * periodic timerfd: each tick advances the wheel by one slot and expires
+ * the deadlines hashed there, so adding, cancelling and expiring a
+ * deadline are O(1) however many jobs have one. A deadline further away
+ * than one turn of the wheel waits out the extra turns in "rounds".
+ */
+
+/*** includes ***/
+#include <stdlib.h>     // std library stuff
+#include <stdio.h>      // I/O stuff
+#include <unistd.h>     // for close
+#include <string.h>     // for memset
+#include <signal.h>     // for kill
+#include <stdint.h>     // for fixed size ints
+#include <math.h>       // for isfinite
+#include <limits.h>     // for LONG_MAX
+#include <sys/epoll.h>  // for the event loop
+#include <sys/timerfd.h>  // for the wheel's tick
+#include "libsmallsh.h" // private interface
+
+
+/*** hidden methods ***/
+/* create the wheel's timerfd and add it to the event loop
+ * pre-condition:   cl->ev_fd is setup */
+int _wheel_setup(struct CL * cl)
+{
+    struct epoll_event ev = {0};
+
+    memset(cl->wheel, 0, sizeof(cl->wheel));
+    cl->wheel_pos = 0;
+    cl->wheel_len = 0;
+    cl->wheel_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+    ev.events = EPOLLIN;
+    ev.data.u64 = EV_WHEEL;
+    return epoll_ctl(cl->ev_fd, EPOLL_CTL_ADD, cl->wheel_fd, &ev);
+}
+
+/* free every deadline still on the wheel and close its timerfd */
+int _wheel_free(struct CL * cl)
+{
+    struct DEADLINE * dl;
+    int i;
+
+    for (i = 0; i < WHEEL_SLOTS; i++)
+    {
+        while ((dl = cl->wheel[i]) != NULL)
+        {
+            _wheel_unlink(cl, dl);
+            free(dl);
+        }
+    }
+    close(cl->wheel_fd);
+
+    return 0;
+}
+
+/* put dl on the wheel to expire in ms milliseconds (or up to a tick
+ * later, never sooner), starting the tick if the wheel was empty */
+int _wheel_link(struct CL * cl, struct DEADLINE * dl, long ms)
+{
+    struct itimerspec its = {0};
+    long ticks = ms / WHEEL_TICK_MS + (ms % WHEEL_TICK_MS != 0);
+    int slot;
+
+    // a running tick may be due any moment, so its first slot only
+    // counts for part of a tick; always at least one tick away, so the
+    // current slot isn't skipped
+    if (cl->wheel_len > 0) { ticks++; }
+    if (ticks < 1) { ticks = 1; }
+    slot = (cl->wheel_pos + ticks) % WHEEL_SLOTS;
+    dl->rounds = (ticks - 1) / WHEEL_SLOTS;
+
+    // push onto slot's list
+    dl->next = cl->wheel[slot];
+    dl->pprev = &cl->wheel[slot];
+    if (dl->next != NULL) { dl->next->pprev = &dl->next; }
+    cl->wheel[slot] = dl;
+
+    // first deadline starts the tick
+    if (cl->wheel_len++ == 0)
+    {
+        its.it_value.tv_nsec = WHEEL_TICK_MS * 1000000L;
+        its.it_interval.tv_nsec = WHEEL_TICK_MS * 1000000L;
+        timerfd_settime(cl->wheel_fd, 0, &its, NULL);
+    }
+
+    return 0;
+}
+
+/* take dl off the wheel, stopping the tick once the wheel is empty */
+int _wheel_unlink(struct CL * cl, struct DEADLINE * dl)
+{
+    struct itimerspec its = {0};
+
+    if (dl->pprev == NULL) { return 0; }
+
+    *dl->pprev = dl->next;
+    if (dl->next != NULL) { dl->next->pprev = dl->pprev; }
+    dl->pprev = NULL;
+    dl->next = NULL;
+
+    // nothing left to expire
+    if (--cl->wheel_len == 0) { timerfd_settime(cl->wheel_fd, 0, &its, NULL); }
+
+    return 0;
+}
+
+/* start a deadline for pid (and its pidfd, which must outlive it), ms
+ * from now
+ * post-condition:  returned deadline is owned by the caller, who must
+ *                  pass it to _wheel_cancel once pid has been reaped */
+struct DEADLINE * _wheel_add(struct CL * cl, int pid, int pidfd, long ms)
+{
+    struct DEADLINE * dl = malloc(sizeof(struct DEADLINE));
+
+    dl->pid = pid;
+    dl->pidfd = pidfd;
+    dl->stage = 0;
+    dl->pprev = NULL;
+    dl->next = NULL;
+    _wheel_link(cl, dl, ms);
+
+    return dl;
+}
+
+/* stop and free a deadline (NULL is ignored) */
+int _wheel_cancel(struct CL * cl, struct DEADLINE * dl)
+{
+    if (dl == NULL) { return 0; }
+
+    _wheel_unlink(cl, dl);
+    free(dl);
+
+    return 0;
+}
+
+/* advance the wheel by the ticks that passed, escalating the deadlines
+ * that expired: SIGTERM first, then SIGKILL once the grace period is up
+ * post-condition:  returned number of signals sent */
+int _wheel_tick(struct CL * cl)
+{
+    // declarations
+    struct DEADLINE * dl;
+    struct DEADLINE * next;
+    uint64_t ticks = 0;
+    int sent = 0;
+
+    read(cl->wheel_fd, &ticks, sizeof(ticks));
+
+    while (ticks-- > 0 && cl->wheel_len > 0)
+    {
+        cl->wheel_pos = (cl->wheel_pos + 1) % WHEEL_SLOTS;
+
+        for (dl = cl->wheel[cl->wheel_pos]; dl != NULL; dl = next)
+        {
+            next = dl->next;
+
+            // due on a later turn of the wheel
+            if (dl->rounds > 0) { dl->rounds--; continue; }
+
+            _wheel_unlink(cl, dl);
+            if (dl->stage == 0)
+            {
+                // ask nicely, then come back after the grace period
+                _job_kill(dl->pid, dl->pidfd, SIGTERM);
+                dl->stage = 1;
+                _wheel_link(cl, dl, TIMEOUT_GRACE_MS);
+            }
+            else
+            {
+                _job_kill(dl->pid, dl->pidfd, SIGKILL);
+                dl->stage = 2;
+            }
+            sent++;
+        }
+    }
+
+    return sent;
+}
+
+/* parse a duration ("10", "1.5", "500ms", "30s", "5m", "2h")
+ * post-condition:  returned milliseconds, -1 if str is not a duration
+ *                  (or is too long to count in microseconds in a long) */
+long _parse_duration(char * str)
+{
+    char * end;
+    double val = strtod(str, &end);
+
+    // strtod takes "inf" and "nan" too
+    if (end == str || !isfinite(val) || val < 0) { return -1; }
+
+    if      (*end == '\0' || strcmp(end, "s") == 0) { val *= 1000; }
+    else if (strcmp(end, "ms") == 0)                { }
+    else if (strcmp(end, "m") == 0)                 { val *= 60 * 1000; }
+    else if (strcmp(end, "h") == 0)                 { val *= 60 * 60 * 1000; }
+    else { return -1; }
+
+    // callers count in microseconds too
+    if (val >= (double) (LONG_MAX / 1000)) { return -1; }
+
+    return (long) val;
+}
@@ -0,0 +1,258 @@
+/*
+ * library  -   libsmallsh (zygote launcher)
+ * author   -   Nicholas Olson
+ *
+ * fork() costs grow with the size of the shell, since its page tables are
+ * copied. The zygote is a helper forked while the shell is still tiny.
+ * The shell sends it argv, envp and the fds of the command, and it clones
+ * the command out of its own small address space. CLONE_PARENT makes the
+ * command a child of the shell, so the shell waits on and tracks it
+ * exactly like a forked one.
+ */
+
+/*** includes ***/
+#define _GNU_SOURCE     // for CLONE_PARENT
+#include <stdlib.h>     // std library stuff
+#include <stdio.h>      // I/O stuff
+#include <unistd.h>     // launching processess
+#include <string.h>     // for strlen, strcmp, etc
+#include <errno.h>      // for errno checking
+#include <fcntl.h>      // for opening
+#include <signal.h>     // for signal control
+#include <sched.h>      // for CLONE_PARENT
+#include <sys/syscall.h>  // for clone without a new stack
+#include <sys/socket.h> // for talking to the zygote
+#include <sys/wait.h>   // for waitpid
+#include "libsmallsh.h" // private interface
+
+
+/*** defines ***/
+#define ZYGOTE_MSG_MAX 131072   // largest launch request (argv and envp)
+#define ZYGOTE_FDS 4            // stdin, stdout, stderr and cwd
+
+
+/*** structs ***/
+/* header of a launch request, followed by the file to exec ("" to
+ * search the path) and argc + envc strings */
+struct ZYGOTE_REQ {
+    int argc;
+    int envc;
+    int background;     // ignore SIGINT
+    int jobctl;         // own process group
+    int term_fg;        // take over the terminal
+};
+
+
+/*** hidden methods ***/
+/* fork the zygote, call before the session allocates anything big
+ * post-condition:  cl->zyg_fd is -1 if there is no zygote */
+int _zygote_start(struct CL * cl)
+{
+    int sv[2];
+    int pid;
+
+    cl->zyg_fd = -1;
+    cl->zyg_pid = -1;
+
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) == -1) { return -1; }
+
+    pid = fork();
+    if (pid == 0)
+    {
+        close(sv[0]);
+        _zygote_main(cl, sv[1]);
+    }
+    close(sv[1]);
+    if (pid == -1) { close(sv[0]); return -1; }
+
+    cl->zyg_fd = sv[0];
+    cl->zyg_pid = pid;
+    return 0;
+}
+
+/* stop the zygote (it exits once its socket is closed) */
+int _zygote_stop(struct CL * cl)
+{
+    if (cl->zyg_fd == -1) { return 0; }
+
+    close(cl->zyg_fd);
+    waitpid(cl->zyg_pid, NULL, 0);
+    cl->zyg_fd = -1;
+    return 0;
+}
+
+/* zygote: launch a command for every request until the shell is gone */
+void _zygote_main(struct CL * cl, int sock)
+{
+    // declarations
+    char cbuf[CMSG_SPACE(ZYGOTE_FDS * sizeof(int))];
+    struct ZYGOTE_REQ * req;
+    struct cmsghdr * cmsg;
+    struct msghdr msg;
+    struct iovec iov;
+    char ** strs;
+    char * buff;
+    char * file;
+    char * ptr;
+    int fds[ZYGOTE_FDS];
+    int nfds;
+    int pid;
+    int n;
+    int i;
+
+    // the terminal's signals are for the shell and its commands
+    signal(SIGINT, SIG_IGN);
+    signal(SIGTSTP, SIG_IGN);
+
+    buff = malloc(ZYGOTE_MSG_MAX);
+    strs = malloc((ZYGOTE_MSG_MAX / 2 + 2) * sizeof(char*));
+
+    while (1)
+    {
+        // get request
+        iov.iov_base = buff;
+        iov.iov_len = ZYGOTE_MSG_MAX;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = cbuf;
+        msg.msg_controllen = sizeof(cbuf);
+        if ((n = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC)) <= 0) { break; }
+
+        // get its fds
+        nfds = 0;
+        cmsg = CMSG_FIRSTHDR(&msg);
+        if (cmsg != NULL && cmsg->cmsg_type == SCM_RIGHTS)
+        {
+            nfds = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            memcpy(fds, CMSG_DATA(cmsg), nfds * sizeof(int));
+        }
+
+        // split strings into file, argv and envp
+        req = (struct ZYGOTE_REQ*) buff;
+        file = buff + sizeof(struct ZYGOTE_REQ);
+        ptr = file + strlen(file) + 1;
+        for (i = 0; i < req->argc + req->envc; i++)
+        {
+            strs[i + (i >= req->argc)] = ptr;
+            ptr += strlen(ptr) + 1;
+        }
+        strs[req->argc] = NULL;
+        strs[req->argc + req->envc + 1] = NULL;
+
+        // launch it as a child of the shell
+        pid = -1;
+        if (nfds == ZYGOTE_FDS)
+        {
+            pid = syscall(SYS_clone, CLONE_PARENT | SIGCHLD, 0, NULL, NULL, 0);
+        }
+        if (pid == 0)
+        {
+            // foreground commands can be interrupted
+            if (!req->background) { signal(SIGINT, SIG_DFL); }
+            _child_setup(req->jobctl, req->background, req->term_fg);
+
+            dup2(fds[0], STDIN_FILENO);
+            dup2(fds[1], STDOUT_FILENO);
+            dup2(fds[2], STDERR_FILENO);
+            fchdir(fds[3]);
+
+            _exec_args(cl, file[0] ? file : NULL, strs, strs + req->argc + 1);
+        }
+
+        // report pid back
+        for (i = 0; i < nfds; i++) { close(fds[i]); }
+        send(sock, &pid, sizeof(pid), MSG_NOSIGNAL);
+    }
+
+    _exit(0);
+}
+
+/* launch argv (from file, or searching the path if NULL) through the
+ * zygote with the given stdin, stdout, stderr
+ * post-condition:  returned pid of the command, -1 if the zygote could
+ *                  not launch it (the caller should fork instead) */
+int _zygote_spawn(struct CL * cl, char * file, char ** argv,
+                  int in, int out, int err, int background)
+{
+    // declarations
+    char cbuf[CMSG_SPACE(ZYGOTE_FDS * sizeof(int))];
+    struct ZYGOTE_REQ req;
+    struct cmsghdr * cmsg;
+    struct msghdr msg = {0};
+    struct iovec iov;
+    int fds[ZYGOTE_FDS];
+    char * buff;
+    int len;
+    int pid = -1;
+    int err_no = 0;
+    int n;
+    int i;
+
+    if (cl->zyg_fd == -1) { return -1; }
+
+    // header
+    req.argc = 0;
+    req.envc = 0;
+    req.background = background;
+    req.jobctl = (cl->flags & CL_JOBCTL) != 0;
+    req.term_fg = cl->term_fg && !background;
+    buff = malloc(ZYGOTE_MSG_MAX);
+    len = sizeof(req);
+
+    // file, argv then envp, each null terminated
+    if (file == NULL) { file = ""; }
+    if (len + strlen(file) + 1 > ZYGOTE_MSG_MAX) { free(buff); return -1; }
+    strcpy(buff + len, file);
+    len += strlen(file) + 1;
+    for (i = 0; argv[i] != NULL; i++, req.argc++)
+    {
+        if (len + strlen(argv[i]) + 1 > ZYGOTE_MSG_MAX) { free(buff); return -1; }
+        strcpy(buff + len, argv[i]);
+        len += strlen(argv[i]) + 1;
+    }
+    for (i = 0; environ[i] != NULL; i++, req.envc++)
+    {
+        if (len + strlen(environ[i]) + 1 > ZYGOTE_MSG_MAX) { free(buff); return -1; }
+        strcpy(buff + len, environ[i]);
+        len += strlen(environ[i]) + 1;
+    }
+    memcpy(buff, &req, sizeof(req));
+
+    // fds to use, cwd included since the zygote didn't follow cd
+    fds[0] = in;
+    fds[1] = out;
+    fds[2] = err;
+    fds[3] = open(".", O_PATH | O_DIRECTORY | O_CLOEXEC);
+
+    iov.iov_base = buff;
+    iov.iov_len = len;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = cbuf;
+    msg.msg_controllen = sizeof(cbuf);
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(ZYGOTE_FDS * sizeof(int));
+    memcpy(CMSG_DATA(cmsg), fds, ZYGOTE_FDS * sizeof(int));
+
+    // send request and get pid back, noting errno of the call that
+    // failed before anything else can change it
+    if (fds[3] != -1)
+    {
+        if ((n = sendmsg(cl->zyg_fd, &msg, MSG_NOSIGNAL)) != len) { err_no = (n == -1) ? errno : 0; }
+        else if ((n = recv(cl->zyg_fd, &pid, sizeof(pid), 0)) != sizeof(pid))
+        {
+            pid = -1;
+            err_no = (n == 0) ? EPIPE : (n == -1) ? errno : 0;
+        }
+    }
+
+    // zygote is gone, stop using it
+    if (pid == -1 && (err_no == EPIPE || err_no == ECONNRESET)) { _zygote_stop(cl); }
+
+    close(fds[3]);
+    free(buff);
+    return pid;
+}
@@ -0,0 +1,68 @@
+/*
+ * program  -   bench_launch
+ * author   -   Nicholas Olson
+ *
+ * Times launching /bin/true (a path, so the "true" built-in doesn't
+ * answer) from a session whose process has grown large, once forking
+ * every command and once through the zygote.
+ * usage: bench_launch [MB of heap] [launches]
+ */
+
+/*** includes ***/
+#include <stdlib.h>     // std library stuff
+#include <stdio.h>      // I/O stuff
+#include <string.h>     // for memset
+#include <time.h>       // for clock_gettime
+#include <sys/mman.h>   // for madvise
+#include "../src/smallsh.h" // shell engine
+
+
+/*** hidden methods ***/
+/* average microseconds per launch in the given session */
+double _time_launches(struct CL * cl, int count)
+{
+    struct timespec start, end;
+    char line[] = "/bin/true";
+    int i;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < count; i++) { run_CL(cl, line); }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    return ((end.tv_sec - start.tv_sec) * 1e6
+            + (end.tv_nsec - start.tv_nsec) / 1e3) / count;
+}
+
+
+/*** main ***/
+int main(int argc, char** argv)
+{
+    int mb = (argc > 1) ? atoi(argv[1]) : 512;
+    int count = (argc > 2) ? atoi(argv[2]) : 200;
+    double fork_us, zyg_us;
+    struct CL * forked;
+    struct CL * zygote;
+    char * heap;
+
+    // sessions start while the process is small, like the shell does
+    forked = new_CL(0);
+    zygote = new_CL(CL_ZYGOTE);
+
+    // grow the process like a long running shell
+    // (small pages, like a heap of many small allocations)
+    heap = malloc((size_t) mb << 20);
+    madvise(heap, (size_t) mb << 20, MADV_NOHUGEPAGE);
+    memset(heap, 1, (size_t) mb << 20);
+
+    fork_us = _time_launches(forked, count);
+    zyg_us = _time_launches(zygote, count);
+
+    printf("%d MB heap, %d launches\n", mb, count);
+    printf("fork:   %8.1f us/launch\n", fork_us);
+    printf("zygote: %8.1f us/launch\n", zyg_us);
+
+    delete_CL(forked);
+    delete_CL(zygote);
+    free(heap);
+    return 0;
+}
@@ -0,0 +1,366 @@
+/*
+ * program  -   pty_harness
+ * author   -   Nicholas Olson
+ *
+ * Runs smallsh on a pseudo-terminal and replays keystrokes at it: typing,
+ * arrows, backspace, history, paste, Ctrl-C and Ctrl-Z. The output is fed
+ * through a small terminal emulator (the escape sequences smallsh uses)
+ * and the screen is checked after each step. Typed keys are sent one at a
+ * time and the time until the first byte of their echo is recorded.
+ * usage: pty_harness [path of smallsh]
+ * post-condition:  exits 1 if a check failed
+ */
+
+/*** includes ***/
+#include <stdlib.h>     // std library stuff
+#include <stdio.h>      // I/O stuff
+#include <string.h>     // for strcmp, strstr
+#include <unistd.h>     // for read, write
+#include <poll.h>       // for waiting on output
+#include <time.h>       // for clock_gettime
+#include <signal.h>     // for kill
+#include <pty.h>        // for forkpty
+#include <sys/wait.h>   // for waitpid
+
+
+/*** defines ***/
+#define ROWS 24
+#define COLS 80
+#define SETTLE_MS 15        // output is done once quiet this long
+#define ECHO_WAIT_MS 1000   // longest wait for a typed key's echo
+#define EXPECT_WAIT_MS 3000 // longest wait for the screen to match
+#define SAMPLES_MAX 4096
+
+/* keys */
+#define CTRL_C "\003"
+#define CTRL_U "\025"
+#define CTRL_Z "\032"
+#define ENTER  "\r"
+#define UP     "\033[A"
+#define DOWN   "\033[B"
+#define LEFT   "\033[D"
+#define HOME   "\033[H"
+#define END    "\033[F"
+#define BS     "\177"
+#define PASTE(text) "\033[200~" text "\033[201~"   // bracketed paste
+
+
+/*** structs ***/
+/* keystrokes and what the screen shows after them */
+struct STEP {
+    char * name;
+    char * keys;    // bytes sent
+    int typed;      // one key at a time, timing each echo
+    char * line;    // line of the cursor
+    int col;        // column of the cursor
+    char * above;   // part of the line above it (NULL for any)
+};
+
+/* screen of the terminal smallsh runs on */
+struct SCREEN {
+    char cells[ROWS][COLS + 1];
+    int row;
+    int col;
+    char seq[32];   // escape sequence being read
+    int seq_len;    // -1 when not in one
+};
+
+
+/*** script ***/
+/* (a command's output is checked once the next prompt is up, keys typed
+ * before the shell takes the terminal back would be echoed by it) */
+struct STEP steps[] = {
+    { "prompt",           "",                           0, ": ",            2, NULL },
+    { "typing",           "echo hello",                 1, ": echo hello", 12, NULL },
+    { "enter",            ENTER,                        0, ": ",            2, "hello" },
+    { "backspace",        "echo abcx" BS,               1, ": echo abc",   10, NULL },
+    { "run edited",       ENTER,                        0, ": ",            2, "abc" },
+    { "left arrow",       "echo wrld" LEFT LEFT LEFT,   1, ": echo wrld",   8, NULL },
+    { "insert",           "o",                          1, ": echo world",  9, NULL },
+    { "home",             HOME,                         0, ": echo world",  2, NULL },
+    { "end",              END,                          0, ": echo world", 12, NULL },
+    { "run inserted",     ENTER,                        0, ": ",            2, "world" },
+    { "history up",       UP,                           0, ": echo world", 12, NULL },
+    { "history up 2",     UP,                           0, ": echo abc",   10, NULL },
+    { "history down",     DOWN,                         0, ": echo world", 12, NULL },
+    { "kill line",        CTRL_U,                       0, ": ",            2, NULL },
+    { "paste",            PASTE("echo pasted"),         0, ": echo pasted", 13, NULL },
+    { "run paste",        ENTER,                        0, ": ",            2, "pasted" },
+    { "paste two lines",  PASTE("printf one-\recho two"), 0, ": printf one-;echo two", 22, NULL },
+    { "run both lines",   ENTER,                        0, ": ",            2, "one-two" },
+    { "type",             "echo x",                     1, ": echo x",      8, NULL },
+    { "ctrl-c at prompt", CTRL_C,                       0, ": echo x",      8, NULL },
+    { "clear",            CTRL_U,                       0, ": ",            2, NULL },
+    { "fg job",           "sleep 30" ENTER,             0, "",              0, ": sleep 30" },
+    { "ctrl-c fg job",    CTRL_C,                       0, ": ",            2, "terminated by signal 2" },
+    { "stop job",         "sleep 30" ENTER,             0, "",              0, ": sleep 30" },
+    { "ctrl-z fg job",    CTRL_Z,                       0, ": ",            2, "[1] stopped  sleep 30" },
+    { "jobs",             "jobs" ENTER,                 0, ": ",            2, "[1] stopped" },
+    { "fg",               "fg" ENTER,                   0, "",              0, "sleep 30" },
+    { "ctrl-c resumed",   CTRL_C,                       0, ": ",            2, "terminated by signal 2" },
+    { "fan out",          "echo fan > /tmp/pty$$a >> /tmp/pty$$b > >(gzip > /tmp/pty$$c.gz)" ENTER,
+                                                        0, ": ",            2, "c.gz)" },
+    { "fan out to gzip",  "wait ; zcat /tmp/pty$$c.gz" ENTER, 0, ": ",      2, "fan" },
+    { "fan out to files", "wc -l /tmp/pty$$a /tmp/pty$$b ; rm /tmp/pty$$a /tmp/pty$$b /tmp/pty$$c.gz" ENTER,
+                                                        0, ": ",            2, "2 total" },
+    { "fg no such job",   "fg %7 || echo fg-failed" ENTER, 0, ": ",         2, "fg-failed" },
+    { "wait no such job", "wait %9 || echo wait-$?" ENTER, 0, ": ",         2, "wait-127" },
+    { "mid-line redir",   "cat <<< mid-hs -" ENTER,     0, ": ",            2, "mid-hs" },
+    { "unspaced list",    "true;false||echo st$?x" ENTER, 0, ": ",      2, "st1x" },
+    { "new PATH dir",     "mkdir /tmp/pty$$p ; cp /bin/echo /tmp/pty$$p/ptyecho ; echo made" ENTER,
+                                                        0, ": ",            2, "made" },
+    { "assign PATH",      "PATH=/tmp/pty$$p:$PATH ; ptyecho path-$?x" ENTER, 0, ": ", 2, "path-0x" },
+    { "drop PATH dir",    "rm -r /tmp/pty$$p ; echo cleaned" ENTER, 0, ": ", 2, "cleaned" },
+    { NULL,               NULL,                         0, NULL,            0, NULL }
+};
+
+
+/*** hidden prototypes ***/
+long _now_us();                             // monotonic time in us
+void _screen_init(struct SCREEN*);          // blank screen
+void _screen_put(struct SCREEN*, char);     // apply a byte of output
+void _screen_csi(struct SCREEN*);           // apply an escape sequence
+void _screen_scroll(struct SCREEN*);        // scroll up a line
+char * _screen_line(struct SCREEN*, int);   // line without trailing spaces
+int _pump(int, struct SCREEN*, int);        // read output until quiet
+int _check(struct SCREEN*, struct STEP*);   // screen shows what step expects
+int _key_len(char*);                        // bytes of the key k starts with
+int _cmp_long(const void*, const void*);    // order samples (qsort)
+
+
+/*** hidden methods ***/
+/* microseconds on the monotonic clock */
+long _now_us()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000L + ts.tv_nsec / 1000;
+}
+
+/* blank screen, cursor at the top left */
+void _screen_init(struct SCREEN * scr)
+{
+    int r;
+
+    for (r = 0; r < ROWS; r++)
+    {
+        memset(scr->cells[r], ' ', COLS);
+        scr->cells[r][COLS] = '\0';
+    }
+    scr->row = 0;
+    scr->col = 0;
+    scr->seq_len = -1;
+}
+
+/* apply a byte of output to the screen */
+void _screen_put(struct SCREEN * scr, char c)
+{
+    // escape sequence
+    if (scr->seq_len >= 0)
+    {
+        if (scr->seq_len < (int) sizeof(scr->seq) - 1) { scr->seq[scr->seq_len++] = c; }
+        scr->seq[scr->seq_len] = '\0';
+        if (scr->seq_len == 1 && c != '[') { scr->seq_len = -1; }
+        else if (scr->seq_len > 1 && c >= 0x40 && c <= 0x7e) { _screen_csi(scr); scr->seq_len = -1; }
+        return;
+    }
+
+    if (c == '\033') { scr->seq_len = 0; }
+    else if (c == '\r') { scr->col = 0; }
+    else if (c == '\n') { if (++scr->row == ROWS) { _screen_scroll(scr); } }
+    else if (c == '\b') { if (scr->col > 0) { scr->col--; } }
+    else if (c == '\t') { scr->col = (scr->col / 8 + 1) * 8; }
+    else if ((unsigned char) c >= ' ')
+    {
+        // wrap at the right edge
+        if (scr->col >= COLS)
+        {
+            scr->col = 0;
+            if (++scr->row == ROWS) { _screen_scroll(scr); }
+        }
+        scr->cells[scr->row][scr->col++] = c;
+    }
+    if (scr->col > COLS) { scr->col = COLS; }
+}
+
+/* apply the escape sequence read (cursor moves and erasing, anything
+ * else, like modes, doesn't change the screen) */
+void _screen_csi(struct SCREEN * scr)
+{
+    char final = scr->seq[scr->seq_len - 1];
+    int n = atoi(scr->seq + 1);
+
+    if (scr->seq[1] == '?') { return; }
+    if (n == 0) { n = 1; }
+
+    if (final == 'C')      { scr->col = (scr->col + n > COLS) ? COLS : scr->col + n; }
+    else if (final == 'D') { scr->col = (scr->col - n < 0) ? 0 : scr->col - n; }
+    else if (final == 'K') { memset(scr->cells[scr->row] + scr->col, ' ', COLS - scr->col); }
+}
+
+/* scroll the screen up a line, the cursor stays on the last */
+void _screen_scroll(struct SCREEN * scr)
+{
+    memmove(scr->cells[0], scr->cells[1], (ROWS - 1) * sizeof(scr->cells[0]));
+    memset(scr->cells[ROWS - 1], ' ', COLS);
+    scr->row = ROWS - 1;
+}
+
+/* line r of the screen without its trailing spaces
+ * post-condition:  returned string is static, valid until the next call */
+char * _screen_line(struct SCREEN * scr, int r)
+{
+    static char line[COLS + 1];
+    int len = COLS;
+
+    memcpy(line, scr->cells[r], COLS);
+    while (len > 0 && line[len - 1] == ' ') { len--; }
+    line[len] = '\0';
+    return line;
+}
+
+/* read output into the screen until there's none for quiet_ms
+ * post-condition:  returned number of bytes read, -1 once smallsh is gone */
+int _pump(int fd, struct SCREEN * scr, int quiet_ms)
+{
+    struct pollfd pfd = { fd, POLLIN, 0 };
+    char buf[4096];
+    int total = 0;
+    int n;
+    int i;
+
+    while (poll(&pfd, 1, quiet_ms) > 0)
+    {
+        if ((n = read(fd, buf, sizeof(buf))) <= 0) { return total ? total : -1; }
+        for (i = 0; i < n; i++) { _screen_put(scr, buf[i]); }
+        total += n;
+    }
+
+    return total;
+}
+
+/* screen shows what step expects (trailing spaces don't count) */
+int _check(struct SCREEN * scr, struct STEP * step)
+{
+    char want[COLS + 1];
+    int len;
+
+    snprintf(want, sizeof(want), "%s", step->line);
+    for (len = strlen(want); len > 0 && want[len - 1] == ' '; len--) { want[len - 1] = '\0'; }
+
+    if (strcmp(_screen_line(scr, scr->row), want) != 0 || scr->col != step->col) { return 0; }
+    if (step->above == NULL) { return 1; }
+    return scr->row > 0 && strstr(_screen_line(scr, scr->row - 1), step->above) != NULL;
+}
+
+/* bytes of the key k starts with (an escape sequence is one key) */
+int _key_len(char * k)
+{
+    int len = 2;
+
+    if (k[0] != '\033' || k[1] != '[') { return 1; }
+    while (k[len] != '\0' && !(k[len] >= 0x40 && k[len] <= 0x7e)) { len++; }
+    return (k[len] != '\0') ? len + 1 : len;
+}
+
+/* order of two samples (for qsort) */
+int _cmp_long(const void * a, const void * b)
+{
+    long x = *(long *) a;
+    long y = *(long *) b;
+
+    return (x > y) - (x < y);
+}
+
+
+/*** main ***/
+int main(int argc, char ** argv)
+{
+    // declarations
+    struct winsize ws = { ROWS, COLS, 0, 0 };
+    struct pollfd pfd;
+    struct SCREEN scr;
+    struct STEP * step;
+    char * path = (argc > 1) ? argv[1] : "./smallsh";
+    static long samples[SAMPLES_MAX];
+    int num = 0;
+    int failed = 0;
+    long start;
+    long sent;
+    int fd;
+    int pid;
+    int len;
+    int ok;
+    int r;
+    char * k;
+
+    // smallsh on a terminal of its own
+    if ((pid = forkpty(&fd, NULL, NULL, &ws)) == -1) { perror("forkpty"); return 1; }
+    if (pid == 0)
+    {
+        execl(path, path, (char *) NULL);
+        perror(path);
+        _exit(127);
+    }
+    _screen_init(&scr);
+
+    for (step = steps; step->name != NULL; step++)
+    {
+        // keys, typed ones one at a time, timed until their echo starts
+        for (k = step->keys; *k != '\0'; k += len)
+        {
+            len = step->typed ? _key_len(k) : strlen(k);
+            sent = _now_us();
+            write(fd, k, len);
+            if (!step->typed) { break; }
+
+            pfd.fd = fd;
+            pfd.events = POLLIN;
+            if (poll(&pfd, 1, ECHO_WAIT_MS) > 0 && num < SAMPLES_MAX)
+            {
+                samples[num++] = _now_us() - sent;
+            }
+            _pump(fd, &scr, SETTLE_MS);
+        }
+
+        // the screen, once it catches up
+        start = _now_us();
+        while (!(ok = _check(&scr, step)) && _now_us() - start < EXPECT_WAIT_MS * 1000L)
+        {
+            if (_pump(fd, &scr, SETTLE_MS) == -1) { break; }
+        }
+
+        printf("%-18s %s\n", step->name, ok ? "ok" : "FAILED");
+        if (!ok)
+        {
+            failed++;
+            printf("  expected \"%s\" (cursor at %d)", step->line, step->col);
+            if (step->above != NULL) { printf(" below \"%s\"", step->above); }
+            printf(", screen:\n");
+            for (r = 0; r < ROWS; r++)
+            {
+                printf("  %c|%s\n", r == scr.row ? '>' : ' ', _screen_line(&scr, r));
+            }
+            printf("  cursor at %d\n", scr.col);
+        }
+    }
+
+    // done with it
+    write(fd, "exit" ENTER, 5);
+    _pump(fd, &scr, 200);
+    kill(pid, SIGKILL);
+    waitpid(pid, NULL, 0);
+
+    // echo latency
+    if (num > 0)
+    {
+        qsort(samples, num, sizeof(long), _cmp_long);
+        printf("echo latency (%d keys): p50 %ld us, p90 %ld us, p99 %ld us, max %ld us\n", num,
+                    samples[num / 2], samples[num * 90 / 100], samples[num * 99 / 100],
+                    samples[num - 1]);
+    }
+    printf("%d of %d checks failed\n", failed, (int) (step - steps));
+
+    return failed > 0;
+}